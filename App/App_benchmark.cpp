@@ -0,0 +1,607 @@
+// Headless CPU micro-benchmarks for the engine modules in Engine/.
+//
+// Build like the other programs (single file, needs only GLM):
+//     g++ -std=c++17 -O2 -pthread App_benchmark.cpp -o App_benchmark
+// Run everything, or pass benchmark names to pick:
+//     ./App_benchmark [vehicles] [bvh] [broadphase] [traffic] [instances] [scene] [profiler] [export] [terrain] [track] [occlusion] [pvs] ...
+// Run from this directory so the model paths resolve.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <random>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Engine/VehicleDynamics.h"
+#include "Engine/Bvh.h"
+#include "Engine/SceneFile.h"
+#include "Engine/SpatialHash.h"
+#include "Engine/Simulation.h"
+#include "Engine/TransformKernels.h"
+#include "Engine/Profiler.h"
+#include "Engine/FrameExport.h"
+#include "Engine/Terrain.h"
+#include "Engine/TrackMesh.h"
+#include "Engine/OcclusionCulling.h"
+#include "Engine/Pvs.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double secondsSince(BenchClock::time_point start)
+{
+    return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+// Keeps the optimizer from deleting work whose result is never used
+static volatile float benchSink = 0.0f;
+
+// ---------- Vehicle dynamics ----------
+void benchVehicles()
+{
+    cout << "== vehicles (" << simdPathName() << ") ==" << endl;
+    VehicleParams params;
+    const float dt = 1.0f / 120.0f;
+
+    for (int carCount : { 1, 16, 256, 1024, 4096 }) {
+        VehicleBatch batch;
+        for (int i = 0; i < carCount; ++i) {
+            batch.add((i % 64) * 4.0f, 0.0f, (i / 64) * 8.0f, 0.0f);
+            batch.throttle[i] = 0.6f;
+            batch.steerInput[i] = ((i % 7) - 3) / 3.0f;
+        }
+        probeVehicleGround(batch, [](float, float) { return 0.0f; });
+
+        // Aim for roughly the same total work per row
+        int steps = std::max(50, 400000 / carCount);
+        BenchClock::time_point start = BenchClock::now();
+        for (int s = 0; s < steps; ++s) {
+            probeVehicleGround(batch, [](float, float) { return 0.0f; });
+            stepVehicles(batch, params, dt);
+        }
+        double seconds = secondsSince(start);
+        benchSink = benchSink + batch.posZ[0];
+
+        double vehicleSteps = double(carCount) * steps;
+        cout << "  " << setw(5) << carCount << " cars: "
+             << fixed << setprecision(1) << vehicleSteps / (seconds * 1000.0) << " vehicles/ms, "
+             << setprecision(3) << seconds * 1e6 / steps << " us/tick" << endl;
+    }
+}
+
+// Model-space bounds straight from an .obj's vertex lines (no Assimp in the benchmark)
+static Aabb loadObjBounds(const char* path)
+{
+    Aabb bounds;
+    ifstream file(path);
+    if (!file) {
+        cerr << "Failed to open " << path << ", using a unit box" << endl;
+        return Aabb(glm::vec3(-0.5f), glm::vec3(0.5f));
+    }
+    string line;
+    while (getline(file, line)) {
+        if (line.size() < 2 || line[0] != 'v' || line[1] != ' ') continue;
+        istringstream in(line.substr(2));
+        glm::vec3 p;
+        in >> p.x >> p.y >> p.z;
+        bounds.grow(p);
+    }
+    return bounds;
+}
+
+// ---------- Scenery BVH ----------
+void benchBvh()
+{
+    cout << "== bvh ==" << endl;
+    SceneFile track;
+    if (!loadScene("Scenes/track.scene", track)) return;
+    std::vector<Aabb> meshBounds;
+    for (int m = 0; m < track.meshCount(); ++m) meshBounds.push_back(loadObjBounds(track.meshes()[m].path));
+
+    std::vector<Aabb> bounds;
+    for (int i = 0; i < track.instanceCount(); ++i)
+        bounds.push_back(transformAabb(track.instances()[i].modelMatrix(), meshBounds[track.instances()[i].mesh]));
+
+    BenchClock::time_point buildStart = BenchClock::now();
+    StaticBvh bvh;
+    bvh.build(bounds);
+    cout << "  full track: " << bounds.size() << " instances, " << bvh.nodes.size() << " nodes, built in "
+         << fixed << setprecision(1) << secondsSince(buildStart) * 1e6 << " us" << endl;
+
+    // Car-sized queries scattered over the drivable area
+    const int queryCount = 200000;
+    std::mt19937 rng(371);
+    std::uniform_real_distribution<float> across(-20.0f, 20.0f), along(-50.0f, 50.0f), turn(-3.14159f, 3.14159f);
+    std::vector<glm::vec3> origins(queryCount), moves(queryCount);
+    for (int i = 0; i < queryCount; ++i) {
+        origins[i] = glm::vec3(across(rng), 0.5f, along(rng));
+        float a = turn(rng);
+        moves[i] = glm::vec3(sinf(a), 0.0f, cosf(a)) * (30.0f / 120.0f);   // 30 m/s for one step
+    }
+    const glm::vec3 carExtents(0.85f, 0.45f, 1.4f);
+
+    std::vector<int> hits;
+    int found = 0;
+    BenchClock::time_point start = BenchClock::now();
+    for (int i = 0; i < queryCount; ++i)
+        found += bvh.overlap(aabbFromCenterExtents(origins[i], carExtents), hits);
+    double overlapSeconds = secondsSince(start);
+
+    BvhHit hit;
+    start = BenchClock::now();
+    for (int i = 0; i < queryCount; ++i)
+        found += bvh.sweep(aabbFromCenterExtents(origins[i], carExtents), moves[i], hit);
+    double sweepSeconds = secondsSince(start);
+
+    start = BenchClock::now();
+    for (int i = 0; i < queryCount; ++i)
+        found += bvh.raycast(origins[i] + glm::vec3(0.0f, 1.0f, 0.0f), glm::normalize(moves[i]), 5.0f, hit);
+    double raySeconds = secondsSince(start);
+
+    // Reference: testing every instance
+    start = BenchClock::now();
+    for (int i = 0; i < queryCount; ++i) {
+        Aabb box = aabbFromCenterExtents(origins[i], carExtents);
+        for (const Aabb& b : bounds) found += b.overlaps(box);
+    }
+    double linearSeconds = secondsSince(start);
+    benchSink = benchSink + found;
+
+    cout << setprecision(2)
+         << "  overlap: " << queryCount / overlapSeconds / 1e6 << " M queries/s"
+         << " (linear scan " << queryCount / linearSeconds / 1e6 << " M/s)" << endl
+         << "  sweep:   " << queryCount / sweepSeconds / 1e6 << " M queries/s" << endl
+         << "  raycast: " << queryCount / raySeconds / 1e6 << " M queries/s" << endl;
+}
+
+// ---------- Spatial hash broadphase ----------
+void benchBroadphase()
+{
+    cout << "== broadphase ==" << endl;
+    const float radius = 1.0f;
+    const int frames = 20;
+
+    for (int objectCount : { 100, 1000, 10000, 100000 }) {
+        // Constant density: ~one object per 40 m^2 of ground, a few metres of height
+        float side = sqrtf(objectCount * 40.0f);
+        std::mt19937 rng(objectCount);
+        std::uniform_real_distribution<float> ground(0.0f, side), height(0.0f, 6.0f), step(-0.3f, 0.3f);
+
+        SpatialHash hash(2.0f * radius);
+        std::vector<int> handles;
+        for (int i = 0; i < objectCount; ++i)
+            handles.push_back(hash.insert(glm::vec3(ground(rng), height(rng), ground(rng)), radius));
+        hash.update();
+
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        size_t pairTotal = 0;
+        BenchClock::time_point start = BenchClock::now();
+        for (int f = 0; f < frames; ++f) {
+            for (int h : handles)
+                hash.move(h, hash.positions[h] + glm::vec3(step(rng), 0.0f, step(rng)));
+            hash.update();
+            hash.findPairs(pairs);
+            pairTotal += pairs.size();
+        }
+        double hashMs = secondsSince(start) * 1000.0 / frames;
+
+        cout << "  " << setw(6) << objectCount << " objects: " << fixed << setprecision(3) << hashMs
+             << " ms/frame (move + update + pairs), " << pairTotal / frames << " pairs";
+
+        // All-pairs reference while it is still affordable
+        if (objectCount <= 10000) {
+            size_t brutePairs = 0;
+            start = BenchClock::now();
+            for (int i = 0; i < objectCount; ++i)
+                for (int j = i + 1; j < objectCount; ++j) {
+                    glm::vec3 d = hash.positions[i] - hash.positions[j];
+                    brutePairs += glm::dot(d, d) <= 4.0f * radius * radius;
+                }
+            cout << ", all-pairs " << secondsSince(start) * 1000.0 << " ms";
+            benchSink = benchSink + brutePairs;
+        }
+        cout << endl;
+    }
+}
+
+// ---------- AI traffic (full simulation step) ----------
+void benchTraffic()
+{
+    cout << "== traffic (" << jobSystem().threadCount() << " threads available) ==" << endl;
+    const float dt = 1.0f / 120.0f;
+    const int steps = 240;
+
+    SceneFile scene;
+    if (!loadScene("Scenes/track.scene", scene)) return;
+    std::vector<glm::vec3> points;
+    for (int i = 0; i < scene.trackPointCount(); ++i) {
+        const SceneTrackPoint& point = scene.trackPoints()[i];
+        points.push_back(glm::vec3(point.position[0], point.position[1], point.position[2]));
+    }
+
+    for (int aiCars : { 16, 256, 1024, 4096 }) {
+        double msPerStep[2];
+        float offLane = 0.0f, meanSpeed = 0.0f;
+        for (int pass = 0; pass < 2; ++pass) {
+            jobSystem().setThreadLimit(pass == 0 ? 1 : 1 << 30);
+            SimState state;
+            SimInput input;
+            SimWorld world;
+            world.track.build(points);
+            addVehicle(world, state.carPos, 0.0f);
+            setAiCarCount(world, aiCars);
+
+            BenchClock::time_point start = BenchClock::now();
+            for (int s = 0; s < steps; ++s) stepSimulation(state, input, world, dt);
+            msPerStep[pass] = secondsSince(start) * 1000.0 / steps;
+
+            // Sanity: AI cars should still be in lane and moving
+            offLane = meanSpeed = 0.0f;
+            const VehicleBatch& v = world.vehicles;
+            for (int i = PLAYER_VEHICLE + 1; i < v.count; ++i) {
+                glm::vec3 centre, tangent;
+                world.track.frameAt(world.ai.lapDistance[i], centre, tangent);
+                glm::vec3 fromLane = glm::vec3(v.posX[i], 0.0f, v.posZ[i]) -
+                                     aiLanePoint(world.track, world.ai.lapDistance[i], world.ai.laneOffset[i]);
+                offLane += fabsf(fromLane.x * tangent.z - fromLane.z * tangent.x);
+                meanSpeed += sqrtf(v.velX[i] * v.velX[i] + v.velZ[i] * v.velZ[i]);
+            }
+            offLane /= aiCars;
+            meanSpeed /= aiCars;
+        }
+        cout << "  " << setw(5) << aiCars << " AI cars: " << fixed << setprecision(3)
+             << msPerStep[0] << " ms/step on 1 thread, " << msPerStep[1] << " ms/step parallel"
+             << setprecision(2) << " (mean speed " << meanSpeed << " m/s, mean lane error " << offLane << " m)" << endl;
+    }
+    jobSystem().setThreadLimit(1 << 30);
+}
+
+// ---------- Instance matrices (TRS -> mat4) ----------
+void benchInstances()
+{
+    cout << "== instances (best kernel: " << transformKernelName(detectTransformKernel()) << ") ==" << endl;
+    for (int count : { 256, 4096, 65536 }) {
+        // Cars on the ground: position, yaw about +y, per-axis scale
+        std::mt19937 rng(count);
+        std::uniform_real_distribution<float> coord(-50.0f, 50.0f), angle(0.0f, 6.2831853f), size(0.5f, 2.0f);
+        TrsArrays trs;
+        trs.resize(count);
+        std::vector<float> yaw(count);
+        for (int i = 0; i < count; ++i) {
+            yaw[i] = angle(rng);
+            trs.px[i] = coord(rng); trs.pz[i] = coord(rng);
+            trs.qy[i] = sinf(0.5f * yaw[i]); trs.qw[i] = cosf(0.5f * yaw[i]);
+            trs.sx[i] = size(rng); trs.sy[i] = size(rng); trs.sz[i] = size(rng);
+        }
+        int repeats = std::max(1, (1 << 22) / count);
+
+        // Reference: the translate * rotate * scale chain the renderer used per instance
+        std::vector<glm::mat4> reference(count);
+        BenchClock::time_point start = BenchClock::now();
+        for (int r = 0; r < repeats; ++r)
+            for (int i = 0; i < count; ++i)
+                reference[i] = glm::translate(glm::mat4(1.0f), glm::vec3(trs.px[i], trs.py[i], trs.pz[i])) *
+                               glm::rotate(glm::mat4(1.0f), yaw[i], glm::vec3(0.0f, 1.0f, 0.0f)) *
+                               glm::scale(glm::mat4(1.0f), glm::vec3(trs.sx[i], trs.sy[i], trs.sz[i]));
+        double glmNs = secondsSince(start) * 1e9 / (double(repeats) * count);
+        benchSink = benchSink + reference[count / 2][3][0];
+
+        cout << "  " << setw(6) << count << " instances: glm " << fixed << setprecision(2) << glmNs << " ns";
+        std::vector<float> matrices(count * 16);
+        for (int kernel = TRANSFORM_KERNEL_SCALAR; kernel <= detectTransformKernel(); ++kernel) {
+            setTransformKernel(static_cast<TransformKernel>(kernel));
+            start = BenchClock::now();
+            for (int r = 0; r < repeats; ++r) composeTrsMatrices(trs, 0, count, matrices.data());
+            double ns = secondsSince(start) * 1e9 / (double(repeats) * count);
+
+            float error = 0.0f;
+            for (int i = 0; i < count; ++i)
+                for (int c = 0; c < 16; ++c)
+                    error = std::max(error, fabsf(matrices[i * 16 + c] - (&reference[i][0][0])[c]));
+            cout << ", " << transformKernelName() << " " << ns << " ns (x" << setprecision(1) << glmNs / ns
+                 << ", max error " << scientific << setprecision(1) << error << fixed << setprecision(2) << ")";
+        }
+        cout << " per instance" << endl;
+        setTransformKernel(TRANSFORM_KERNEL_AUTO);
+    }
+}
+
+// ---------- Scene file: text compile vs mapped binary ----------
+void benchScene()
+{
+    cout << "== scene ==" << endl;
+    const std::string textPath = "benchmark_scene.scene";
+    const std::string binaryPath = textPath + "b";
+    for (int instanceCount : { 100, 10000, 100000 }) {
+        {
+            std::mt19937 rng(instanceCount);
+            std::uniform_real_distribution<float> coord(-500.0f, 500.0f), angle(0.0f, 360.0f);
+            std::ofstream text(textPath);
+            text << "mesh hill Models/part.obj\nmaterial rock Textures/moutain.jpg\n";
+            for (int i = 0; i < instanceCount; ++i)
+                text << "instance hill rock " << coord(rng) << " 0 " << coord(rng) << " yaw " << angle(rng) << " scale 0.5 uv 20\n";
+        }
+
+        BenchClock::time_point start = BenchClock::now();
+        bool compiled = compileScene(textPath, binaryPath);
+        double compileMs = secondsSince(start) * 1000.0;
+
+        SceneFile scene;
+        start = BenchClock::now();
+        bool opened = compiled && scene.open(binaryPath);
+        double openMs = secondsSince(start) * 1000.0;
+        if (!opened) break;
+
+        // Touch every record once, as building the scenery bounds would
+        start = BenchClock::now();
+        float sum = 0.0f;
+        for (int i = 0; i < scene.instanceCount(); ++i) sum += scene.instances()[i].model[12];
+        double readMs = secondsSince(start) * 1000.0;
+        benchSink = benchSink + sum;
+
+        cout << "  " << setw(6) << instanceCount << " instances: compile text " << fixed << setprecision(3) << compileMs
+             << " ms, open binary " << openMs << " ms, first pass over records " << readMs << " ms" << endl;
+    }
+    std::remove(textPath.c_str());
+    std::remove(binaryPath.c_str());
+}
+
+// ---------- Profiler: cost of one zone ----------
+void benchProfiler()
+{
+    cout << "== profiler ==" << endl;
+    const int zones = 2000000;
+    volatile int work = 0;
+
+    BenchClock::time_point start = BenchClock::now();
+    for (int i = 0; i < zones; ++i) work = work + 1;
+    double emptyNs = secondsSince(start) * 1e9 / zones;
+
+    start = BenchClock::now();
+    for (int i = 0; i < zones; ++i) {
+        PROFILE_ZONE("benchmark zone");
+        work = work + 1;
+    }
+    double zoneNs = secondsSince(start) * 1e9 / zones - emptyNs;
+
+    profiler().setEnabled(false);
+    start = BenchClock::now();
+    for (int i = 0; i < zones; ++i) {
+        PROFILE_ZONE("benchmark zone");
+        work = work + 1;
+    }
+    double disabledNs = secondsSince(start) * 1e9 / zones - emptyNs;
+    profiler().setEnabled(true);
+    profiler().clear();
+
+    cout << "  " << fixed << setprecision(1) << zoneNs << " ns per zone (" << disabledNs << " ns disabled)" << endl;
+}
+
+// ---------- Frame export: encoder throughput against thread count ----------
+void benchExport()
+{
+    cout << "== export ==" << endl;
+    const int width = 1280, height = 720, frames = 48;
+    std::vector<uint8_t> image(size_t(width) * height * 4);
+    std::mt19937 rng(7);
+    for (uint8_t& byte : image) byte = static_cast<uint8_t>(rng());
+
+    int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (const char* path : { "benchmark_export", "benchmark_export.y4m" }) {
+        cout << "  " << (strstr(path, ".y4m") ? "y4m" : "png") << " " << width << "x" << height << ":";
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            FrameEncoderPool encoders;
+            if (!encoders.open(path, 60, threads)) return;
+            BenchClock::time_point start = BenchClock::now();
+            for (int f = 0; f < frames; ++f) {
+                ExportFrame* frame = encoders.acquire(width, height);
+                std::memcpy(frame->rgba.data(), image.data(), image.size());
+                encoders.submit(frame);
+            }
+            encoders.close();
+            double seconds = secondsSince(start);
+            cout << "  " << threads << (threads == 1 ? " thread " : " threads ") << fixed << setprecision(1)
+                 << encoders.written() / seconds << " frames/s";
+            for (int f = 0; f < frames && !strstr(path, ".y4m"); ++f) {
+                char name[64];
+                snprintf(name, sizeof(name), "%s/frame_%06d.png", path, f);
+                std::remove(name);
+            }
+        }
+        cout << endl;
+        std::remove(path);
+    }
+}
+
+// ---------- Terrain: heightmap generation and per-frame chunk selection ----------
+void benchTerrain()
+{
+    cout << "== terrain ==" << endl;
+    Terrain terrain;
+    BenchClock::time_point start = BenchClock::now();
+    terrain.generate(1);
+    cout << "  generate " << terrain.size() << "x" << terrain.size() << ": " << fixed << setprecision(1)
+         << secondsSince(start) * 1000.0 << " ms" << endl;
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 4000.0f);
+    std::vector<TerrainDraw> draws;
+    const int frames = 2000;
+    int triangles = 0;
+    start = BenchClock::now();
+    for (int f = 0; f < frames; ++f) {
+        float angle = f * 0.01f;
+        glm::vec3 eye(std::sin(angle) * 60.0f, 2.0f, std::cos(angle) * 60.0f);
+        Frustum frustum(projection * glm::lookAt(eye, eye + glm::vec3(std::cos(angle), -0.05f, -std::sin(angle)), glm::vec3(0, 1, 0)));
+        triangles += terrain.select(eye, frustum, draws);
+    }
+    cout << "  select " << terrain.chunks().size() << " chunks: " << setprecision(1)
+         << secondsSince(start) * 1e6 / frames << " us per frame, " << triangles / frames << " triangles, "
+         << draws.size() << " draws" << endl;
+}
+
+// Lay out closed loops of growing length, sweep every chunk as the streamer would, then cull them
+void benchTrack()
+{
+    cout << "== track ==" << endl;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 4000.0f);
+    std::vector<float> vertices(TRACK_CHUNK_FLOATS);
+    for (float radius : { 50.0f, 500.0f, 5000.0f }) {
+        std::vector<glm::vec3> points;
+        for (int i = 0; i < 32; ++i) {
+            float angle = 6.2831853f * i / 32;
+            float wobble = 1.0f + 0.2f * std::sin(angle * 5.0f);
+            points.push_back(glm::vec3(std::cos(angle), 0.0f, std::sin(angle)) * radius * wobble);
+        }
+        TrackMesh track;
+        BenchClock::time_point start = BenchClock::now();
+        track.build(points);
+        double buildMs = secondsSince(start) * 1000.0;
+        int chunks = static_cast<int>(track.chunks().size());
+
+        start = BenchClock::now();
+        for (int c = 0; c < chunks; ++c) track.buildChunk(c, vertices.data());
+        double sweepUs = secondsSince(start) * 1e6 / chunks;
+
+        const int frames = 2000;
+        size_t visible = 0;
+        start = BenchClock::now();
+        for (int f = 0; f < frames; ++f) {
+            float angle = f * 0.01f;
+            glm::vec3 eye(std::cos(angle) * radius, 2.0f, std::sin(angle) * radius);
+            Frustum frustum(projection * glm::lookAt(eye, eye + glm::vec3(-std::sin(angle), -0.05f, std::cos(angle)), glm::vec3(0, 1, 0)));
+            for (const TrackChunk& chunk : track.chunks())
+                visible += frustum.intersects(chunk.bounds);
+        }
+        cout << "  " << setw(7) << int(track.length()) << " m lap: layout " << fixed << setprecision(2) << buildMs << " ms, "
+             << track.memoryBytes() / 1024 << " KB; sweep " << setprecision(1) << sweepUs << " us per chunk; cull "
+             << chunks << " chunks " << secondsSince(start) * 1e6 / frames << " us per frame, "
+             << visible / frames << " visible" << endl;
+    }
+}
+
+// Rasterize the hills' occluder boxes and test every terrain chunk in view against them
+void benchOcclusion()
+{
+    cout << "== occlusion (" << simdPathName() << ", " << jobSystem().threadCount() << " threads) ==" << endl;
+    Terrain terrain;
+    terrain.generate(1);
+    OcclusionCuller occlusion;
+    for (const Aabb& box : terrain.occluderBoxes(32, 3.0f)) occlusion.addBox(box);
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 4000.0f);
+    std::vector<TerrainDraw> draws;
+    const int frames = 500;
+    double renderSeconds = 0.0, testSeconds = 0.0;
+    size_t quads = 0, tested = 0, hidden = 0;
+    for (int f = 0; f < frames; ++f) {
+        float angle = f * 0.01f;
+        glm::vec3 eye(std::sin(angle) * 60.0f, 2.0f, std::cos(angle) * 60.0f);
+        glm::mat4 viewProjection = projection * glm::lookAt(eye, eye + glm::vec3(std::cos(angle), -0.05f, -std::sin(angle)), glm::vec3(0, 1, 0));
+        Frustum frustum(viewProjection);
+        BenchClock::time_point start = BenchClock::now();
+        occlusion.render(viewProjection, frustum, eye);
+        renderSeconds += secondsSince(start);
+        quads += occlusion.stats().quads;
+
+        terrain.select(eye, frustum, draws);
+        start = BenchClock::now();
+        for (const TerrainDraw& draw : draws) hidden += !occlusion.visible(terrain.chunks()[draw.chunk].bounds);
+        testSeconds += secondsSince(start);
+        tested += draws.size();
+    }
+    cout << "  " << occlusion.occluderCount() << " occluders: render " << fixed << setprecision(1)
+         << renderSeconds * 1e6 / frames << " us per frame (" << quads / frames << " quads); test "
+         << setprecision(3) << testSeconds * 1e6 / std::max<size_t>(1, tested) << " us per box, "
+         << hidden / frames << " of " << tested / frames << " chunks in view hidden" << endl;
+}
+
+// Bake visible sets for the scene's track over the hills, then time the per-frame lookup
+void benchPvs()
+{
+    cout << "== pvs (" << jobSystem().threadCount() << " threads) ==" << endl;
+    SceneFile scene;
+    if (!loadScene("Scenes/track.scene", scene)) return;
+    std::vector<glm::vec3> points;
+    for (int i = 0; i < scene.trackPointCount(); ++i) {
+        const SceneTrackPoint& point = scene.trackPoints()[i];
+        points.push_back(glm::vec3(point.position[0], point.position[1], point.position[2]));
+    }
+    TrackMesh track;
+    track.build(points);
+    Terrain terrain;
+    terrain.generate(1);
+
+    PvsOccluders occluders;
+    forEachSceneOccluder(scene, [&](const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d) {
+        occluders.addQuad(a, b, c, d);
+    });
+    for (const Aabb& box : terrain.occluderBoxes(16, 1.0f)) occluders.addBox(box);
+    occluders.build();
+
+    std::vector<Aabb> areas, objects;
+    for (const TrackChunk& chunk : track.chunks()) {
+        areas.push_back(chunk.bounds);
+        objects.push_back(chunk.bounds);
+    }
+    for (const TerrainChunk& chunk : terrain.chunks()) objects.push_back(chunk.bounds);
+    PotentiallyVisibleSet pvs;
+    pvs.bake(pvsCellsAround(areas, 6.0f, 8.0f), objects, occluders);
+    const PvsBakeStats& stats = pvs.bakeStats();
+    cout << "  " << pvs.cellCount() << " cells x " << pvs.objectCount() << " objects, " << occluders.count()
+         << " occluders: bake " << fixed << setprecision(2) << stats.seconds << " s, " << stats.rays / 1000 << "k rays ("
+         << setprecision(1) << stats.rays / std::max(1e-9, stats.seconds) / 1e6 << " M/s), "
+         << stats.visiblePairs / std::max(1, pvs.cellCount()) << " objects visible per cell" << endl;
+
+    const int frames = 2000;
+    size_t visible = 0;
+    BenchClock::time_point start = BenchClock::now();
+    for (int f = 0; f < frames; ++f) {
+        glm::vec3 position, tangent;
+        track.frameAt(track.length() * f / frames, position, tangent);
+        int cell = pvs.cellAt(position + glm::vec3(0.0f, 2.0f, 0.0f) - tangent * 5.0f);
+        if (cell < 0) continue;
+        for (int o = 0; o < pvs.objectCount(); ++o) visible += pvs.visible(cell, o);
+    }
+    cout << "  lookup " << setprecision(2) << secondsSince(start) * 1e6 / frames << " us per frame for every object, "
+         << visible / frames << " visible; " << pvs.memoryBytes() / 1024 << " KB" << endl;
+}
+
+struct Benchmark {
+    const char* name;
+    void (*run)();
+};
+
+int main(int argc, char* argv[])
+{
+    const Benchmark benchmarks[] = {
+        { "vehicles", benchVehicles },
+        { "bvh",      benchBvh },
+        { "broadphase", benchBroadphase },
+        { "traffic",  benchTraffic },
+        { "instances", benchInstances },
+        { "scene",    benchScene },
+        { "profiler", benchProfiler },
+        { "export",   benchExport },
+        { "terrain",  benchTerrain },
+        { "track",    benchTrack },
+        { "occlusion", benchOcclusion },
+        { "pvs",      benchPvs },
+    };
+
+    for (const Benchmark& b : benchmarks) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i)
+            if (strcmp(argv[i], b.name) == 0) selected = true;
+        if (selected) b.run();
+    }
+    return 0;
+}
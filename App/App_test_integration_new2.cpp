@@ -4,6 +4,9 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <cstring>
+#include <algorithm>
+#include <cstdlib>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -22,6 +25,29 @@
 #include <cassert>
 #include <glm/common.hpp>
 
+#include "Engine/FixedTimestep.h"
+#include "Engine/Simulation.h"
+#include "Engine/Terrain.h"
+#include "Engine/TrackStreamer.h"
+#include "Engine/OcclusionCulling.h"
+#include "Engine/Pvs.h"
+#include "Engine/SceneFile.h"
+#include "Engine/Frustum.h"
+#include "Engine/JobSystem.h"
+#include "Engine/Profiler.h"
+#include "Engine/GpuTimer.h"
+#include "Engine/GlState.h"
+#include "Engine/Hud.h"
+#include "Engine/ResourceRegistry.h"
+#include "Engine/FrameReadback.h"
+#include "Engine/RenderTarget.h"
+#include "Engine/TiledScreenshot.h"
+#include "Engine/DynamicResolution.h"
+#include "Engine/InputQueue.h"
+#include "Engine/FramePacer.h"
+#include "Engine/TransformHierarchy.h"
+#include "Engine/Ecs.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
@@ -37,21 +63,11 @@ float skyQuad[] = {
      1.0f, -1.0f, 0.0f,  1, 1, 1,  1.0f, 0.0f
 };
 
-// Mouse state
-double lastX = 0.0f, lastY = 0.0f;
-float yaw = 0.0f;
-bool firstMouse = true;
-
-
-// Car State 
-glm::vec3 carPos = glm::vec3(0.0f, 0.0f, 5.0f);
-float carYaw = 0.0f;
-float wheelAngle = 0.0f;
-float steerAngle = 0.0f;
 GLsizei wheelIndexCount;
 
 // ---------- Tweakable tuning constants ----------
 const float WHEEL_SCALE   = 0.52f;   // final visual radius = base‑radius (0.5) × 0.52 ≈ 0.26
+const int   CAR_INSTANCE_GRAIN = 256;   // cars (or rig nodes) per job
 
 
 
@@ -162,6 +178,30 @@ const char* getTexturedVertexShaderSource()
                 "}";
 }
 
+// Same as the textured shader, but the world matrix comes per instance (attributes 3-6)
+const char* getInstancedTexturedVertexShaderSource()
+{
+    return
+                "#version 330 core\n"
+                "layout (location = 0) in vec3 aPos;"
+                "layout (location = 1) in vec3 aColor;"
+                "layout (location = 2) in vec2 aUV;"
+                "layout (location = 3) in mat4 instanceWorld;"
+                ""
+                "uniform mat4 view = mat4(1.0);"
+                "uniform mat4 projection = mat4(1.0);"
+                "uniform float uvScale;"
+                ""
+                "out vec3 vertexColor;"
+                "out vec2 vertexUV;"
+                "void main()"
+                "{"
+                "   vertexColor = aColor;"
+                "   gl_Position = projection * view * instanceWorld * vec4(aPos, 1.0);"
+                "   vertexUV = aUV * uvScale;"
+                "}";
+}
+
 const char* getTexturedFragmentShaderSource()
 {
     return
@@ -183,6 +223,111 @@ const char* getTexturedFragmentShaderSource()
         "}";
 }
 
+// Terrain chunks (Engine/Terrain.h): each vertex is a grid coordinate inside the chunk. The
+// height is read from the heightmap and morphed towards the next level's edge as the vertex
+// gets further away; the normal comes from the neighbouring heights.
+const char* getTerrainVertexShaderSource()
+{
+    return
+        "#version 330 core\n"
+        "layout (location = 0) in vec2 aGrid;"
+        ""
+        "uniform mat4 view = mat4(1.0);"
+        "uniform mat4 projection = mat4(1.0);"
+        "uniform sampler2D heightmap;"
+        "uniform vec3 terrainGrid;"      // world x and z of the first height, spacing
+        "uniform vec2 chunkTexel;"       // heightmap texel of the chunk's corner
+        "uniform float lodStep;"         // grid step of the chunk's level
+        "uniform vec2 morphRange;"
+        "uniform vec3 cameraPosition;"
+        ""
+        "out vec3 vertexColor;"
+        "out vec2 vertexUV;"
+        "out float cameraDistance;"
+        "float heightAt(ivec2 texel)"
+        "{"
+        "   return texelFetch(heightmap, clamp(texel, ivec2(0), textureSize(heightmap, 0) - 1), 0).r;"
+        "}"
+        "void main()"
+        "{"
+        "   int lodGrid = int(lodStep);"
+        "   ivec2 grid = ivec2(aGrid);"
+        "   ivec2 texel = ivec2(chunkTexel) + grid;"
+        "   vec3 position = vec3(terrainGrid.x + texel.x * terrainGrid.z, heightAt(texel), terrainGrid.y + texel.y * terrainGrid.z);"
+        "   ivec2 odd = (grid / lodGrid) & 1;"   // not on the next level's grid: lies on one of its edges
+        "   float coarse = 0.5 * (heightAt(texel - odd * lodGrid) + heightAt(texel + odd * lodGrid));"
+        "   float morph = clamp((distance(position, cameraPosition) - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);"
+        "   position.y = mix(position.y, coarse, morph);"
+        "   vec3 normal = normalize(vec3(heightAt(texel - ivec2(1, 0)) - heightAt(texel + ivec2(1, 0)), 2.0 * terrainGrid.z,"
+        "                                heightAt(texel - ivec2(0, 1)) - heightAt(texel + ivec2(0, 1))));"
+        "   vec3 light = normalize(vec3(0.4, 0.8, 0.3));"
+        "   vertexColor = vec3(min(1.0, 0.55 + 0.45 * max(dot(normal, light), 0.0) / light.y));"   // flat ground unshaded
+        "   vertexUV = position.xz;"          // one texture repeat per metre, like the old floor
+        "   cameraDistance = distance(position, cameraPosition);"
+        "   gl_Position = projection * view * vec4(position, 1.0);"
+        "}";
+}
+
+// Textured and shaded, fading into the sky colour towards the far plane
+const char* getTerrainFragmentShaderSource()
+{
+    return
+        "#version 330 core\n"
+        "in vec3 vertexColor;"
+        "in vec2 vertexUV;"
+        "in float cameraDistance;"
+        "uniform sampler2D textureSampler;"
+        "uniform vec3 fogColor;"
+        "uniform vec2 fogRange;"
+        "out vec4 FragColor;"
+        "void main()"
+        "{"
+        "    vec3 color = texture(textureSampler, vertexUV).rgb * vertexColor;"
+        "    float fog = clamp((cameraDistance - fogRange.x) / (fogRange.y - fogRange.x), 0.0, 1.0);"
+        "    FragColor = vec4(mix(color, fogColor, fog), 1.0);"
+        "}";
+}
+
+// HUD: the textured pipeline in screen space. Each instance is a rectangle in pixels with
+// its own atlas UVs and color; the atlas holds distance fields, thresholded at 0.5.
+const char* getHudVertexShaderSource()
+{
+    return
+                "#version 330 core\n"
+                "layout (location = 0) in vec2 aCorner;"           // unit quad
+                "layout (location = 3) in vec4 instanceRect;"      // x, y, width, height in pixels, y down
+                "layout (location = 4) in vec4 instanceUV;"
+                "layout (location = 5) in vec4 instanceColor;"
+                ""
+                "uniform vec2 screenSize;"
+                ""
+                "out vec2 vertexUV;"
+                "out vec4 vertexColor;"
+                "void main()"
+                "{"
+                "   vec2 pixel = instanceRect.xy + aCorner * instanceRect.zw;"
+                "   gl_Position = vec4(pixel.x / screenSize.x * 2.0 - 1.0, 1.0 - pixel.y / screenSize.y * 2.0, 0.0, 1.0);"
+                "   vertexUV = mix(instanceUV.xy, instanceUV.zw, aCorner);"
+                "   vertexColor = instanceColor;"
+                "}";
+}
+
+const char* getHudFragmentShaderSource()
+{
+    return
+        "#version 330 core\n"
+        "in vec2 vertexUV;"
+        "in vec4 vertexColor;"
+        "uniform sampler2D textureSampler;"
+        "out vec4 FragColor;"
+        "void main()"
+        "{"
+        "    float distance = texture(textureSampler, vertexUV).r;"
+        "    float edge = max(fwidth(distance), 0.001);"
+        "    FragColor = vec4(vertexColor.rgb, vertexColor.a * smoothstep(0.5 - edge, 0.5 + edge, distance));"
+        "}";
+}
+
 GLuint loadTexture(const char *filename)
 {
     // Step 1 load Textures with dimension data
@@ -215,6 +360,7 @@ GLuint loadTexture(const char *filename)
     else if (nrChannels == 4)
         format = GL_RGBA;
     glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    resources().trackGpu(GPU_TEXTURE, textureId, size_t(width) * height * nrChannels, filename);
 
     std::cout << "Texture " << filename << " channels: " << nrChannels << std::endl;
 
@@ -224,16 +370,45 @@ GLuint loadTexture(const char *filename)
     return textureId;
 }
 
+// ---------- Tracked GL objects ----------
+// Every buffer, texture and vertex array is registered with resources() when it is created
+// and released here, so the exit report can list whatever was never deleted
+void trackVertexArray(GLuint VAO, const std::string& owner) { resources().trackGpu(GPU_VERTEX_ARRAY, VAO, 0, owner); }
+void trackBuffer(GLuint buffer, size_t bytes, const std::string& owner) { resources().trackGpu(GPU_BUFFER, buffer, bytes, owner); }
+
+void deleteVertexArray(GLuint& VAO)
+{
+    resources().releaseGpu(GPU_VERTEX_ARRAY, VAO);
+    glDeleteVertexArrays(1, &VAO);
+    VAO = 0;
+}
+
+void deleteBuffer(GLuint& buffer)
+{
+    resources().releaseGpu(GPU_BUFFER, buffer);
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void deleteTexture(GLuint& texture)
+{
+    resources().releaseGpu(GPU_TEXTURE, texture);
+    glDeleteTextures(1, &texture);
+    texture = 0;
+}
+
 // Create a Vertex Array Object (VAO) and Vertex Buffer Object (VBO) for the vertices
-GLuint createVAO(float* vertices, size_t size) {
-    GLuint VAO, VBO;
+GLuint createVAO(float* vertices, size_t size, GLuint& VBO, const std::string& owner) {
+    GLuint VAO;
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
+    trackVertexArray(VAO, owner);
     
     glBindVertexArray(VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+    trackBuffer(VBO, size, owner);
 
     // position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
@@ -246,15 +421,17 @@ GLuint createVAO(float* vertices, size_t size) {
     return VAO;
 }
 
-GLuint createTexturedVAO(float* vertices, size_t size) {
-    GLuint VAO, VBO;
+GLuint createTexturedVAO(float* vertices, size_t size, GLuint& VBO, const std::string& owner) {
+    GLuint VAO;
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
+    trackVertexArray(VAO, owner);
     
     glBindVertexArray(VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+    trackBuffer(VBO, size, owner);
 
     //position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);              
@@ -299,6 +476,9 @@ void createCubeVAO(GLuint &VAO, GLuint &VBO, GLuint &EBO) {
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    trackVertexArray(VAO, "car body");
+    trackBuffer(VBO, sizeof(vertices), "car body");
+    trackBuffer(EBO, sizeof(indices), "car body");
     glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,8*sizeof(float),(void*)0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,8*sizeof(float),(void*)(3*sizeof(float)));
@@ -337,6 +517,9 @@ void createCabinVAO(GLuint &VAO, GLuint &VBO, GLuint &EBO) {
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    trackVertexArray(VAO, "car cabin");
+    trackBuffer(VBO, sizeof(vertices), "car cabin");
+    trackBuffer(EBO, sizeof(indices), "car cabin");
     glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,8*sizeof(float),(void*)0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,8*sizeof(float),(void*)(3*sizeof(float)));
@@ -431,6 +614,9 @@ void createWheelVAO(GLuint &VAO, GLuint &VBO, GLuint &EBO, int segments = 32) {
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, inds.size() * sizeof(unsigned int), inds.data(), GL_STATIC_DRAW);
+    trackVertexArray(VAO, "wheel");
+    trackBuffer(VBO, verts.size() * sizeof(float), "wheel");
+    trackBuffer(EBO, inds.size() * sizeof(unsigned int), "wheel");
 
     // Position
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
@@ -456,8 +642,17 @@ void createWheelVAO(GLuint &VAO, GLuint &VBO, GLuint &EBO, int segments = 32) {
 struct ModelData {
     GLuint VAO;
     GLsizei indexCount;
+    Aabb bounds;        // model space
+    GLuint VBO, EBO;
 };
 
+void deleteModel(ModelData& model)
+{
+    deleteVertexArray(model.VAO);
+    deleteBuffer(model.VBO);
+    deleteBuffer(model.EBO);
+}
+
 ModelData loadModelWithAssimp(const std::string& path) {
     Assimp::Importer importer;
     const aiScene* scene = importer.ReadFile(path, 
@@ -471,10 +666,12 @@ ModelData loadModelWithAssimp(const std::string& path) {
 
     std::vector<float> vertices;
     std::vector<unsigned int> indices;
+    Aabb bounds;
 
     for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
         aiVector3D pos = mesh->mVertices[i];
         aiVector3D normal = mesh->mNormals[i];
+        bounds.grow(glm::vec3(pos.x, pos.y, pos.z));
 
         // Position
         vertices.push_back(pos.x);
@@ -518,6 +715,9 @@ ModelData loadModelWithAssimp(const std::string& path) {
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    trackVertexArray(VAO, path);
+    trackBuffer(VBO, vertices.size() * sizeof(float), path);
+    trackBuffer(EBO, indices.size() * sizeof(unsigned int), path);
 
     // Set attribute pointers based on this vertex layout:
     // 3 floats position, 3 floats color, 2 floats UV => stride = 8 floats
@@ -536,7 +736,7 @@ ModelData loadModelWithAssimp(const std::string& path) {
 
     glBindVertexArray(0);
 
-    return { VAO, static_cast<GLsizei>(indices.size()) };
+    return { VAO, static_cast<GLsizei>(indices.size()), bounds, VBO, EBO };
 }
 
 
@@ -548,28 +748,666 @@ ModelData loadModelWithAssimp(const std::string& path) {
 void setProjectionMatrix(int shaderProgram, const glm::mat4& projectionMatrix)
 {
     GLuint location = glGetUniformLocation(shaderProgram, "projection");
-    glUniformMatrix4fv(location, 1, GL_FALSE, &projectionMatrix[0][0]);
+    glsUniformMatrix4fv(location, GL_FALSE, &projectionMatrix[0][0]);
 }
 
 void setViewMatrix(int shaderProgram, const glm::mat4& viewMatrix)
 {
     GLuint location = glGetUniformLocation(shaderProgram, "view");
-    glUniformMatrix4fv(location, 1, GL_FALSE, &viewMatrix[0][0]);
+    glsUniformMatrix4fv(location, GL_FALSE, &viewMatrix[0][0]);
 }
 
 void setWorldMatrix(int shaderProgram, const glm::mat4& worldMatrix)
 {
     GLuint location = glGetUniformLocation(shaderProgram, "world");
-    glUniformMatrix4fv(location, 1, GL_FALSE, &worldMatrix[0][0]);
+    glsUniformMatrix4fv(location, GL_FALSE, &worldMatrix[0][0]);
+}
+
+// Scenery instances sorted by mesh, then material, so drawing them switches VAOs and
+// textures as rarely as possible
+std::vector<int> sceneryDrawOrder(const SceneFile& sceneFile)
+{
+    std::vector<int> order(sceneFile.instanceCount());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = static_cast<int>(i);
+    const SceneInstance* instances = sceneFile.instances();
+    std::stable_sort(order.begin(), order.end(), [instances](int a, int b) {
+        if (instances[a].mesh != instances[b].mesh) return instances[a].mesh < instances[b].mesh;
+        return instances[a].material < instances[b].material;
+    });
+    return order;
+}
+
+// Draw every visible scenery instance; models[] and textures[] are indexed by the scene's mesh and material ids.
+// Each mesh is one GPU timer pass, labelled with its scene name.
+void drawScenery(int shaderProgram, const SceneFile& sceneFile, const std::vector<int>& drawOrder,
+                 const std::vector<uint8_t>& visible, const std::vector<ModelData>& models,
+                 const std::vector<GLuint>& textures, GLint uvScaleLocation, GpuPassTimer& gpuTimer)
+{
+    const SceneInstance* instances = sceneFile.instances();
+    uint32_t boundMesh = UINT32_MAX, boundMaterial = UINT32_MAX;
+    for (int i : drawOrder) {
+        const SceneInstance& instance = instances[i];
+        if (!visible[i]) continue;
+        if (instance.mesh != boundMesh) {
+            boundMesh = instance.mesh;
+            gpuTimer.endPass();
+            gpuTimer.beginPass(sceneFile.meshes()[boundMesh].name);
+            glsBindVertexArray(models[boundMesh].VAO);
+        }
+        if (instance.material != boundMaterial) {
+            boundMaterial = instance.material;
+            glsBindTexture(GL_TEXTURE_2D, textures[boundMaterial]);
+        }
+        glsUniform1f(uvScaleLocation, instance.uvScale);
+        setWorldMatrix(shaderProgram, instance.modelMatrix());
+        glsDrawElements(GL_TRIANGLES, models[boundMesh].indexCount, GL_UNSIGNED_INT, 0);
+    }
+    gpuTimer.endPass();
+}
+
+// ---------- Terrain ----------
+const uint32_t TERRAIN_SEED = 1;
+const float VIEW_DISTANCE = 4000.0f;                    // far plane; the terrain fades into the sky before it
+
+// GL side of Engine/Terrain.h: the heights as a float texture, plus the chunk grid and the
+// index lists of every level, shared by all chunks
+struct TerrainMesh {
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLuint heightmap = 0;
+    TerrainLod lods[TERRAIN_LODS];
+    GLint chunkTexelLocation = -1, lodStepLocation = -1, morphRangeLocation = -1, cameraLocation = -1;
+};
+
+TerrainMesh createTerrainMesh(const Terrain& terrain, int shaderProgram, const glm::vec3& fogColor, float viewDistance)
+{
+    TerrainMesh mesh;
+    glGenTextures(1, &mesh.heightmap);
+    glBindTexture(GL_TEXTURE_2D, mesh.heightmap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);   // read with texelFetch only
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, terrain.size(), terrain.size(), 0, GL_RED, GL_FLOAT, terrain.heights());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    resources().trackGpu(GPU_TEXTURE, mesh.heightmap, size_t(terrain.size()) * terrain.size() * sizeof(float), "terrain");
+
+    std::vector<float> vertices = terrainGridVertices();
+    std::vector<uint16_t> indices = terrainLodIndices(mesh.lods);
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glGenBuffers(1, &mesh.EBO);
+    glBindVertexArray(mesh.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    trackVertexArray(mesh.VAO, "terrain");
+    trackBuffer(mesh.VBO, vertices.size() * sizeof(float), "terrain");
+    trackBuffer(mesh.EBO, indices.size() * sizeof(uint16_t), "terrain");
+
+    // Uniforms that never change
+    glUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "textureSampler"), 0);
+    glUniform1i(glGetUniformLocation(shaderProgram, "heightmap"), 1);
+    glUniform3f(glGetUniformLocation(shaderProgram, "terrainGrid"), terrain.origin(), terrain.origin(), TERRAIN_SPACING);
+    glUniform3f(glGetUniformLocation(shaderProgram, "fogColor"), fogColor.x, fogColor.y, fogColor.z);
+    glUniform2f(glGetUniformLocation(shaderProgram, "fogRange"), viewDistance * 0.25f, viewDistance);
+    mesh.chunkTexelLocation = glGetUniformLocation(shaderProgram, "chunkTexel");
+    mesh.lodStepLocation = glGetUniformLocation(shaderProgram, "lodStep");
+    mesh.morphRangeLocation = glGetUniformLocation(shaderProgram, "morphRange");
+    mesh.cameraLocation = glGetUniformLocation(shaderProgram, "cameraPosition");
+    return mesh;
+}
+
+void deleteTerrainMesh(TerrainMesh& mesh)
+{
+    deleteVertexArray(mesh.VAO);
+    deleteBuffer(mesh.VBO);
+    deleteBuffer(mesh.EBO);
+    deleteTexture(mesh.heightmap);
+}
+
+// One draw per selected chunk, with its corner, level and morph range; the terrain program
+// must be current
+void drawTerrain(const TerrainMesh& mesh, const Terrain& terrain, const std::vector<TerrainDraw>& draws,
+                 const glm::vec3& cameraPosition, GLuint texture)
+{
+    glsActiveTexture(GL_TEXTURE1);
+    glsBindTexture(GL_TEXTURE_2D, mesh.heightmap);
+    glsActiveTexture(GL_TEXTURE0);
+    glsBindTexture(GL_TEXTURE_2D, texture);
+    glsUniform3f(mesh.cameraLocation, cameraPosition.x, cameraPosition.y, cameraPosition.z);
+    glsBindVertexArray(mesh.VAO);
+    for (const TerrainDraw& draw : draws) {
+        const TerrainChunk& chunk = terrain.chunks()[draw.chunk];
+        glm::vec2 morph = terrain.morphRange(draw.lod);
+        glsUniform2f(mesh.chunkTexelLocation, float(chunk.texelX), float(chunk.texelZ));
+        glsUniform1f(mesh.lodStepLocation, float(1 << draw.lod));
+        glsUniform2f(mesh.morphRangeLocation, morph.x, morph.y);
+        const TerrainLod& lod = mesh.lods[draw.lod];
+        glsDrawElements(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_SHORT, (void*)(lod.firstIndex * sizeof(uint16_t)));
+    }
+}
+
+// ---------- Track ----------
+// drawTrack()'s multi-draw arguments, kept between frames
+struct TrackDrawLists {
+    std::vector<GLint> baseVertices;
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+};
+
+// Draw the resident, visible chunks streamed by Engine/TrackStreamer.h with the textured
+// shader: one GPU timer pass, texture and multi-draw per surface, each chunk at its slot's
+// base vertex. Returns the number of chunks drawn.
+int drawTrack(int shaderProgram, const TrackStreamer& streamer, const std::vector<uint8_t>& visible,
+              const GLuint (&textures)[TRACK_SURFACE_COUNT], TrackDrawLists& lists, GpuPassTimer& gpuTimer)
+{
+    std::vector<GLint>& baseVertices = lists.baseVertices;
+    baseVertices.clear();
+    for (int slot = 0; slot < TRACK_STREAM_SLOTS; ++slot) {
+        int chunk = streamer.slotChunk(slot);
+        if (chunk >= 0 && visible[chunk]) baseVertices.push_back(TrackStreamer::slotBaseVertex(slot));
+    }
+    GLsizei drawCount = static_cast<GLsizei>(baseVertices.size());
+
+    setWorldMatrix(shaderProgram, glm::mat4(1.0f));
+    glsBindVertexArray(streamer.vertexArray());
+    for (int surface = 0; surface < TRACK_SURFACE_COUNT; ++surface) {
+        const TrackSurfaceRange& range = streamer.surfaceRange(surface);
+        lists.counts.assign(drawCount, range.indexCount);
+        lists.offsets.assign(drawCount, (const void*)(range.firstIndex * sizeof(uint16_t)));
+        gpuTimer.beginPass(TRACK_SURFACE_NAMES[surface]);
+        glsBindTexture(GL_TEXTURE_2D, textures[surface]);
+        glsMultiDrawElementsBaseVertex(GL_TRIANGLES, lists.counts.data(), GL_UNSIGNED_SHORT, lists.offsets.data(), drawCount,
+                                       baseVertices.data());
+        gpuTimer.endPass();
+    }
+    return drawCount;
+}
+
+// ---------- Occlusion culling ----------
+const int OCCLUSION_TERRAIN_CELL = 32;                  // heightmap quads per terrain occluder side (64 m)
+const float OCCLUSION_TERRAIN_MIN_HEIGHT = 3.0f;        // lower cells hide too little to be worth drawing
+
+// Occluders for Engine/OcclusionCulling.h: the scene's occluder quads on every instance of
+// their mesh, and boxes under the hills
+void buildOccluders(OcclusionCuller& occlusion, const SceneFile& sceneFile, const Terrain& terrain)
+{
+    occlusion.clearOccluders();
+    forEachSceneOccluder(sceneFile, [&](const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d) {
+        occlusion.addQuad(a, b, c, d);
+    });
+    for (const Aabb& box : terrain.occluderBoxes(OCCLUSION_TERRAIN_CELL, OCCLUSION_TERRAIN_MIN_HEIGHT))
+        occlusion.addBox(box);
+}
+
+// ---------- Potentially-visible sets ----------
+const float PVS_CELL_MARGIN = 6.0f;                     // metres round a track chunk its cell reaches (the boom is 5 m)
+const float PVS_CELL_HEIGHT = 8.0f;                     // metres above the road
+const int PVS_TERRAIN_CELL = 16;                        // 32 m, half the buffer's: the finest occluderBoxes() allows
+const float PVS_TERRAIN_MIN_HEIGHT = 1.0f;
+
+// Occluders for Engine/Pvs.h: the same kinds as buildOccluders(), finer. Built (for ray
+// tests) only when baking; loading just checks the sets were baked from them.
+void addPvsOccluders(PvsOccluders& occluders, const SceneFile& sceneFile, const Terrain& terrain)
+{
+    forEachSceneOccluder(sceneFile, [&](const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d) {
+        occluders.addQuad(a, b, c, d);
+    });
+    for (const Aabb& box : terrain.occluderBoxes(PVS_TERRAIN_CELL, PVS_TERRAIN_MIN_HEIGHT))
+        occluders.addBox(box);
+}
+
+// Objects the sets cover, in bit order: the scenery instances, then the track chunks,
+// then the terrain chunks. Cars move, so they are not in the sets.
+std::vector<Aabb> pvsObjects(const std::vector<Aabb>& sceneryBounds, const TrackMesh& track, const Terrain& terrain)
+{
+    std::vector<Aabb> objects = sceneryBounds;
+    for (const TrackChunk& chunk : track.chunks()) objects.push_back(chunk.bounds);
+    for (const TerrainChunk& chunk : terrain.chunks()) objects.push_back(chunk.bounds);
+    return objects;
+}
+
+// One cell round every track chunk: the places a camera following the car looks from
+std::vector<Aabb> pvsCells(const TrackMesh& track)
+{
+    std::vector<Aabb> areas;
+    for (const TrackChunk& chunk : track.chunks()) areas.push_back(chunk.bounds);
+    return pvsCellsAround(areas, PVS_CELL_MARGIN, PVS_CELL_HEIGHT);
+}
+
+// Objects that passed the frustum test but were hidden, what was rasterized to hide
+// them, and the frames culled with visible sets instead, summed over the report's frames
+struct OcclusionReport {
+    long long occluders = 0, quads = 0, pvsFrames = 0;
+    long long scenery = 0, trackChunks = 0, terrainChunks = 0, cars = 0;
+};
+
+// Feed a mesh VAO one mat4 per instance from instanceVBO (attribute locations 3-6)
+void attachInstanceMatrices(GLuint VAO, GLuint instanceVBO)
+{
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (int column = 0; column < 4; ++column) {
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribDivisor(3 + column, 1);
+    }
+    glBindVertexArray(0);
+}
+
+// Map storage for this frame's instance matrices (16 floats each) so they can be written
+// in place. The buffer is orphaned first so the driver can hand us fresh storage instead
+// of waiting for last frame's draws to finish with it. NULL when empty or mapping fails.
+float* mapInstanceMatrices(GLuint instanceVBO, size_t count)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+    resources().resizeGpu(GPU_BUFFER, instanceVBO, count * sizeof(glm::mat4));
+    if (count == 0) return NULL;
+    return static_cast<float*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4),
+                                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+}
+
+void unmapInstanceMatrices(GLuint instanceVBO)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if (glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE)
+        std::cerr << "Instance buffer contents lost while mapped" << std::endl;
+}
+
+// ---------- Photo mode ----------
+const int PHOTO_TILE_SIZE = 2048;                    // pixels, clamped to what the driver supports
+const int PHOTO_DEFAULT_WIDTH = 7680;
+
+// Render an imageWidth x imageHeight screenshot tile by tile into one reused FBO, writing
+// each tile to the TGA as soon as it is read back. drawScene(projection) draws the world
+// into the bound framebuffer. Leaves the default framebuffer bound; the caller restores
+// the viewport.
+bool renderTiledScreenshot(const std::string& path, int imageWidth, int imageHeight, const glm::mat4& projection,
+                           const std::function<void(const glm::mat4&)>& drawScene)
+{
+    GLint maxRenderbuffer = 0;
+    GLint maxViewport[2] = { 0, 0 };
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbuffer);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewport);
+    int tileSize = std::min(std::min(PHOTO_TILE_SIZE, static_cast<int>(maxRenderbuffer)),
+                            std::min(static_cast<int>(maxViewport[0]), static_cast<int>(maxViewport[1])));
+    int tileWidth = std::min(tileSize, imageWidth);
+    int tileHeight = std::min(tileSize, imageHeight);
+
+    TgaTileWriter writer;
+    if (!writer.open(path, imageWidth, imageHeight)) return false;
+    RenderTarget tile;
+    if (!tile.create(tileWidth, tileHeight, "photo tile")) {
+        writer.close();
+        return false;
+    }
+    std::vector<uint8_t> pixels(size_t(tileWidth) * tileHeight * 4);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, tile.framebuffer);
+    glViewport(0, 0, tileWidth, tileHeight);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (int y = 0; y < imageHeight; y += tileHeight) {
+        for (int x = 0; x < imageWidth; x += tileWidth) {
+            // Tiles on the right and top edges are rendered at full size, so every tile has the
+            // same pixel scale, and only the part inside the image is kept
+            drawScene(tileProjection(projection, imageWidth, imageHeight, x, y, tileWidth, tileHeight));
+            int w = std::min(tileWidth, imageWidth - x);
+            int h = std::min(tileHeight, imageHeight - y);
+            glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            writer.writeTile(x, y, w, h, pixels.data());
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    tile.destroy();
+    if (!writer.close()) {
+        std::cerr << "Failed to write photo " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// ---------- Performance HUD ----------
+const int HUD_GRAPH_FRAMES = 120;
+const float HUD_TEXT_SIZE = 16.0f;                   // pixels
+const char* const HUD_CPU_PHASES[] = { "simulation", "update", "cloud pass", "terrain", "props",
+                                       "car", "birds", "hud", "swap", "input", "pacing" };
+
+// Unit quad (triangle strip) plus one HudQuad per instance at attributes 3-5
+void createHudVAO(GLuint& VAO, GLuint& quadVBO, GLuint& instanceVBO)
+{
+    const float corners[] = { 0, 0,  0, 1,  1, 0,  1, 1 };
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &quadVBO);
+    glGenBuffers(1, &instanceVBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    trackVertexArray(VAO, "hud");
+    trackBuffer(quadVBO, sizeof(corners), "hud");
+    trackBuffer(instanceVBO, 0, "hud");
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (int field = 0; field < 3; ++field) {
+        glVertexAttribPointer(3 + field, 4, GL_FLOAT, GL_FALSE, sizeof(HudQuad), (void*)(field * 4 * sizeof(float)));
+        glEnableVertexAttribArray(3 + field);
+        glVertexAttribDivisor(3 + field, 1);
+    }
+    glBindVertexArray(0);
+}
+
+// Distance field atlas in a one-channel texture
+GLuint createHudAtlasTexture(const HudAtlas& atlas)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas.width, atlas.height, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.texels.data());
+    resources().trackGpu(GPU_TEXTURE, texture, size_t(atlas.width) * atlas.height, "hud");
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+// Lay out the overlay: frame time and graph, last frame's GL counters, then CPU phases
+// and GPU passes side by side. frameHistory is a ring whose oldest entry is at historyStart.
+void buildPerformanceHud(HudBatch& hud, const std::vector<float>& frameHistory, int historyStart,
+                         const HudTimings& cpu, const HudTimings& gpu, double gpuFrameMs, const GlFrameStats& gl,
+                         float resolutionScale)
+{
+    const HudColor panel = { 0.0f, 0.0f, 0.0f, 0.6f };
+    const HudColor text = { 1.0f, 1.0f, 1.0f, 1.0f };
+    const HudColor dim = { 0.7f, 0.7f, 0.7f, 1.0f };
+    const HudColor good = { 0.3f, 0.9f, 0.4f, 1.0f };
+    const HudColor over = { 1.0f, 0.35f, 0.25f, 1.0f };
+    const float line = HUD_TEXT_SIZE + 2.0f;
+    const float left = 16.0f, column = 170.0f, graphHeight = 60.0f;
+
+    float values[HUD_GRAPH_FRAMES];
+    for (int i = 0; i < HUD_GRAPH_FRAMES; ++i) values[i] = frameHistory[(historyStart + i) % HUD_GRAPH_FRAMES];
+    float frameMs = values[HUD_GRAPH_FRAMES - 1];
+
+    int cpuRows = 0;
+    for (const HudTimings::Entry& entry : cpu.list()) cpuRows += entry.ms >= 0.0f;
+    int rows = std::max(cpuRows, static_cast<int>(gpu.list().size()));
+    hud.clear();
+    hud.rect(8.0f, 8.0f, 2.0f * column + 8.0f, 16.0f + graphHeight + line * (5 + rows), panel);
+
+    float y = 12.0f;
+    float x = hud.text(left, y, HUD_TEXT_SIZE, "frame " + hudNumber(frameMs, 2) + " ms", text);
+    x = hud.text(x + 16.0f, y, HUD_TEXT_SIZE, hudNumber(frameMs > 0.0f ? 1000.0f / frameMs : 0.0f, 0) + " fps", dim);
+    if (resolutionScale > 0.0f) hud.text(x + 16.0f, y, HUD_TEXT_SIZE, "res " + hudNumber(resolutionScale * 100.0f, 0) + "%", dim);
+    y += line;
+    hud.graph(left, y, 2.0f * column - 16.0f, graphHeight, values, HUD_GRAPH_FRAMES, 33.3f, 16.7f, good, over);
+    y += graphHeight + 4.0f;
+
+    hud.text(left, y, HUD_TEXT_SIZE, "draws " + std::to_string(gl.drawCalls), text);
+    hud.text(left + column, y, HUD_TEXT_SIZE, "tris " + hudNumber(gl.triangles / 1000.0, 1) + "k", text);
+    y += line;
+    hud.text(left, y, HUD_TEXT_SIZE, "tex binds " + std::to_string(gl.textureBinds), text);
+    hud.text(left + column, y, HUD_TEXT_SIZE, "programs " + std::to_string(gl.programSwitches), text);
+    y += line;
+    hud.text(left, y, HUD_TEXT_SIZE, "uniforms " + std::to_string(gl.uniformUpdates), text);
+    hud.text(left + column, y, HUD_TEXT_SIZE, "redundant " + std::to_string(gl.redundant()) + (glsElision() ? " cut" : ""),
+             gl.redundant() > 0 && !glsElision() ? over : text);
+    y += line;
+
+    hud.text(left, y, HUD_TEXT_SIZE, "cpu ms", dim);
+    hud.text(left + column, y, HUD_TEXT_SIZE, "gpu " + hudNumber(gpuFrameMs, 2) + " ms", dim);
+    y += line;
+    float rowY = y;
+    for (const HudTimings::Entry& entry : cpu.list()) {
+        if (entry.ms < 0.0f) continue;
+        hud.text(left, rowY, HUD_TEXT_SIZE, entry.name, text);
+        hud.text(left + column - 56.0f, rowY, HUD_TEXT_SIZE, hudNumber(entry.ms, 2), text);
+        rowY += line;
+    }
+    rowY = y;
+    for (const HudTimings::Entry& entry : gpu.list()) {
+        hud.text(left + column, rowY, HUD_TEXT_SIZE, entry.name, text);
+        hud.text(left + 2.0f * column - 56.0f, rowY, HUD_TEXT_SIZE, hudNumber(entry.ms, 2), text);
+        rowY += line;
+    }
+}
+
+// Car parts as a transform hierarchy. Nodes are added one block per part kind, so the
+// body, cabin and wheel blocks are laid out exactly like the instance buffers.
+//   root (position, yaw) -> body frame (pitch, roll) -> body mesh, cabin mesh
+//   root -> wheel mount (offset, steer) -> wheel mesh (spin, scale)
+struct CarRig {
+    int count = 0;
+    int roots, bodyFrames, wheelMounts;     // first node of each block
+    int bodies, cabins, wheels;
+};
+
+const glm::vec3 AXIS_X(1, 0, 0), AXIS_Y(0, 1, 0), AXIS_Z(0, 0, 1);
+
+CarRig buildCarRig(TransformHierarchy& transforms, int count)
+{
+    transforms.clear();
+    CarRig rig;
+    rig.count = count;
+
+    rig.roots = transforms.size();
+    for (int car = 0; car < count; ++car) transforms.add(-1);
+    rig.bodyFrames = transforms.size();
+    for (int car = 0; car < count; ++car) transforms.add(rig.roots + car);
+
+    // Wheels: x side outer, z side inner (rear, front); front wheels also steer
+    float wheelX = 0.75f, wheelZ = 1.10f;
+    rig.wheelMounts = transforms.size();
+    for (int car = 0; car < count; ++car)
+        for (int i = -1; i <= 1; i += 2)
+            for (int j = -1; j <= 1; j += 2)
+                transforms.add(rig.roots + car, glm::vec3(i * wheelX, WHEEL_SCALE * 0.5f, j * wheelZ),
+                               glm::angleAxis(glm::radians(90.0f), AXIS_Y));
+
+    // Mesh nodes: fixed offsets and scales, so they are never dirty after the first update
+    rig.bodies = transforms.size();
+    for (int car = 0; car < count; ++car)
+        transforms.add(rig.bodyFrames + car, glm::vec3(0, 0.25f, 0), glm::angleAxis(glm::radians(180.0f), AXIS_Y),
+                       glm::vec3(1.35f, 0.38f, 2.7f));
+    rig.cabins = transforms.size();
+    for (int car = 0; car < count; ++car)
+        transforms.add(rig.bodyFrames + car, glm::vec3(0, 0.55f, 0), glm::angleAxis(glm::radians(180.0f), AXIS_Y),
+                       glm::vec3(0.75f, 0.4f, 2.0f));
+    rig.wheels = transforms.size();
+    for (int wheel = 0; wheel < count * VEHICLE_WHEELS; ++wheel)
+        transforms.add(rig.wheelMounts + wheel, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(WHEEL_SCALE));
+    return rig;
+}
+
+// Copy one car's render pose into its rig's local transforms
+void poseCarRig(TransformHierarchy& transforms, const CarRig& rig, int car, const VehicleRenderPose& pose)
+{
+    transforms.setLocal(rig.roots + car, pose.position, glm::angleAxis(glm::radians(pose.yaw), AXIS_Y));
+    transforms.setLocalRotation(rig.bodyFrames + car, glm::angleAxis(glm::radians(pose.pitch), AXIS_X) *
+                                                      glm::angleAxis(glm::radians(pose.roll), AXIS_Z));
+    glm::quat spin = glm::angleAxis(glm::radians(pose.wheelAngle), AXIS_Z);
+    for (int w = 0; w < VEHICLE_WHEELS; ++w) {
+        int wheel = car * VEHICLE_WHEELS + w;
+        if (w % 2 == 1)   // front
+            transforms.setLocalRotation(rig.wheelMounts + wheel, glm::angleAxis(glm::radians(90.0f + pose.steerAngle), AXIS_Y));
+        transforms.setLocalRotation(rig.wheels + wheel, spin);
+    }
+}
+
+// The bird circling above the road and the one orbiting it:
+//   pivot (above the road, turning) -> bird (offset, facing, model scale) -> orbiting bird
+struct BirdRig {
+    int pivot, bird, orbitingBird;
+};
+
+BirdRig buildBirdRig(TransformHierarchy& transforms)
+{
+    BirdRig rig;
+    rig.pivot = transforms.add(-1, glm::vec3(0.0f, 2.0f, 2.0f));
+    rig.bird = transforms.add(rig.pivot, glm::vec3(2.0f, 0.0f, 0.0f),   // Position the bird above the ground
+                              glm::angleAxis(glm::radians(90.0f), AXIS_Y) *
+                              glm::angleAxis(glm::radians(-90.0f), AXIS_X),   // Rotate the bird model to face upwards
+                              glm::vec3(0.001f));
+    rig.orbitingBird = transforms.add(rig.bird);
+    return rig;
+}
+
+void poseBirdRig(TransformHierarchy& transforms, const BirdRig& rig, float timeSeconds)
+{
+    float angle = glm::radians(timeSeconds * 60.0f); // Rotate the bird model
+    transforms.setLocalRotation(rig.pivot, glm::angleAxis(angle, AXIS_Y));
+
+    float subAngle = glm::radians(timeSeconds * 60.0f);
+    float radius = 300.0f; // Orbit radius for the second bird (in the first bird's model units)
+    transforms.setLocalPosition(rig.orbitingBird, glm::vec3(0.0f, radius * sin(subAngle), radius * cos(subAngle)));
+}
+
+// ---------- Scene entities ----------
+// Render-side scene state lives in an EcsWorld. A car entity links to its SimWorld
+// vehicle slot, whose physics and AI state is already stored SoA in VehicleBatch and
+// AiTraffic; the slot is also the car's index in the CarRig. Car entities carry a
+// VehicleRenderPose component too.
+struct SimVehicle { int slot; };
+struct Visibility { uint8_t visible; };
+struct ScenePosition { glm::vec3 value; };
+struct WorldMatrix { glm::mat4 value; };
+struct CloudBillboard {
+    GLuint textureID;
+    float speed;
+    float scale;
+};
+struct SceneCamera {
+    glm::vec3 position;
+    glm::vec3 front;
+    glm::vec3 up;
+    bool firstPerson;       // press 1 or 2 to toggle
+};
+
+// One car entity per vehicle slot, created or destroyed when the AI field changes size
+void syncCarEntities(EcsWorld& scene, std::vector<Entity>& carEntities, int vehicleCount)
+{
+    while (static_cast<int>(carEntities.size()) > vehicleCount) {
+        scene.destroy(carEntities.back());
+        carEntities.pop_back();
+    }
+    while (static_cast<int>(carEntities.size()) < vehicleCount) {
+        SimVehicle vehicle = { static_cast<int>(carEntities.size()) };
+        carEntities.push_back(scene.create(vehicle, VehicleRenderPose(), Visibility{ 1 }));
+    }
+}
+
+// ---------- Systems (one chunk per call, so each can run as its own job) ----------
+// Render pose: the player from the interpolated SimState, AI cars from the SimWorld history
+void carPoseSystem(EcsChunk& chunk, const SimWorld& world, const VehicleRenderPose& playerPose, float alpha)
+{
+    EcsWorld::eachInChunk<SimVehicle, VehicleRenderPose>(chunk, [&](Entity, SimVehicle& vehicle, VehicleRenderPose& pose) {
+        pose = vehicle.slot == PLAYER_VEHICLE ? playerPose : vehicleRenderPose(world, vehicle.slot, alpha);
+    });
+}
+
+// Returns the cars inside the frustum that the occluders hide
+int carCullingSystem(EcsChunk& chunk, const Frustum& frustum, const OcclusionCuller* occlusion)
+{
+    int occluded = 0;
+    EcsWorld::eachInChunk<VehicleRenderPose, Visibility>(chunk, [&](Entity, VehicleRenderPose& pose, Visibility& visibility) {
+        glm::vec3 center = pose.position + glm::vec3(0.0f, CAR_COLLISION_CENTER_Y, 0.0f);
+        bool inFrustum = frustum.intersectsSphere(center, CAR_BROADPHASE_RADIUS);
+        visibility.visible = inFrustum && (!occlusion || occlusion->visible(aabbFromCenterExtents(center, glm::vec3(CAR_BROADPHASE_RADIUS))));
+        occluded += inFrustum && !visibility.visible;
+    });
+    return occluded;
+}
+
+void carRigSystem(EcsChunk& chunk, TransformHierarchy& transforms, const CarRig& rig)
+{
+    EcsWorld::eachInChunk<SimVehicle, VehicleRenderPose>(chunk, [&](Entity, SimVehicle& vehicle, VehicleRenderPose& pose) {
+        poseCarRig(transforms, rig, vehicle.slot, pose);
+    });
+}
+
+// Y-axis-constrained billboarding: make each cloud face the camera
+void cloudBillboardSystem(EcsChunk& chunk, const glm::vec3& cameraPos)
+{
+    EcsWorld::eachInChunk<ScenePosition, CloudBillboard, WorldMatrix>(chunk,
+        [&](Entity, ScenePosition& position, CloudBillboard& cloud, WorldMatrix& world) {
+            glm::vec3 cloudToCamera = glm::normalize(cameraPos - position.value);
+            glm::mat4 billboardRotation = glm::inverse(glm::lookAt(glm::vec3(0), cloudToCamera, glm::vec3(0, 1, 0)));
+            billboardRotation[3] = glm::vec4(0, 0, 0, 1); // clear translation
+            world.value = glm::translate(glm::mat4(1.0f), position.value) *
+                          billboardRotation *
+                          glm::scale(glm::mat4(1.0f), glm::vec3(cloud.scale));
+        });
+}
+
+// First person looks from the camera position; third person orbits it on a boom that
+// is pulled in when scenery is in the way
+glm::mat4 cameraViewMatrix(const SceneCamera& camera, const StaticBvh& scenery)
+{
+    if (camera.firstPerson)
+        return glm::lookAt(camera.position, camera.position + camera.front, camera.up);
+    float radius = 5.0f;
+    BvhHit boomHit;
+    if (scenery.raycast(camera.position, -camera.front, radius, boomHit))
+        radius = std::max(0.0f, boomHit.t - CAMERA_COLLISION_RADIUS);
+    glm::vec3 eye = camera.position - radius * camera.front; // position is on a sphere around the camera position
+    return glm::lookAt(eye, eye + camera.front, camera.up);
 }
 
 int main(int argc, char*argv[])
 {
+    // Command line: --ai-cars N sets the size of the AI field, --scene FILE the track scene,
+    // --profile-frames N writes a profiler trace after N frames and quits.
+    // --export PATH records --export-frames N frames at --export-fps F (simulated time, not
+    // wall time) to PATH.y4m or a directory of PNGs, with --encoders N encoder threads.
+    // --photo-width N sets the width of F12 photos (the height follows the window).
+    // --target-fps N is the frame rate dynamic resolution holds (0 renders at full resolution).
+    // --pacing uncapped|vsync|cap|adaptive picks frame pacing; --fps-cap N sets the cap (and mode).
+    // --bake-pvs bakes the scene's potentially-visible sets to its .pvs file and quits.
+    int aiCars = AI_DEFAULT_CARS;
+    std::string scenePath = "Scenes/track.scene";
+    int profileFrames = 0;
+    std::string exportPath;
+    int exportFrames = 600;
+    int exportFps = 60;
+    int encoderThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 2);
+    int photoWidth = PHOTO_DEFAULT_WIDTH;
+    int targetFps = 60;
+    PacingMode pacingMode = PACING_VSYNC;
+    int fpsCap = 60;
+    bool bakePvs = false;
+    for (int i = 1; i < argc; ++i)
+        if (strcmp(argv[i], "--bake-pvs") == 0) bakePvs = true;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--ai-cars") == 0) aiCars = std::max(0, atoi(argv[i + 1]));
+        if (strcmp(argv[i], "--scene") == 0) scenePath = argv[i + 1];
+        if (strcmp(argv[i], "--profile-frames") == 0) profileFrames = std::max(0, atoi(argv[i + 1]));
+        if (strcmp(argv[i], "--export") == 0) exportPath = argv[i + 1];
+        if (strcmp(argv[i], "--export-frames") == 0) exportFrames = std::max(1, atoi(argv[i + 1]));
+        if (strcmp(argv[i], "--export-fps") == 0) exportFps = std::max(1, atoi(argv[i + 1]));
+        if (strcmp(argv[i], "--encoders") == 0) encoderThreads = std::max(1, atoi(argv[i + 1]));
+        if (strcmp(argv[i], "--target-fps") == 0) targetFps = std::max(0, atoi(argv[i + 1]));
+        if (strcmp(argv[i], "--pacing") == 0) parsePacingMode(argv[i + 1], pacingMode);
+        if (strcmp(argv[i], "--fps-cap") == 0) {
+            fpsCap = std::max(1, atoi(argv[i + 1]));
+            pacingMode = PACING_CAP;
+        }
+        if (strcmp(argv[i], "--photo-width") == 0) photoWidth = std::max(1, std::min(SCREENSHOT_MAX_SIZE, atoi(argv[i + 1])));
+    }
+    bool exporting = !exportPath.empty();
+    profiler().setThreadName("main");
+
     // Initialize GLFW and OpenGL version
     glfwInit();
     
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);   // 3.3 for instanced attributes
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_RESIZABLE, GL_TRUE); // Allow window resize
@@ -584,6 +1422,14 @@ int main(int argc, char*argv[])
     }
     glfwMakeContextCurrent(window);
 
+    // Frame pacing; export runs as fast as it can render and encode
+    const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    double refreshHz = videoMode && videoMode->refreshRate > 0 ? videoMode->refreshRate : 60.0;
+    bool swapTearSupported = glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+    FramePacer framePacer;
+    framePacer.configure(exporting ? PACING_UNCAPPED : pacingMode, fpsCap, refreshHz);
+    glfwSwapInterval(framePacer.swapInterval(swapTearSupported));
+
     glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int width, int height) {
     glViewport(0, 0, width, height);
     });
@@ -593,12 +1439,6 @@ int main(int argc, char*argv[])
     GLuint asphaltTextureID = loadTexture("Textures/asphalt.jpg");
     GLuint curbTextureID = loadTexture("Textures/curb.jpg");
     GLuint cobblestoneTextureID = loadTexture("Textures/cobblestone.jpg");
-    GLuint mountainTextureID = loadTexture("Textures/moutain.jpg"); // rock texture for hills
-    GLuint lightPoleTextureID = loadTexture("Textures/Light Pole.png");
-    // Load grandstand texture before main loop
-    GLuint grandstandTextureID = loadTexture("Textures/generic medium_01_a.png");
-    GLuint grandstandTextureB = loadTexture("Textures/generic medium_01_b.png");
-    GLuint grandstandTextureC = loadTexture("Textures/generic medium_01_c.png");
     GLuint carTexture = loadTexture("Textures/car_wrap.jpg");
     GLuint tireTexture = loadTexture("Textures/tires.jpg");
     
@@ -610,62 +1450,71 @@ int main(int argc, char*argv[])
         return -1;
     }
 
+    // Scene file: scenery meshes, materials, instances and clouds (compiled to binary on first load)
+    SceneFile sceneFile;
+    if (!loadScene(scenePath, sceneFile)) {
+        glfwTerminate();
+        return -1;
+    }
+
+    // Fixed-step simulation, rendered with interpolation between the last two states
+    FixedTimestep simClock(SIM_HZ);
+    SimState previousState;
+    SimState currentState;
+    SimInput simInput;
+    SimWorld simWorld;
+
+    // The track centreline, which the AI field drives round; a scene without a usable one
+    // fails to load like a broken file
+    std::vector<glm::vec3> trackPoints;
+    for (int i = 0; i < sceneFile.trackPointCount(); ++i) {
+        const SceneTrackPoint& point = sceneFile.trackPoints()[i];
+        trackPoints.push_back(glm::vec3(point.position[0], point.position[1], point.position[2]));
+    }
+    TrackMesh& track = simWorld.track;
+    if (!track.build(trackPoints)) {
+        std::cerr << "Scene " << scenePath << " has no usable track" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    std::vector<GLuint> sceneTextures;
+    for (int m = 0; m < sceneFile.materialCount(); ++m)
+        sceneTextures.push_back(loadTexture(sceneFile.materials()[m].texture));
+
     // Cloud setup (must be after GLEW init)
-    GLuint cloudTexture1 = loadTexture("Textures/01.png");
-    GLuint cloudTexture2 = loadTexture("Textures/02.png");
-    GLuint cloudTexture3 = loadTexture("Textures/03.png");
-    GLuint cloudVAO = createTexturedVAO(skyQuad, sizeof(skyQuad));
-
-    struct Cloud {
-        GLuint textureID;
-        glm::vec3 position;
-        float speed;
-        float scale;
-    };
-    std::vector<Cloud> clouds = {
-        {cloudTexture1, glm::vec3(-30.0f, 12.0f, 40.0f), 0.5f, 4.0f},
-        {cloudTexture2, glm::vec3(25.0f, 14.0f, 30.0f), 0.3f, 5.0f},
-        {cloudTexture3, glm::vec3(0.0f, 11.0f, 60.0f), 0.4f, 3.5f},
-        {cloudTexture1, glm::vec3(10.0f, 13.0f, -10.0f), 0.4f, 4.2f},
-        {cloudTexture2, glm::vec3(-15.0f, 15.0f, -20.0f), 0.3f, 3.8f},
-        {cloudTexture3, glm::vec3(-50.0f, 13.0f, 10.0f), 0.2f, 4.5f},
-        {cloudTexture1, glm::vec3(40.0f, 16.0f, -35.0f), 0.3f, 3.9f},
-        {cloudTexture2, glm::vec3(-20.0f, 14.5f, -50.0f), 0.4f, 5.2f},
-        {cloudTexture3, glm::vec3(30.0f, 12.5f, 20.0f), 0.3f, 4.1f},
-        {cloudTexture1, glm::vec3(-10.0f, 15.0f, 0.0f), 0.5f, 4.8f},
-
-        {cloudTexture2, glm::vec3(5.0f, 13.5f, 15.0f), 0.3f, 3.7f},
-        {cloudTexture3, glm::vec3(-25.0f, 14.0f, -15.0f), 0.4f, 4.5f},
-        {cloudTexture1, glm::vec3(20.0f, 13.0f, 5.0f), 0.5f, 4.3f},
-        {cloudTexture3, glm::vec3(0.0f, 16.0f, -30.0f), 0.3f, 4.8f},
-        {cloudTexture2, glm::vec3(15.0f, 15.0f, 45.0f), 0.2f, 3.6f},
-
-        {cloudTexture2, glm::vec3(7.5f, 9.2f, 53.5f), 0.4f, 4.2f},
-        {cloudTexture3, glm::vec3(-12.0f, 6.0f, 57.0f), 0.3f, 3.9f},
-    };
+    GLuint cloudVBO;
+    GLuint cloudVAO = createTexturedVAO(skyQuad, sizeof(skyQuad), cloudVBO, "cloud quad");
+    EcsWorld scene;
+    for (int b = 0; b < sceneFile.billboardCount(); ++b) {
+        const SceneBillboard& cloud = sceneFile.billboards()[b];
+        glm::vec3 position(cloud.position[0], cloud.position[1], cloud.position[2]);
+        scene.create(ScenePosition{ position }, CloudBillboard{ sceneTextures[cloud.material], cloud.speed, cloud.scale },
+                     WorldMatrix());
+    }
 
-    // For frame time
-    float lastFrameTime = glfwGetTime();
-    int lastMouseLeftState = GLFW_RELEASE;
-    double lastMousePosX, lastMousePosY;
-    glfwGetCursorPos(window, &lastMousePosX, &lastMousePosY);
+    // Ground, then the player's car and the AI field on the lap
+    simWorld.terrain.generate(TERRAIN_SEED);
+    addVehicle(simWorld, currentState.carPos, glm::radians(currentState.carYaw));
+    setAiCarCount(simWorld, aiCars);
 
-    // Black background
-    glClearColor(135.0f/255.0f, 206.0f/255.0f, 235.0f/255.0f, 1.0f);
+    // Sky blue background
+    const glm::vec3 skyColor(135.0f/255.0f, 206.0f/255.0f, 235.0f/255.0f);
+    glClearColor(skyColor.x, skyColor.y, skyColor.z, 1.0f);
     
     // Compile and link shaders here ...
     int shaderProgram = compileAndLinkShaders(getVertexShaderSource(), getFragmentShaderSource());
     int texturedShaderProgram = compileAndLinkShaders(getTexturedVertexShaderSource(), getTexturedFragmentShaderSource());
+    int instancedShaderProgram = compileAndLinkShaders(getInstancedTexturedVertexShaderSource(), getTexturedFragmentShaderSource());
+    int hudShaderProgram = compileAndLinkShaders(getHudVertexShaderSource(), getHudFragmentShaderSource());
+    int terrainShaderProgram = compileAndLinkShaders(getTerrainVertexShaderSource(), getTerrainFragmentShaderSource());
     
 
     glUseProgram(shaderProgram); // Use our shader program
 
 
     // Define and upload geometry to the GPU here ...
-    GLuint cubeVAO = createVAO(cubeVertices, sizeof(cubeVertices));
-    GLuint floorVAO = createTexturedVAO(floorVertices,sizeof(floorVertices));
-    GLuint roadVAO = createTexturedVAO(roadVertices, sizeof(roadVertices));
-    GLuint curbVAO = createTexturedVAO(const_cast<float*>(curbVerts),sizeof(curbVerts));
+    GLuint cubeVBO;
+    GLuint cubeVAO = createVAO(cubeVertices, sizeof(cubeVertices), cubeVBO, "cube");
 
     GLuint carBodyVAO, carBodyVBO, carBodyEBO;
     createCubeVAO(carBodyVAO, carBodyVBO, carBodyEBO);
@@ -675,23 +1524,45 @@ int main(int argc, char*argv[])
 
     GLuint wheelVAO, wheelVBO, wheelEBO;
     createWheelVAO(wheelVAO, wheelVBO, wheelEBO);
+
+    // Every car (player and AI) is drawn with one instanced draw per part
+    GLuint carBodyInstanceVBO, cabinInstanceVBO, wheelInstanceVBO;
+    glGenBuffers(1, &carBodyInstanceVBO);
+    glGenBuffers(1, &cabinInstanceVBO);
+    glGenBuffers(1, &wheelInstanceVBO);
+    trackBuffer(carBodyInstanceVBO, 0, "car instances");
+    trackBuffer(cabinInstanceVBO, 0, "car instances");
+    trackBuffer(wheelInstanceVBO, 0, "car instances");
+    attachInstanceMatrices(carBodyVAO, carBodyInstanceVBO);
+    attachInstanceMatrices(cabinVAO, cabinInstanceVBO);
+    attachInstanceMatrices(wheelVAO, wheelInstanceVBO);
+    TransformHierarchy carTransforms;
+    CarRig carRig;
+    std::vector<Entity> carEntities;        // indexed by vehicle slot
+    std::vector<int> visibleBodyNodes, visibleCabinNodes, visibleWheelNodes;   // rig nodes to draw when some cars are culled
+
+
+    // Frame time report as the AI field changes size
+    bool writeProfile = false;
+    int frameNumber = 0;
+    double reportStart = glfwGetTime();
+    double reportSimSeconds = 0.0;
+    int reportFrames = 0;
+    GlFrameStats reportGl;                  // GL calls summed over the report's frames
    
 
-    // Camera variables
-    glm::vec3 cameraPos   = glm::vec3(0.0f, 1.5f,  5.0f);
-    glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, 1.0f);
-    glm::vec3 cameraUp    = glm::vec3(0.0f, 1.0f,  0.0f);
-    float cameraHorizontalAngle = 270.0f;
-    float cameraVerticalAngle = 0.0f;
-    bool  cameraFirstPerson = true; // press 1 or 2 to toggle this variable
-    float deltaTime = 0.0f; // Time between current frame and last frame
-    float lastFrame = 0.0f;
+    // Camera entity (the simulated position and angles live in SimState)
+    SceneCamera initialCamera = { currentState.cameraPos,
+                                  cameraFrontFromAngles(currentState.cameraHorizontalAngle, currentState.cameraVerticalAngle),
+                                  glm::vec3(0.0f, 1.0f, 0.0f),
+                                  true };
+    Entity cameraEntity = scene.create(initialCamera);
 
     // Set up projection matrix
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.f/600.f, 0.1f, 100.0f);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.f/600.f, 0.1f, VIEW_DISTANCE);
     
     // Set up view matrix
-    glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+    glm::mat4 view = cameraViewMatrix(initialCamera, simWorld.scenery);
 
     GLint modelLocation = glGetUniformLocation(shaderProgram, "world");
     GLint viewLocation  = glGetUniformLocation(shaderProgram, "view");
@@ -699,8 +1570,39 @@ int main(int argc, char*argv[])
     glUniformMatrix4fv(projLocation, 1, GL_FALSE, &projection[0][0]);
     glUniformMatrix4fv(viewLocation, 1, GL_FALSE, &view[0][0]);
     
-    // disable cursor
+    // disable cursor; raw (unaccelerated, unscaled) motion where the platform has it
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (glfwRawMouseMotionSupported()) glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+
+    // Input arrives as events during glfwPollEvents at the top of the frame. GLFW gives
+    // no OS timestamps, so each event is stamped when its callback runs.
+    InputQueue inputQueue;
+    InputLatency reportLatency;
+    double cursorStartX, cursorStartY;
+    glfwGetCursorPos(window, &cursorStartX, &cursorStartY);
+    inputQueue.setCursor(cursorStartX, cursorStartY);
+    glfwSetWindowUserPointer(window, &inputQueue);
+    glfwSetKeyCallback(window, [](GLFWwindow* w, int key, int, int action, int) {
+        InputEvent event{ INPUT_KEY };
+        event.code = key;
+        event.down = action != GLFW_RELEASE;
+        event.time = glfwGetTime();
+        static_cast<InputQueue*>(glfwGetWindowUserPointer(w))->push(event);
+    });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow* w, int button, int action, int) {
+        InputEvent event{ INPUT_MOUSE_BUTTON };
+        event.code = button;
+        event.down = action != GLFW_RELEASE;
+        event.time = glfwGetTime();
+        static_cast<InputQueue*>(glfwGetWindowUserPointer(w))->push(event);
+    });
+    glfwSetCursorPosCallback(window, [](GLFWwindow* w, double x, double y) {
+        InputEvent event{ INPUT_CURSOR };
+        event.x = x;
+        event.y = y;
+        event.time = glfwGetTime();
+        static_cast<InputQueue*>(glfwGetWindowUserPointer(w))->push(event);
+    });
 
     glEnable(GL_DEPTH_TEST); // Enable depth testing for 3D rendering
     // glEnable(GL_CULL_FACE); This takes off the ability to see the car through the windshield so disabled for now
@@ -708,458 +1610,780 @@ int main(int argc, char*argv[])
     // load models
     ModelData cybertruckData = loadModelWithAssimp("Models/SUV.obj");
     ModelData birdData = loadModelWithAssimp("Models/Bird.obj");
-    ModelData hillData = loadModelWithAssimp("Models/part.obj");
-    ModelData lightPoleData = loadModelWithAssimp("Models/Light Pole.obj");
-    // Load the grandstand model using the Assimp loader
-    ModelData grandstandData = loadModelWithAssimp("Models/generic medium.obj");
+    std::vector<ModelData> sceneryModels;
+    for (int mesh = 0; mesh < sceneFile.meshCount(); ++mesh)
+        sceneryModels.push_back(loadModelWithAssimp(sceneFile.meshes()[mesh].path));
+
+    // Static scenery never moves: build the collision BVH over its bounds once
+    const SceneInstance* scenery = sceneFile.instances();
+    int sceneryCount = sceneFile.instanceCount();
+    std::vector<Aabb> sceneryBounds;
+    for (int i = 0; i < sceneryCount; ++i)
+        sceneryBounds.push_back(transformAabb(scenery[i].modelMatrix(), sceneryModels[scenery[i].mesh].bounds));
+    simWorld.scenery.build(sceneryBounds);
+    std::vector<int> sceneryOrder = sceneryDrawOrder(sceneFile);
+
+    // Terrain; the grass repeats every metre out to the horizon, so it needs mipmaps
+    TerrainMesh terrainMesh = createTerrainMesh(simWorld.terrain, terrainShaderProgram, skyColor, VIEW_DISTANCE);
+    glBindTexture(GL_TEXTURE_2D, grassTextureID);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    resources().resizeGpu(GPU_TEXTURE, grassTextureID, resources().gpuBytes(GPU_TEXTURE, grassTextureID) * 4 / 3);
+
+    // Road, curbs and shoulders swept along the scene's track centreline (laid out above)
+    TrackStreamer trackStreamer;
+    trackStreamer.init(track);
+    trackStreamer.prefill(currentState.carPos, jobSystem());
+    const GLuint trackTextures[TRACK_SURFACE_COUNT] = { asphaltTextureID, curbTextureID, cobblestoneTextureID };
+
+    // Other per-frame results of the job graph
+    std::vector<uint8_t> sceneryVisible(sceneryCount, 1);
+    std::vector<TerrainDraw> terrainDraws;
+    int terrainTriangles = 0;
+    std::vector<uint8_t> trackVisible(track.chunks().size(), 1);
+    TrackDrawLists trackDrawLists;
+    int trackChunksDrawn = 0;
+    OcclusionCuller occlusion;
+    buildOccluders(occlusion, sceneFile, simWorld.terrain);
+    OcclusionReport reportOcclusion;
+
+    // Visible sets for cameras along the track, next to the scene (track.pvs): baked by
+    // --bake-pvs, otherwise loaded when the file was baked from this scene's cells, objects
+    // and occluders
+    std::vector<Aabb> pvsObjectBounds = pvsObjects(sceneryBounds, track, simWorld.terrain);
+    const int pvsTrackBase = sceneryCount;
+    const int pvsTerrainBase = pvsTrackBase + static_cast<int>(track.chunks().size());
+    std::string pvsPath = scenePath.substr(0, scenePath.find_last_of('.')) + ".pvs";
+    PotentiallyVisibleSet pvs;
+    {
+        PvsOccluders pvsOccluders;
+        addPvsOccluders(pvsOccluders, sceneFile, simWorld.terrain);
+        if (bakePvs) {
+            pvsOccluders.build();
+            pvs.bake(pvsCells(track), pvsObjectBounds, pvsOccluders);
+            const PvsBakeStats& bake = pvs.bakeStats();
+            std::cout << "Baked visible sets: " << pvs.cellCount() << " cells x " << pvs.objectCount() << " objects against "
+                      << pvsOccluders.count() << " occluders, " << bake.rays << " rays in " << bake.seconds << " s, "
+                      << bake.visiblePairs / std::max(1, pvs.cellCount()) << " objects visible per cell" << std::endl;
+            if (pvs.save(pvsPath)) std::cout << "Wrote " << pvsPath << std::endl;
+            glfwSetWindowShouldClose(window, true);
+        } else if (pvs.load(pvsPath, pvsCells(track), pvsObjectBounds, pvsOccluders)) {
+            std::cout << "Loaded visible sets for " << pvs.cellCount() << " cells from " << pvsPath << std::endl;
+        }
+    }
+    std::vector<EcsChunk*> carChunks, cloudChunks;
+    TransformHierarchy birdTransforms;
+    BirdRig birdRig = buildBirdRig(birdTransforms);
+
+    // GPU time per pass, read back a couple of frames late
+    GpuPassTimer gpuTimer;
+    gpuTimer.init();
+
+    // Performance HUD (H): one instanced draw of distance-field glyphs and bars
+    HudAtlas hudAtlas = buildHudAtlas();
+    GLuint hudAtlasTexture = createHudAtlasTexture(hudAtlas);
+    GLuint hudVAO, hudQuadVBO, hudInstanceVBO;
+    createHudVAO(hudVAO, hudQuadVBO, hudInstanceVBO);
+    GLint hudScreenSizeLocation = glGetUniformLocation(hudShaderProgram, "screenSize");
+    HudBatch hud(hudAtlas.width, hudAtlas.height);
+    HudTimings hudCpuTimings, hudGpuTimings;
+    std::vector<float> frameHistory(HUD_GRAPH_FRAMES, 0.0f);
+    int frameHistoryStart = 0;
+    double previousFrameStart = glfwGetTime();
+    uint64_t hudEventMark = profiler().eventMark();
+    bool showHud = false;
+    bool takePhoto = false;
+    int photoCount = 0;
+
+    // Dynamic resolution (R): the world is rendered into sceneTarget at a scale chosen from
+    // the measured GPU frame time and stretched onto the window. Off while exporting, so
+    // captures are always full resolution.
+    DynamicResolution dynamicResolution;
+    dynamicResolution.enabled = targetFps > 0 && !exporting;
+    dynamicResolution.targetMs = 1000.0 / std::max(1, targetFps);
+    RenderTarget sceneTarget;
+    uint64_t lastGpuReadback = 0;
+
+    // Export mode: fixed time per frame, frames read back through a PBO ring and encoded
+    // on their own threads
+    FrameEncoderPool frameEncoders;
+    FrameReadback frameReadback;
+    int exportedFrames = 0;
+    double exportStart = 0.0;
+    if (exporting) {
+        if (!frameEncoders.open(exportPath, exportFps, encoderThreads)) {
+            glfwTerminate();
+            return -1;
+        }
+        frameReadback.init();
+        exportStart = glfwGetTime();
+        std::cout << "Exporting " << exportFrames << " frames at " << exportFps << " fps to " << exportPath
+                  << " with " << encoderThreads << " encoder threads" << std::endl;
+    }
+
+    // CPU side of the memory report: each subsystem's current footprint, polled when printed
+    resources().trackCpu("vertex arrays in headers", [] {
+        return sizeof(cubeVertices) + sizeof(skyQuad);
+    });
+    resources().trackCpu("scene file", [&] { return sceneFile.fileBytes(); });
+    resources().trackCpu("simulation", [&] { return simWorld.memoryBytes(); });
+    resources().trackCpu("scenery BVH", [&] { return simWorld.scenery.memoryBytes(); });
+    resources().trackCpu("terrain", [&] { return simWorld.terrain.memoryBytes() + vectorBytes(terrainDraws); });
+    resources().trackCpu("track", [&] {
+        return track.memoryBytes() + trackStreamer.memoryBytes() + vectorBytes(trackPoints) + vectorBytes(trackVisible) +
+               vectorBytes(trackDrawLists.baseVertices) + vectorBytes(trackDrawLists.counts) + vectorBytes(trackDrawLists.offsets);
+    });
+    resources().trackCpu("occlusion", [&] { return occlusion.memoryBytes() + pvs.memoryBytes() + vectorBytes(pvsObjectBounds); });
+    resources().trackCpu("entities", [&] { return scene.memoryBytes(); });
+    resources().trackCpu("transforms", [&] { return carTransforms.memoryBytes() + birdTransforms.memoryBytes(); });
+    resources().trackCpu("job system", [] { return jobSystem().memoryBytes(); });
+    resources().trackCpu("profiler", [] { return profiler().memoryBytes(); });
+    resources().trackCpu("hud", [&] {
+        return vectorBytes(hudAtlas.texels) + vectorBytes(hud.quads()) + vectorBytes(frameHistory);
+    });
+    resources().printReport("startup");
 
     // Main loop
     while (!glfwWindowShouldClose(window))
     {
-        // Frame time calculation
-        float deltaTime = glfwGetTime() - lastFrameTime;
-        lastFrameTime = glfwGetTime();
-
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear the screen
-
-        // Get the location of the color uniform
-        int colorLocation = glGetUniformLocation(shaderProgram, "vertexColor");
-
-        // --- CLOUDS DRAWING (before other objects) ---
-        glUseProgram(texturedShaderProgram);
-        GLuint textureSamplerLocation = glGetUniformLocation(texturedShaderProgram, "textureSampler");
-        GLint uvScaleLocation = glGetUniformLocation(texturedShaderProgram, "uvScale");
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        GLint useBlackKeyLoc = glGetUniformLocation(texturedShaderProgram, "useBlackKey");
-        glUniform1i(useBlackKeyLoc, GL_FALSE);
-
-        for (auto& cloud : clouds) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, cloud.textureID);
-            glUniform1i(textureSamplerLocation, 0);
-            glUniform1f(uvScaleLocation, 1.0f);
-            // Y-axis-constrained billboarding: make the cloud face the camera
-            glm::vec3 cloudToCamera = glm::normalize(cameraPos - cloud.position);
-            glm::mat4 billboardRotation = glm::inverse(glm::lookAt(glm::vec3(0), cloudToCamera, glm::vec3(0, 1, 0)));
-            billboardRotation[3] = glm::vec4(0, 0, 0, 1); // clear translation
-            glm::mat4 model = glm::translate(glm::mat4(1.0f), cloud.position) *
-                              billboardRotation *
-                              glm::scale(glm::mat4(1.0f), glm::vec3(cloud.scale));
-            setWorldMatrix(texturedShaderProgram, model);
-            setProjectionMatrix(texturedShaderProgram, projection);
-            setViewMatrix(texturedShaderProgram, view);
-            glBindVertexArray(cloudVAO);
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        // Profiler trace: P writes whatever the rings hold, --profile-frames N writes once and quits.
+        // Done between frames, while no job is recording.
+        if (profileFrames > 0 && frameNumber == profileFrames) {
+            writeProfile = true;
+            glfwSetWindowShouldClose(window, true);
         }
+        if (writeProfile) {
+            int events = profiler().writeChromeTrace("profile.json");
+            if (events >= 0) std::cout << "Wrote " << events << " profiler events to profile.json" << std::endl;
+            writeProfile = false;
+            if (glfwWindowShouldClose(window)) break;
+        }
+        {
+            PROFILE_ZONE("pacing");
+            framePacer.wait();
+        }
+        ++frameNumber;
+        PROFILE_ZONE("frame");
 
-        glUniform1i(useBlackKeyLoc, GL_FALSE);
-        glDisable(GL_BLEND);
-
-        // --- END CLOUDS ---
-
-        glUseProgram(texturedShaderProgram);
-        // textureSamplerLocation and uvScaleLocation already obtained above
-        glActiveTexture(GL_TEXTURE0); // Activate texture unit 0
-        glBindTexture(GL_TEXTURE_2D, grassTextureID); // Bind the grass texture
-        glUniform1i(textureSamplerLocation, 0); // Set the texture sampler to use texture unit 0
-        glUniform1f(uvScaleLocation, 1.0f); // floor UV scale
-       
-        // Draw the floor
-        glm::mat4 floorModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.01f, 0.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(10.0f, 0.02f, 10.0f));
-        setWorldMatrix(texturedShaderProgram, floorModel);
-        setProjectionMatrix(texturedShaderProgram, projection);
-        setViewMatrix(texturedShaderProgram, view);
-
-        glBindVertexArray(floorVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        
-        // Draw the hills with rock texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mountainTextureID);
-        glUniform1i(textureSamplerLocation, 0);
-        for (int i = 0; i < 24; ++i) {
-            glm::vec3 hillPosition;
-            float hillScale = 0.5f;
-            if (i == 0) {
-                hillPosition = glm::vec3(-15.0f, 0.0f, -7.0f);
-                hillScale = 0.5f;
-            } else if (i == 1) {
-                hillPosition = glm::vec3(-15.0f, 0.0f, -3.0f);
-                hillScale = 0.5f;
-            } else if (i == 2) {
-                hillPosition = glm::vec3(-15.0f, 0.0f, 1.0f);
-                hillScale = 0.5f;
-            } else if (i == 3) {
-                hillPosition = glm::vec3(-15.0f, 0.0f, 10.0f);
-                hillScale = 0.5f;
-            } else if (i == 4) {
-                hillPosition = glm::vec3(-15.0f, 0.0f, 14.0f);
-                hillScale = 0.5f;
-            } else if (i == 5) {
-                hillPosition = glm::vec3(-15.0f, 0.0f, 18.0f);
-                hillScale = 0.5f;
-            } else if (i == 6) {
-                hillPosition = glm::vec3(-15.0f, 0.0f, 22.0f);
-                hillScale = 0.5f;
-            } else if (i == 7) {
-                hillPosition = glm::vec3(-15.0f, 0.0f, 26.0f);
-                hillScale = 0.5f;
-            } else if (i == 8) {
-                hillPosition = glm::vec3(15.0f, 0.0f, -7.0f);
-                hillScale = 0.5f;
-            } else if (i == 9) {
-                hillPosition = glm::vec3(15.0f, 0.0f, -3.0f);
-                hillScale = 0.5f;
-            } else if (i == 10) {
-                hillPosition = glm::vec3(15.0f, 0.0f, 1.0f);
-                hillScale = 0.5f;
-            } else if (i == 11) {
-                hillPosition = glm::vec3(15.0f, 0.0f, 10.0f);
-                hillScale = 0.5f;
-            } else if (i == 12) {
-                hillPosition = glm::vec3(15.0f, 0.0f, 14.0f);
-                hillScale = 0.5f;
-            } else if (i == 13) {
-                hillPosition = glm::vec3(15.0f, 0.0f, 18.0f);
-                hillScale = 0.5f;
-            } else if (i == 14) {
-                hillPosition = glm::vec3(15.0f, 0.0f, 22.0f);
-                hillScale = 0.5f;
-            } else if (i == 15) {
-                hillPosition = glm::vec3(15.0f, 0.0f, 26.0f);
-                hillScale = 0.5f;
-            } else if (i == 16) {
-                hillPosition = glm::vec3(-15.0f, 0.0f, 30.0f);
-                hillScale = 0.5f;
-            } else if (i == 17) {
-                hillPosition = glm::vec3(-15.0f, 0.0f, 34.0f);
-                hillScale = 0.5f;
-            } else if (i == 18) {
-                hillPosition = glm::vec3(-15.0f, 0.0f, 38.0f);
-                hillScale = 0.5f;
-            } else if (i == 19) {
-                hillPosition = glm::vec3(-15.0f, 0.0f, 42.0f);
-                hillScale = 0.5f;
-            } else if (i == 20) {
-                hillPosition = glm::vec3(15.0f, 0.0f, 30.0f);
-                hillScale = 0.5f;
-            } else if (i == 21) {
-                hillPosition = glm::vec3(15.0f, 0.0f, 34.0f);
-                hillScale = 0.5f;
-            } else if (i == 22) {
-                hillPosition = glm::vec3(15.0f, 0.0f, 38.0f);
-                hillScale = 0.5f;
-            } else if (i == 23) {
-                hillPosition = glm::vec3(15.0f, 0.0f, 42.0f);
-                hillScale = 0.5f;
+        // Poll first, so everything that arrived up to now reaches this frame's simulation and view
+        {
+            PROFILE_ZONE("input");
+            glfwPollEvents();
+            inputQueue.beginFrame();
+            if (inputQueue.down(GLFW_KEY_ESCAPE))
+                glfwSetWindowShouldClose(window, true);
+
+            // Mouse motion accumulates until a simulation step consumes it
+            simInput.mouseDx += static_cast<float>(inputQueue.mouseDx());
+            simInput.mouseDy += static_cast<float>(inputQueue.mouseDy());
+            simInput.cameraFast    = inputQueue.down(GLFW_KEY_LEFT_SHIFT);
+            simInput.cameraForward = inputQueue.down(GLFW_KEY_W);
+            simInput.cameraBack    = inputQueue.down(GLFW_KEY_S);
+            simInput.cameraLeft    = inputQueue.down(GLFW_KEY_A);
+            simInput.cameraRight   = inputQueue.down(GLFW_KEY_D);
+            simInput.carForward    = inputQueue.down(GLFW_KEY_I);
+            simInput.carBackward   = inputQueue.down(GLFW_KEY_K);
+            simInput.steerLeft     = inputQueue.down(GLFW_KEY_J);
+            simInput.steerRight    = inputQueue.down(GLFW_KEY_L);
+            if (exporting) simInput = SimInput();   // exports replay the same race: no live input reaches the simulation
+
+            // 1st person and 3rd person camera toggle
+            if (inputQueue.down(GLFW_KEY_1)) scene.get<SceneCamera>(cameraEntity).firstPerson = true;
+            if (inputQueue.down(GLFW_KEY_2)) scene.get<SceneCamera>(cameraEntity).firstPerson = false;
+
+            // = doubles the AI field, - halves it
+            if (inputQueue.pressed(GLFW_KEY_EQUAL) || inputQueue.pressed(GLFW_KEY_MINUS)) {
+                int count = aiCarCount(simWorld);
+                count = inputQueue.pressed(GLFW_KEY_EQUAL) ? std::min(16384, std::max(1, count * 2)) : count / 2;
+                setAiCarCount(simWorld, count);
+                std::cout << "AI cars: " << count << std::endl;
             }
 
-            // Keep texture density roughly constant w.r.t. mesh scaling
-            glUniform1f(uvScaleLocation, 10.0f / hillScale);
+            // H shows or hides the performance HUD
+            if (inputQueue.pressed(GLFW_KEY_H)) showHud = !showHud;
 
-            glm::mat4 hillModel = glm::translate(glm::mat4(1.0f), hillPosition) *
-                                  glm::scale(glm::mat4(1.0f), glm::vec3(hillScale));
+            // E switches elision of redundant GL calls on and off
+            if (inputQueue.pressed(GLFW_KEY_E)) {
+                glsSetElision(!glsShadow().elide);
+                std::cout << "Redundant GL calls " << (glsElision() ? "elided" : "issued") << std::endl;
+            }
 
-            setWorldMatrix(texturedShaderProgram, hillModel);
-            setProjectionMatrix(texturedShaderProgram, projection);
-            setViewMatrix(texturedShaderProgram, view);
-            glBindVertexArray(hillData.VAO); // or whatever your VAO is
-            glDrawElements(GL_TRIANGLES, hillData.indexCount, GL_UNSIGNED_INT, 0);
-        }
+            // O switches occlusion culling on and off
+            if (inputQueue.pressed(GLFW_KEY_O)) {
+                occlusion.setEnabled(!occlusion.isEnabled());
+                std::cout << "Occlusion culling " << (occlusion.isEnabled() ? "on" : "off") << std::endl;
+            }
 
-        // Draw the road
-        
-        glm::mat4 roadModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.001f, -50.0f)) *
-                            glm::scale(glm::mat4(1.0f), glm::vec3(3.0f, 0.01f, 100.0f));
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, asphaltTextureID);
-        glUniform1i(textureSamplerLocation, 0);
-        glUniform1f(uvScaleLocation, 1.0f); // road UV scale
-
-        setWorldMatrix(texturedShaderProgram, roadModel);
-        setProjectionMatrix(texturedShaderProgram, projection);
-        setViewMatrix(texturedShaderProgram, view);
-        glBindVertexArray(roadVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        // Draw the light poles along the track
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, lightPoleTextureID);
-        glUniform1i(textureSamplerLocation, 0);
-        glUniform1f(uvScaleLocation, 1.0f);
-
-        for (int i = 0; i < 16; ++i) {
-            glm::vec3 polePosition;
-            float poleScale = 0.3f;
-
-            if (i < 8) {
-                // left side
-                polePosition = glm::vec3(-8.0f, 3.0f, -7.0f + i * 6.0f);
-            } else {
-                // right side
-                polePosition = glm::vec3(8.0f, 3.0f, -7.0f + (i - 8) * 6.0f);
+            // R switches dynamic resolution on and off
+            if (inputQueue.pressed(GLFW_KEY_R) && targetFps > 0 && !exporting) {
+                dynamicResolution.enabled = !dynamicResolution.enabled;
+                dynamicResolution.reset();
+                if (!dynamicResolution.enabled) sceneTarget.destroy();
+                std::cout << "Dynamic resolution " << (dynamicResolution.enabled ? "on" : "off") << std::endl;
             }
 
-            glm::mat4 poleModel = glm::translate(glm::mat4(1.0f), polePosition) *
-                                  glm::scale(glm::mat4(1.0f), glm::vec3(poleScale));
-            setWorldMatrix(texturedShaderProgram, poleModel);
-            setProjectionMatrix(texturedShaderProgram, projection);
-            setViewMatrix(texturedShaderProgram, view);
-            glBindVertexArray(lightPoleData.VAO);
-            glDrawElements(GL_TRIANGLES, lightPoleData.indexCount, GL_UNSIGNED_INT, 0);
-        }
+            // F12 takes a photo this frame
+            if (inputQueue.pressed(GLFW_KEY_F12)) takePhoto = true;
 
+            // V cycles the frame pacing mode
+            if (inputQueue.pressed(GLFW_KEY_V) && !exporting) {
+                PacingMode next = static_cast<PacingMode>((framePacer.pacingMode() + 1) % PACING_MODE_COUNT);
+                framePacer.configure(next, fpsCap, refreshHz);
+                glfwSwapInterval(framePacer.swapInterval(swapTearSupported));
+                std::cout << "Frame pacing: " << PACING_MODE_NAMES[next] << std::endl;
+            }
 
-        // Draw the grandstands after rendering the light poles, rotating textures for variety
-        std::vector<glm::vec3> grandstandPositions;
-        for (float z = -45.0f; z <= 45.0f; z += 10.0f) {
-            grandstandPositions.push_back(glm::vec3(-6.0f, 0.0f, z)); // Left side
-            grandstandPositions.push_back(glm::vec3( 6.0f, 0.0f, z)); // Right side
+            // P writes a profiler trace at the start of the next frame
+            if (inputQueue.pressed(GLFW_KEY_P)) writeProfile = true;
         }
 
-        std::vector<GLuint> grandstandTextures = {
-            grandstandTextureID,
-            grandstandTextureB,
-            grandstandTextureC,
-            grandstandTextureID
-        };
-
-        for (size_t i = 0; i < grandstandPositions.size(); ++i) {
-            glBindTexture(GL_TEXTURE_2D, grandstandTextures[i % grandstandTextures.size()]);
-            glUniform1i(textureSamplerLocation, 0);
-            glUniform1f(uvScaleLocation, 1.0f);
-
-            // Corrected rotation: x > 0.0f gets 270, else 90
-            float angle = (grandstandPositions[i].x > 0.0f) ? 270.0f : 90.0f;
-            glm::mat4 grandstandModel = glm::translate(glm::mat4(1.0f), grandstandPositions[i]) *
-                                        glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f)) *
-                                        glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));  // Increased scale for visibility
-            setWorldMatrix(texturedShaderProgram, grandstandModel);
-            setProjectionMatrix(texturedShaderProgram, projection);
-            setViewMatrix(texturedShaderProgram, view);
-            glBindVertexArray(grandstandData.VAO);
-            glDrawElements(GL_TRIANGLES, grandstandData.indexCount, GL_UNSIGNED_INT, 0);
+        // Read the clock once per frame and run as many fixed steps as it owes us
+        double frameStart = glfwGetTime();
+
+        // Last frame's duration for the graph, and its main-thread phases and GPU passes for the HUD
+        frameHistory[frameHistoryStart] = static_cast<float>((frameStart - previousFrameStart) * 1000.0);
+        frameHistoryStart = (frameHistoryStart + 1) % HUD_GRAPH_FRAMES;
+        previousFrameStart = frameStart;
+        if (showHud) {
+            double ticksPerMillisecond = profiler().ticksPerMicrosecond() * 1000.0;
+            profiler().forEachEventSince(hudEventMark, [&](const ProfileEvent& event) {
+                for (const char* phase : HUD_CPU_PHASES)
+                    if (strcmp(event.name, phase) == 0) hudCpuTimings.add(phase, static_cast<float>((event.end - event.start) / ticksPerMillisecond));
+            });
+            hudCpuTimings.endFrame();
+            for (const GpuPassStats& pass : gpuTimer.latest()) hudGpuTimings.add(pass.name, static_cast<float>(pass.ms));
+            hudGpuTimings.endFrame();
         }
-
-        // Draw textured curbs
-        setProjectionMatrix(texturedShaderProgram, projection);
-        setViewMatrix(texturedShaderProgram, view);
-        glBindVertexArray(curbVAO);
-        glBindTexture(GL_TEXTURE_2D, curbTextureID);   // red-white texture
-        glUniform1i(glGetUniformLocation(texturedShaderProgram,"textureSampler"),0);
-        glUniform1f(uvScaleLocation, 1.0f); // curb UV scale
-
-        const float curbW = 0.30f;
-        const float halfRoad = 1.5f;
-        const float halfCurb = curbW * 0.5f;
-        float offset = halfRoad + halfCurb;
-
-        // left side
-        glm::mat4 curbL = glm::translate(glm::mat4(1.0f),
-                        glm::vec3(-offset, 0.003f, 0.0f)) *
-                        glm::scale(glm::mat4(1.0f),
-                        glm::vec3(curbW, 0.01f, 100.0f));
-        setWorldMatrix(texturedShaderProgram, curbL);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        // right side  (same texture, mirrored)
-        glm::mat4 curbR = glm::translate(glm::mat4(1.0f),
-                        glm::vec3( offset, 0.003f, 0.0f)) *
-                        glm::scale(glm::mat4(1.0f),
-                        glm::vec3(curbW, 0.01f, 100.0f));
-        setWorldMatrix(texturedShaderProgram, curbR);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUseProgram(texturedShaderProgram);
-
-        // Car Body
-        glm::mat4 bodyModel = glm::translate(glm::mat4(1.0f), carPos + glm::vec3(0, 0.25f, 0));
-        bodyModel = glm::rotate(bodyModel, glm::radians(180.0f), glm::vec3(0, 1, 0));
-        bodyModel = glm::scale(bodyModel, glm::vec3(1.35f, 0.38f, 2.7f));
-        setWorldMatrix(texturedShaderProgram, bodyModel);
-        glBindTexture(GL_TEXTURE_2D, carTexture);
-        glBindVertexArray(carBodyVAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        // Cabin
-        glm::mat4 cabinModel = glm::translate(glm::mat4(1.0f), carPos + glm::vec3(0, 0.55f, 0));
-        cabinModel = glm::rotate(cabinModel, glm::radians(180.0f), glm::vec3(0, 1, 0));
-        cabinModel = glm::scale(cabinModel, glm::vec3(0.75f, 0.4f, 2.0f));
-        setWorldMatrix(texturedShaderProgram, cabinModel);
-        glBindVertexArray(cabinVAO);
-        glDrawElements(GL_TRIANGLES, 30, GL_UNSIGNED_INT, 0);
-
-        // Wheels
-        float wheelX = 0.75f, wheelZ = 1.10f;
-        for (int i = -1; i <= 1; i += 2) {
-            for (int j = -1; j <= 1; j += 2) {
-                glm::vec3 offset(i * wheelX, WHEEL_SCALE * 0.5f, j * wheelZ);
-                glm::mat4 wheelModel = glm::translate(glm::mat4(1.0f), carPos + offset);
-                wheelModel = glm::rotate(wheelModel, glm::radians(90.0f), glm::vec3(0, 1, 0));
-                if (j == 1) wheelModel = glm::rotate(wheelModel, glm::radians(steerAngle), glm::vec3(0, 1, 0));
-                wheelModel = glm::rotate(wheelModel, glm::radians(wheelAngle), glm::vec3(0, 0, 1));
-                wheelModel = glm::scale(wheelModel, glm::vec3(WHEEL_SCALE));
-                setWorldMatrix(texturedShaderProgram, wheelModel);
-                glBindTexture(GL_TEXTURE_2D, tireTexture);
-                glBindVertexArray(wheelVAO);
-                glDrawElements(GL_TRIANGLES, wheelIndexCount, GL_UNSIGNED_INT, 0);
+        hudEventMark = profiler().eventMark();
+        glsBeginFrame();
+        reportGl += glsPreviousFrameStats();
+        int simSteps = exporting ? simClock.beginFixedFrame(exportedFrames, 1.0 / exportFps) : simClock.beginFrame(frameStart);
+        {
+            PROFILE_ZONE("simulation");
+            for (int step = 0; step < simSteps; ++step) {
+                previousState = currentState;
+                stepSimulation(currentState, simInput, simWorld, simClock.stepDelta());
             }
         }
-        
-        // Draw the Cybertruck (centered and scaled)
-        glUseProgram(shaderProgram);
-        setProjectionMatrix(shaderProgram, projection);
-        setViewMatrix(shaderProgram, view);
-        setWorldMatrix(shaderProgram, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.1f, 9.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f, 0.5f, 0.5f)));
-        glBindVertexArray(cybertruckData.VAO);
-        //glDrawElements(GL_TRIANGLES, cybertruckData.indexCount, GL_UNSIGNED_INT, 0); // Draw the Cybertruck model
-            
-        glBindVertexArray(0); // Unbind VAO
-
-        // Draw the Bird model
-        float angle = glm::radians(glfwGetTime() * 60.0f); // Rotate the bird model
-        glm::mat4 birdModelMatrix = glm::mat4(1.0f);
-        birdModelMatrix = glm::translate(birdModelMatrix, glm::vec3(0.0f, 2.0f, 2.0f));
-        birdModelMatrix = glm::rotate(birdModelMatrix, angle, glm::vec3(0.0f, 1.0f, 0.0f));
-        birdModelMatrix = glm::translate(birdModelMatrix, glm::vec3(2.0f, 0.0f, 0.0f)); // Position the bird above the ground
-        birdModelMatrix = glm::rotate(birdModelMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        birdModelMatrix = glm::rotate(birdModelMatrix, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)); // Rotate the bird model to face upwards
-        birdModelMatrix = glm::scale(birdModelMatrix, glm::vec3(0.001f));
-
-        setWorldMatrix(shaderProgram, birdModelMatrix);
-        glBindVertexArray(birdData.VAO);
-        glDrawElements(GL_TRIANGLES, birdData.indexCount, GL_UNSIGNED_INT, 0); // Draw the Bird model
-
-        float subAngle = glm::radians(glfwGetTime() * 60.0f); // Rotate the bird model around its own axis
-        float radius = 300.0f; // Orbit radius for the second bird
-        float yOffset = radius * sin(subAngle); // Calculate the y offset based on the angle
-        float zOffset = radius * cos(subAngle); // Calculate the z offset based on the angle
-        glm::mat4 bird2Matrix = glm::mat4(1.0f);
-        // Translate to position the bird in orbit (around the first bird at origin)
-        bird2Matrix = glm::translate(bird2Matrix, glm::vec3(0.0f, yOffset, zOffset));
-        bird2Matrix = glm::scale(bird2Matrix, glm::vec3(1.0f)); 
-
-        glm::mat4 secondBird = birdModelMatrix * bird2Matrix; // Combine transformations
-
-        setWorldMatrix(shaderProgram, secondBird);
-        glBindVertexArray(birdData.VAO);
-        glDrawElements(GL_TRIANGLES, birdData.indexCount, GL_UNSIGNED_INT, 0); // Draw the second Bird model
-        
-
-        if(cameraFirstPerson){
-            view = lookAt(cameraPos,  // eye
-                                 cameraPos + cameraFront,  // center
-                                 cameraUp ); // up
-        } else{
-            float radius = 5.0f;
-            glm::vec3 position = cameraPos - radius * cameraFront; // position is on a sphere around the camera position
-            view = lookAt(position,  // eye
-                                 position + cameraFront,  // center
-                                 cameraUp ); // up
-        }
+        reportSimSeconds += glfwGetTime() - frameStart;
+
+        // Render the interpolated state
+        ProfileZone updateZone("update");
+        SimState renderState = interpolateSimState(previousState, currentState, simClock.alpha());
+        SceneCamera& camera = scene.get<SceneCamera>(cameraEntity);
+        camera.position = renderState.cameraPos;
+        // Mouse look is not interpolated: the view turns by the latest state plus any motion
+        // no step has consumed yet, so it reflects this frame's mouse input
+        float lookHorizontal = currentState.cameraHorizontalAngle - simInput.mouseDx * CAMERA_MOUSE_SENSITIVITY;
+        float lookVertical = std::max(-85.0f, std::min(85.0f, currentState.cameraVerticalAngle - simInput.mouseDy * CAMERA_MOUSE_SENSITIVITY));
+        camera.front = cameraFrontFromAngles(lookHorizontal, lookVertical);
+        view = cameraViewMatrix(camera, simWorld.scenery);
+
+        // ---------- Per-frame CPU work as a job graph ----------
+        // Every job is a child of frameJob; this thread helps run them and then does
+        // all GL submission itself.
+        Frustum frustum(projection * view);
+        float renderAlpha = simClock.alpha();
+        float renderTime = static_cast<float>(renderState.time);
+        int carCount = simWorld.vehicles.count;
+        if (carRig.count != carCount) carRig = buildCarRig(carTransforms, carCount);
+        syncCarEntities(scene, carEntities, carCount);
+        VehicleRenderPose playerPose = { renderState.carPos, renderState.carYaw, renderState.carPitch, renderState.carRoll,
+                                         renderState.wheelAngle, renderState.steerAngle };
+        glm::vec3 cameraPos = camera.position;
+        glm::vec3 eyePos = glm::vec3(glm::inverse(view)[3]);     // behind the car in third person
+
+        JobSystem& jobs = jobSystem();
+        Job* frameJob = jobs.create(std::function<void()>());
+
+        // Track chunks near the car are paged in (decoded by this frame's jobs)
+        trackStreamer.update(renderState.carPos, jobs, frameJob);
+
+        // Occluders first: the culling jobs test against the depth buffer, so this job
+        // starts them once it is built. A camera in a cell of the visible sets skips the
+        // buffer: static objects are culled by their bit, cars by the frustum alone.
+        int pvsCell = occlusion.isEnabled() && !pvs.empty() ? pvs.cellAt(eyePos) : -1;
+        auto hidden = [&](int pvsObject, const Aabb& bounds) {
+            return pvsCell >= 0 ? !pvs.visible(pvsCell, pvsObject) : !occlusion.visible(bounds);
+        };
+        int sceneryOccluded = 0, trackOccluded = 0, terrainOccluded = 0;
+        std::atomic<int> carsOccluded{ 0 };
+        scene.query<SimVehicle, VehicleRenderPose, Visibility>(carChunks);
+        jobs.run(jobs.create([&] {
+            if (pvsCell < 0) {
+                PROFILE_ZONE("occlusion");
+                occlusion.render(projection * view, frustum, eyePos);
+            }
 
-        glUniformMatrix4fv(viewLocation, 1, GL_FALSE, &view[0][0]);
+            // Cars, one job per ECS chunk: render pose, culling, then the pose into the rig
+            for (EcsChunk* chunk : carChunks) {
+                jobs.run(jobs.create([&, chunk] {
+                    PROFILE_ZONE("cars chunk");
+                    carPoseSystem(*chunk, simWorld, playerPose, renderAlpha);
+                    carsOccluded += carCullingSystem(*chunk, frustum, pvsCell < 0 ? &occlusion : nullptr);
+                    carRigSystem(*chunk, carTransforms, carRig);
+                }, frameJob));
+            }
 
-        
-        
-        glfwSwapBuffers(window); // Swap buffers
-        glfwPollEvents(); // Poll for events
+            // Static scenery culling
+            jobs.run(jobs.create([&] {
+                PROFILE_ZONE("scenery culling");
+                for (int i = 0; i < sceneryCount; ++i) {
+                    bool inFrustum = frustum.intersects(sceneryBounds[i]);
+                    sceneryVisible[i] = inFrustum && !hidden(i, sceneryBounds[i]);
+                    sceneryOccluded += inFrustum && !sceneryVisible[i];
+                }
+            }, frameJob));
+
+            // Track chunks
+            jobs.run(jobs.create([&] {
+                PROFILE_ZONE("track culling");
+                const std::vector<TrackChunk>& chunks = track.chunks();
+                for (size_t i = 0; i < chunks.size(); ++i) {
+                    bool inFrustum = frustum.intersects(chunks[i].bounds);
+                    trackVisible[i] = inFrustum && !hidden(pvsTrackBase + static_cast<int>(i), chunks[i].bounds);
+                    trackOccluded += inFrustum && !trackVisible[i];
+                }
+            }, frameJob));
+
+            // Terrain chunks: culling and level of detail
+            jobs.run(jobs.create([&] {
+                PROFILE_ZONE("terrain lod");
+                simWorld.terrain.select(eyePos, frustum, terrainDraws);
+                const std::vector<TerrainChunk>& chunks = simWorld.terrain.chunks();
+                size_t kept = 0;
+                terrainTriangles = 0;
+                for (const TerrainDraw& draw : terrainDraws) {
+                    if (hidden(pvsTerrainBase + draw.chunk, chunks[draw.chunk].bounds)) continue;
+                    terrainDraws[kept++] = draw;
+                    terrainTriangles += Terrain::lodTriangles(draw.lod);
+                }
+                terrainOccluded = static_cast<int>(terrainDraws.size() - kept);
+                terrainDraws.resize(kept);
+            }, frameJob));
+        }, frameJob));
+
+        // Cloud billboards
+        scene.query<ScenePosition, CloudBillboard, WorldMatrix>(cloudChunks);
+        for (EcsChunk* chunk : cloudChunks)
+            jobs.run(jobs.create([&, chunk] {
+                PROFILE_ZONE("cloud billboards");
+                cloudBillboardSystem(*chunk, cameraPos);
+            }, frameJob));
+
+        // Bird animation
+        jobs.run(jobs.create([&] {
+            PROFILE_ZONE("bird animation");
+            poseBirdRig(birdTransforms, birdRig, renderTime);
+            birdTransforms.update();
+        }, frameJob));
+
+        jobs.run(frameJob);
+        jobs.wait(frameJob);
+        trackStreamer.commit();
+        if (pvsCell < 0) {
+            reportOcclusion.occluders += occlusion.stats().occluders;
+            reportOcclusion.quads += occlusion.stats().quads;
+        } else {
+            reportOcclusion.pvsFrames++;
+        }
+        reportOcclusion.scenery += sceneryOccluded;
+        reportOcclusion.trackChunks += trackOccluded;
+        reportOcclusion.terrainChunks += terrainOccluded;
+        reportOcclusion.cars += carsOccluded;
+
+        // Car world matrices, one level of the rig at a time (a level never contains its own parents)
+        carTransforms.beginUpdate();
+        const int carLevels[] = { carRig.roots, carRig.bodyFrames, carRig.bodies, carTransforms.size() };
+        for (int level = 0; level + 1 < 4; ++level) {
+            int levelBegin = carLevels[level];
+            jobs.parallelFor(carLevels[level + 1] - levelBegin, CAR_INSTANCE_GRAIN, [&](int begin, int end) {
+                PROFILE_ZONE("car rig level");
+                carTransforms.updateRange(levelBegin + begin, levelBegin + end);
+            });
+        }
 
-        // Handle inputs
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-            glfwSetWindowShouldClose(window, true);
-        
-        // Camera controls
+        // List the visible cars' rig nodes; with every car in view the rig's blocks are drawn as they are instead
+        const int* carBodyNodes = NULL;
+        const int* cabinNodes = NULL;
+        const int* wheelNodes = NULL;
+        int carBodyFirst = carRig.bodies, cabinFirst = carRig.cabins, wheelFirst = carRig.wheels;
+        visibleBodyNodes.clear();
+        visibleCabinNodes.clear();
+        visibleWheelNodes.clear();
+        for (EcsChunk* chunk : carChunks) {
+            EcsWorld::eachInChunk<SimVehicle, Visibility>(*chunk, [&](Entity, SimVehicle& vehicle, Visibility& visibility) {
+                if (!visibility.visible) return;
+                int car = vehicle.slot;
+                visibleBodyNodes.push_back(carRig.bodies + car);
+                visibleCabinNodes.push_back(carRig.cabins + car);
+                for (int w = 0; w < VEHICLE_WHEELS; ++w) visibleWheelNodes.push_back(carRig.wheels + car * VEHICLE_WHEELS + w);
+            });
+        }
+        int visibleCars = carCount;
+        if (static_cast<int>(visibleBodyNodes.size()) != carCount) {
+            carBodyNodes = visibleBodyNodes.data();
+            cabinNodes = visibleCabinNodes.data();
+            wheelNodes = visibleWheelNodes.data();
+            carBodyFirst = cabinFirst = wheelFirst = 0;
+            visibleCars = static_cast<int>(visibleBodyNodes.size());
+        }
+        updateZone.end();
+
+        // Cars: the transform kernel writes the kept instances' matrices straight into the mapped buffers
+        ProfileZone carMatricesZone("car");
+        float* carBodyMatrices = mapInstanceMatrices(carBodyInstanceVBO, visibleCars);
+        float* cabinMatrices = mapInstanceMatrices(cabinInstanceVBO, visibleCars);
+        float* wheelMatrices = mapInstanceMatrices(wheelInstanceVBO, visibleCars * VEHICLE_WHEELS);
+        if (carBodyMatrices && cabinMatrices && wheelMatrices) {
+            jobs.parallelFor(visibleCars, CAR_INSTANCE_GRAIN, [&](int begin, int end) {
+                PROFILE_ZONE("car matrices");
+                carTransforms.composeWorldMatrices(carBodyNodes, carBodyFirst + begin, carBodyFirst + end, carBodyMatrices + begin * 16);
+                carTransforms.composeWorldMatrices(cabinNodes, cabinFirst + begin, cabinFirst + end, cabinMatrices + begin * 16);
+                carTransforms.composeWorldMatrices(wheelNodes, wheelFirst + begin * VEHICLE_WHEELS, wheelFirst + end * VEHICLE_WHEELS,
+                                                   wheelMatrices + begin * VEHICLE_WHEELS * 16);
+            });
+        } else {
+            visibleCars = 0;
+        }
+        if (carBodyMatrices) unmapInstanceMatrices(carBodyInstanceVBO);
+        if (cabinMatrices) unmapInstanceMatrices(cabinInstanceVBO);
+        if (wheelMatrices) unmapInstanceMatrices(wheelInstanceVBO);
+        carMatricesZone.end();
+
+        gpuTimer.beginFrame();
+        if (gpuTimer.readbacks() != lastGpuReadback) {
+            lastGpuReadback = gpuTimer.readbacks();
+            dynamicResolution.update(gpuTimer.latestBusyMs());
+        }
 
-        double mousePosX, mousePosY;
-        glfwGetCursorPos(window, &mousePosX, &mousePosY);
-        
-        double dx = mousePosX - lastMousePosX;
-        double dy = mousePosY - lastMousePosY;
-        
-        lastMousePosX = mousePosX;
-        lastMousePosY = mousePosY;
+        // The world with a given projection into the bound framebuffer: once per frame, and once
+        // per tile when a photo is taken
+        auto drawScene = [&](const glm::mat4& drawProjection) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear the screen
+
+            // Get the location of the color uniform
+            int colorLocation = glGetUniformLocation(shaderProgram, "vertexColor");
+
+            // --- CLOUDS DRAWING (before other objects) ---
+            ProfileZone cloudZone("cloud pass");
+            gpuTimer.beginPass("clouds");
+            glsUseProgram(texturedShaderProgram);
+            GLuint textureSamplerLocation = glGetUniformLocation(texturedShaderProgram, "textureSampler");
+            GLint uvScaleLocation = glGetUniformLocation(texturedShaderProgram, "uvScale");
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+            GLint useBlackKeyLoc = glGetUniformLocation(texturedShaderProgram, "useBlackKey");
+            glsUniform1i(useBlackKeyLoc, GL_FALSE);
+
+            scene.each<CloudBillboard, WorldMatrix>([&](Entity, CloudBillboard& cloud, WorldMatrix& world) {
+                glsActiveTexture(GL_TEXTURE0);
+                glsBindTexture(GL_TEXTURE_2D, cloud.textureID);
+                glsUniform1i(textureSamplerLocation, 0);
+                glsUniform1f(uvScaleLocation, 1.0f);
+                setWorldMatrix(texturedShaderProgram, world.value);
+                setProjectionMatrix(texturedShaderProgram, drawProjection);
+                setViewMatrix(texturedShaderProgram, view);
+                glsBindVertexArray(cloudVAO);
+                glsDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            });
+
+            glsUniform1i(useBlackKeyLoc, GL_FALSE);
+            glDisable(GL_BLEND);
+
+            gpuTimer.endPass();
+            cloudZone.end();
+            // --- END CLOUDS ---
+
+            ProfileZone terrainZone("terrain");
+            gpuTimer.beginPass("terrain");
+            glsUseProgram(terrainShaderProgram);
+            setProjectionMatrix(terrainShaderProgram, drawProjection);
+            setViewMatrix(terrainShaderProgram, view);
+            drawTerrain(terrainMesh, simWorld.terrain, terrainDraws, eyePos, grassTextureID);
+            gpuTimer.endPass();
+
+            // Road, curbs and shoulders
+            glsUseProgram(texturedShaderProgram);
+            // textureSamplerLocation and uvScaleLocation already obtained above
+            glsActiveTexture(GL_TEXTURE0);
+            glsUniform1i(textureSamplerLocation, 0);
+            glsUniform1f(uvScaleLocation, 1.0f);
+            setProjectionMatrix(texturedShaderProgram, drawProjection);
+            setViewMatrix(texturedShaderProgram, view);
+            trackChunksDrawn = drawTrack(texturedShaderProgram, trackStreamer, trackVisible, trackTextures,
+                                         trackDrawLists, gpuTimer);
+            terrainZone.end();
+
+            // Draw the scene file's scenery (hills, light poles, grandstands...)
+            {
+                PROFILE_ZONE("props");
+                drawScenery(texturedShaderProgram, sceneFile, sceneryOrder, sceneryVisible, sceneryModels, sceneTextures, uvScaleLocation, gpuTimer);
+            }
 
-        // Convert to spherical coordinates
-        const float cameraAngularSpeed = 8.0f;
-        cameraHorizontalAngle -= dx * cameraAngularSpeed * deltaTime;
-        cameraVerticalAngle   -= dy * cameraAngularSpeed * deltaTime;
-        
-        // Clamp vertical angle to [-85, 85] degrees
-        cameraVerticalAngle = std::max(-85.0f, std::min(85.0f, cameraVerticalAngle));
+            ProfileZone carZone("car");
+            gpuTimer.beginPass("car");
+            glsUseProgram(instancedShaderProgram);
+            setProjectionMatrix(instancedShaderProgram, drawProjection);
+            setViewMatrix(instancedShaderProgram, view);
+            glsUniform1i(glGetUniformLocation(instancedShaderProgram, "textureSampler"), 0);
+            glsUniform1f(glGetUniformLocation(instancedShaderProgram, "uvScale"), 1.0f);
+            glsUniform1i(glGetUniformLocation(instancedShaderProgram, "useBlackKey"), GL_FALSE);
+
+            glsBindTexture(GL_TEXTURE_2D, carTexture);
+            glsBindVertexArray(carBodyVAO);
+            glsDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, visibleCars);
+            glsBindVertexArray(cabinVAO);
+            glsDrawElementsInstanced(GL_TRIANGLES, 30, GL_UNSIGNED_INT, 0, visibleCars);
+            glsBindTexture(GL_TEXTURE_2D, tireTexture);
+            glsBindVertexArray(wheelVAO);
+            glsDrawElementsInstanced(GL_TRIANGLES, wheelIndexCount, GL_UNSIGNED_INT, 0, visibleCars * VEHICLE_WHEELS);
+            gpuTimer.endPass();
+            carZone.end();
         
-        float theta = radians(cameraHorizontalAngle);
-        float phi = radians(cameraVerticalAngle);
-        
-        cameraFront = vec3(cosf(phi)*cosf(theta), sinf(phi), -cosf(phi)*sinf(theta));
-        vec3 cameraSide = cross(cameraFront, vec3(0.0f, 1.0f, 0.0f));
-        glm::normalize(cameraSide);
-
-
-        // Speed multiplier for shift
-        float speedMultiplier = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS ? 3.0f : 1.0f;
+            // Draw the Cybertruck (centered and scaled)
+            glsUseProgram(shaderProgram);
+            setProjectionMatrix(shaderProgram, drawProjection);
+            setViewMatrix(shaderProgram, view);
+            setWorldMatrix(shaderProgram, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.1f, 9.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f, 0.5f, 0.5f)));
+            glsBindVertexArray(cybertruckData.VAO);
+            //glDrawElements(GL_TRIANGLES, cybertruckData.indexCount, GL_UNSIGNED_INT, 0); // Draw the Cybertruck model
+            
+            glsBindVertexArray(0); // Unbind VAO
+
+            // Draw the Bird model
+            ProfileZone birdZone("birds");
+            gpuTimer.beginPass("birds");
+            setWorldMatrix(shaderProgram, birdTransforms.worldMatrix(birdRig.bird));
+            glsBindVertexArray(birdData.VAO);
+            glsDrawElements(GL_TRIANGLES, birdData.indexCount, GL_UNSIGNED_INT, 0); // Draw the Bird model
+
+            setWorldMatrix(shaderProgram, birdTransforms.worldMatrix(birdRig.orbitingBird));
+            glsBindVertexArray(birdData.VAO);
+            glsDrawElements(GL_TRIANGLES, birdData.indexCount, GL_UNSIGNED_INT, 0); // Draw the second Bird model
+            gpuTimer.endPass();
+            birdZone.end();
+        };
 
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS){
-            cameraPos += cameraFront * deltaTime * 1.0f * speedMultiplier; // Move forward
+        // Photo (F12): the same frame at photo resolution, tile by tile, before the normal one
+        if (takePhoto) {
+            PROFILE_ZONE("photo");
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            int photoHeight = static_cast<int>(double(photoWidth) * framebufferHeight / std::max(1, framebufferWidth) + 0.5);
+            char photoPath[32];
+            snprintf(photoPath, sizeof(photoPath), "photo_%03d.tga", ++photoCount);
+            double photoStart = glfwGetTime();
+            if (renderTiledScreenshot(photoPath, photoWidth, photoHeight, projection, drawScene))
+                std::cout << "Wrote " << photoWidth << "x" << photoHeight << " photo " << photoPath << " in "
+                          << glfwGetTime() - photoStart << " s" << std::endl;
+            glViewport(0, 0, framebufferWidth, framebufferHeight);
+            takePhoto = false;
         }
 
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS){
-            cameraPos -= cameraFront * deltaTime * 1.0f * speedMultiplier; // Move backward
+        // The world at the dynamic resolution scale, stretched onto the window
+        int windowWidth, windowHeight;
+        glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+        bool sceneScaled = dynamicResolution.enabled && windowWidth > 0 && windowHeight > 0;
+        if (sceneScaled && (sceneTarget.width != windowWidth || sceneTarget.height != windowHeight)) {
+            sceneScaled = sceneTarget.create(windowWidth, windowHeight, "dynamic resolution");
+            if (!sceneScaled) dynamicResolution.enabled = false;
         }
-
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS){
-            cameraPos -= cameraSide * deltaTime * 1.0f * speedMultiplier; // Move left
-        } 
-        
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS){
-            cameraPos += cameraSide * deltaTime * 1.0f * speedMultiplier; // Move right
+        int sceneWidth = dynamicResolution.scaledSize(windowWidth);
+        int sceneHeight = dynamicResolution.scaledSize(windowHeight);
+        if (sceneScaled) {
+            glBindFramebuffer(GL_FRAMEBUFFER, sceneTarget.framebuffer);
+            glViewport(0, 0, sceneWidth, sceneHeight);
+        }
+        drawScene(projection);
+        if (sceneScaled) {
+            gpuTimer.beginPass("upscale");
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneTarget.framebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, windowWidth, windowHeight);
+            gpuTimer.endPass();
         }
 
-        // Car commands
-        float carSpeed = 5.0f * deltaTime;
-        float wheelSpinSpeed = 120.0f * deltaTime;
-
-        if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) {
-            carPos += carSpeed * glm::vec3(sin(glm::radians(carYaw)), 0.0f, -cos(glm::radians(carYaw)));
-            wheelAngle -= wheelSpinSpeed;
+        // Performance HUD over everything else
+        if (showHud) {
+            PROFILE_ZONE("hud");
+            gpuTimer.beginPass("hud");
+            buildPerformanceHud(hud, frameHistory, frameHistoryStart, hudCpuTimings, hudGpuTimings,
+                                gpuTimer.averageFrameMs(), glsPreviousFrameStats(),
+                                sceneScaled ? dynamicResolution.scale : 0.0f);
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+
+            glsUseProgram(hudShaderProgram);
+            glsUniform2f(hudScreenSizeLocation, static_cast<float>(framebufferWidth), static_cast<float>(framebufferHeight));
+            glsUniform1i(glGetUniformLocation(hudShaderProgram, "textureSampler"), 0);
+            glsActiveTexture(GL_TEXTURE0);
+            glsBindTexture(GL_TEXTURE_2D, hudAtlasTexture);
+            glBindBuffer(GL_ARRAY_BUFFER, hudInstanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, hud.quads().size() * sizeof(HudQuad), hud.quads().data(), GL_STREAM_DRAW);
+            resources().resizeGpu(GPU_BUFFER, hudInstanceVBO, hud.quads().size() * sizeof(HudQuad));
+
+            glDisable(GL_DEPTH_TEST);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glsBindVertexArray(hudVAO);
+            glsDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(hud.quads().size()));
+            glsBindVertexArray(0);
+            glDisable(GL_BLEND);
+            glEnable(GL_DEPTH_TEST);
+            gpuTimer.endPass();
         }
-        if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS) {
-            carPos -= carSpeed * glm::vec3(sin(glm::radians(carYaw)), 0.0f, -cos(glm::radians(carYaw)));
-            wheelAngle += wheelSpinSpeed;
+        gpuTimer.endFrame();
+        trackStreamer.endFrame();
+
+        // Export: queue this frame's readback and hand finished ones to the encoders
+        if (exporting) {
+            PROFILE_ZONE("export");
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            frameReadback.capture(frameEncoders, framebufferWidth, framebufferHeight);
+            while (frameReadback.collect(frameEncoders, false)) {}
+            if (++exportedFrames == exportFrames) glfwSetWindowShouldClose(window, true);
         }
 
-        // Steering (J = left, L = right)
-        steerAngle = 0.0f;
-        if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS) steerAngle = 25.0f;
-        if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS) steerAngle = -25.0f;
-
-        // 1st person and 3rd person camera toggle
-        
-        if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) 
         {
-            cameraFirstPerson = true;
+            PROFILE_ZONE("swap");
+            framePacer.workDone();
+            glfwSwapBuffers(window); // Swap buffers
         }
-
-        if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) 
-        {
-            cameraFirstPerson = false;
+        framePacer.presented();
+
+        // Input to present: from the oldest event this frame used to the swap returning
+        // (with vsync the driver may still queue the image, so this is a lower bound)
+        if (inputQueue.oldestEventTime() >= 0.0)
+            reportLatency.add((glfwGetTime() - inputQueue.oldestEventTime()) * 1000.0);
+
+        // Average frame and simulation time against the size of the AI field
+        ++reportFrames;
+        double reportSeconds = glfwGetTime() - reportStart;
+        if (reportSeconds >= 2.0) {
+            std::cout << "AI cars: " << aiCarCount(simWorld)
+                      << "  frame: " << reportSeconds * 1000.0 / reportFrames << " ms"
+                      << "  simulation: " << reportSimSeconds * 1000.0 / reportFrames << " ms"
+                      << "  (" << jobSystem().threadCount() << " threads, " << transformKernelName() << " transforms)";
+            if (dynamicResolution.enabled) std::cout << "  resolution: " << int(dynamicResolution.scale * 100.0f + 0.5f) << "%";
+            std::cout << std::endl;
+            std::cout << "  job threads busy:";
+            for (const JobWorkerStats& worker : jobSystem().stats())
+                std::cout << " " << int(worker.utilization * 100.0 + 0.5) << "%";
+            std::cout << std::endl;
+            jobSystem().resetStats();
+            std::cout << "  gpu: " << gpuTimer.averageFrameMs() << " ms:";
+            for (const GpuPassStats& pass : gpuTimer.stats())
+                std::cout << " " << pass.name << " " << pass.ms;
+            if (gpuTimer.droppedFrames() > 0) std::cout << "  (" << gpuTimer.droppedFrames() << " frames late)";
+            std::cout << std::endl;
+            gpuTimer.resetStats();
+            std::cout << "  gl per frame: " << reportGl.drawCalls / reportFrames << " draws, "
+                      << reportGl.programSwitches / reportFrames << " programs, "
+                      << reportGl.textureBinds / reportFrames << " texture binds, "
+                      << reportGl.vertexArrayBinds / reportFrames << " VAO binds, "
+                      << reportGl.uniformUpdates / reportFrames << " uniforms; redundant: "
+                      << reportGl.redundantPrograms / reportFrames << " programs, "
+                      << reportGl.redundantTextures / reportFrames << " textures, "
+                      << reportGl.redundantVertexArrays / reportFrames << " VAOs, "
+                      << reportGl.redundantUniforms / reportFrames << " uniforms"
+                      << (glsElision() ? " (elided)" : " (issued)") << std::endl;
+            reportGl = GlFrameStats();
+            std::cout << "  terrain: " << terrainDraws.size() << " of " << simWorld.terrain.chunks().size()
+                      << " chunks, " << terrainTriangles << " triangles" << std::endl;
+            TrackStreamStats trackStats = trackStreamer.streamStats();
+            std::cout << "  track: " << track.length() << " m lap in " << track.chunks().size() << " chunks, "
+                      << trackStats.resident << " resident, " << trackChunksDrawn << " drawn; " << trackStats.loads
+                      << " loaded, " << trackStats.evictions << " dropped, " << trackStats.deferred << " deferred"
+                      << (trackStreamer.persistentlyMapped() ? " (persistent ring)" : " (copied ring)") << std::endl;
+            trackStreamer.resetStats();
+            std::cout << "  occlusion" << (occlusion.isEnabled() ? "" : " (off)") << ": " << occlusion.occluderCount()
+                      << " occluders, per frame " << reportOcclusion.occluders / reportFrames << " drawn as "
+                      << reportOcclusion.quads / reportFrames << " quads, hiding "
+                      << reportOcclusion.scenery / reportFrames << " scenery, "
+                      << reportOcclusion.trackChunks / reportFrames << " track chunks, "
+                      << reportOcclusion.terrainChunks / reportFrames << " terrain chunks, "
+                      << reportOcclusion.cars / reportFrames << " cars";
+            if (!pvs.empty())
+                std::cout << "; visible sets in " << reportOcclusion.pvsFrames * 100 / reportFrames << "% of frames";
+            std::cout << std::endl;
+            reportOcclusion = OcclusionReport();
+            std::cout << "  input to present: " << reportLatency.averageMs() << " ms average, "
+                      << reportLatency.maxMs << " ms max over " << reportLatency.frames << " frames with input" << std::endl;
+            reportLatency.reset();
+            PacingStats pacing = framePacer.stats();
+            std::cout << "  pacing " << PACING_MODE_NAMES[framePacer.pacingMode()];
+            if (framePacer.periodMs() > 0.0) std::cout << " (" << framePacer.periodMs() << " ms)";
+            std::cout << ": " << pacing.averageMs << " ms average, " << pacing.jitterMs << " ms jitter, "
+                      << pacing.worstMs << " ms worst, " << pacing.late << " late; waited "
+                      << pacing.sleepMs << " ms asleep + " << pacing.spinMs << " ms spinning per frame" << std::endl;
+            framePacer.resetStats();
+            reportStart = glfwGetTime();
+            reportSimSeconds = 0.0;
+            reportFrames = 0;
         }
 
 
+
     }
     
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteVertexArrays(1, &floorVAO);
-    glDeleteVertexArrays(1, &roadVAO);
-    glDeleteVertexArrays(1, &curbVAO);
-    glDeleteVertexArrays(1, &carBodyVAO);
-    glDeleteVertexArrays(1, &cabinVAO);
-    glDeleteVertexArrays(1, &wheelVAO);
+    if (exporting) {
+        frameReadback.flush(frameEncoders);
+        frameEncoders.close();
+        double exportSeconds = glfwGetTime() - exportStart;
+        std::cout << "Exported " << frameEncoders.written() << " frames (" << formatBytes(frameEncoders.writtenBytes())
+                  << ") in " << exportSeconds << " s: " << frameEncoders.written() / exportSeconds << " frames/s with "
+                  << encoderThreads << " encoder threads, " << frameReadback.stalls() << " readback stalls" << std::endl;
+        frameReadback.destroy();
+    }
 
-    
+    resources().printReport("exit");
+
+    deleteVertexArray(cloudVAO);
+    deleteBuffer(cloudVBO);
+    deleteVertexArray(cubeVAO);
+    deleteBuffer(cubeVBO);
+    deleteTerrainMesh(terrainMesh);
+    trackStreamer.destroy();
+    deleteVertexArray(carBodyVAO);
+    deleteBuffer(carBodyVBO);
+    deleteBuffer(carBodyEBO);
+    deleteVertexArray(cabinVAO);
+    deleteBuffer(cabinVBO);
+    deleteBuffer(cabinEBO);
+    deleteVertexArray(wheelVAO);
+    deleteBuffer(wheelVBO);
+    deleteBuffer(wheelEBO);
+    deleteBuffer(carBodyInstanceVBO);
+    deleteBuffer(cabinInstanceVBO);
+    deleteBuffer(wheelInstanceVBO);
+    deleteModel(cybertruckData);
+    deleteModel(birdData);
+    for (ModelData& model : sceneryModels) deleteModel(model);
+
+    deleteTexture(grassTextureID);
+    deleteTexture(asphaltTextureID);
+    deleteTexture(curbTextureID);
+    deleteTexture(cobblestoneTextureID);
+    deleteTexture(carTexture);
+    deleteTexture(tireTexture);
+    for (GLuint& texture : sceneTextures) deleteTexture(texture);
+
+    gpuTimer.destroy();
+    sceneTarget.destroy();
+    deleteVertexArray(hudVAO);
+    deleteBuffer(hudQuadVBO);
+    deleteBuffer(hudInstanceVBO);
+    deleteTexture(hudAtlasTexture);
+
+    // Anything still registered was never deleted
+    int leaks = resources().reportLeaks();
+    if (leaks > 0) std::cerr << leaks << " GL objects leaked" << std::endl;
     glfwTerminate(); // Terminate GLFW
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "VehicleDynamics.h"
+#include "SpatialHash.h"
+#include "TrackMesh.h"
+
+// AI drivers for the opponent field.
+//
+// Driver state is stored as arrays indexed by vehicle slot, parallel to the VehicleBatch
+// (the player's slot is simply inactive). Each AI car keeps to a lane at a fixed offset
+// from the track centreline and drives round the lap, so nobody ever has to be moved back
+// to the start: lanes left of the centreline (in the track's driving order) drive with it,
+// lanes right of it against it. The road holds one lane each way. Big fields spill into
+// further lanes out over the grass on the outside of the loop; that is a stress-test
+// layout, not a race. A lane is the centreline pushed sideways, so where a bend is tighter
+// than a far lane's offset that lane folds back on itself and its cars cut across.
+//
+// Every car remembers how far round the lap it is (lapDistance, in centreline metres) and
+// steers by pure pursuit at its lane's point AI_LOOKAHEAD centreline metres further on.
+// driveAiVehicles() only reads the broadphase and the track and only writes its own
+// slots, so disjoint vehicle ranges can be driven from different threads in the same step.
+
+// ---------- AI tuning constants ----------
+const float AI_FIRST_LANE_OFFSET = 0.75f;   // lane centres on the road itself, either side of the centreline
+const float AI_LANE_SPACING      = 2.2f;    // extra lanes beyond the road
+const float AI_MIN_CAR_SPACING   = 8.0f;    // metres along a lane at spawn
+const float AI_LOOKAHEAD         = 8.0f;    // pure-pursuit target distance
+const float AI_WHEELBASE         = 2.2f;
+const float AI_MIN_CRUISE_SPEED  = 8.0f;    // m/s
+const float AI_MAX_CRUISE_SPEED  = 14.0f;
+const float AI_SCAN_AHEAD        = 3.0f;    // centre of the "car ahead" query sphere
+const float AI_SCAN_RADIUS       = 2.0f;    // + object radius must stay within the broadphase cell
+const float AI_SCAN_HALF_WIDTH   = 1.0f;    // ignore cars further to the side than this (other lanes)
+const float AI_STOP_GAP          = 3.2f;    // centre-to-centre distance at which the car wants to stand still
+const float AI_GAP_SPEED_GAIN    = 2.0f;    // allowed speed per metre of gap beyond the stop gap
+const float AI_MIN_LANE_STRETCH  = 0.25f;   // lane metres per centreline metre assumed where a lane folds back
+const int   AI_WINDING_SAMPLES   = 64;      // centreline points used to tell the outside of the loop
+
+struct AiTraffic {
+    std::vector<uint8_t> active;        // 0 for the player and free slots
+    std::vector<float> laneOffset;      // lane centre, metres left of the centreline in driving order
+    std::vector<float> lapDistance;     // centreline metres round the lap, in [0, track length)
+    std::vector<float> direction;       // +1 drives in the track's driving order, -1 against it
+    std::vector<float> cruiseSpeed;     // m/s on an empty lane
+
+    void resize(int vehicleCount)
+    {
+        active.resize(vehicleCount, 0);
+        laneOffset.resize(vehicleCount, 0.0f);
+        lapDistance.resize(vehicleCount, 0.0f);
+        direction.resize(vehicleCount, 1.0f);
+        cruiseSpeed.resize(vehicleCount, 0.0f);
+    }
+
+    size_t memoryBytes() const
+    {
+        return vectorBytes(active) + vectorBytes(laneOffset) + vectorBytes(lapDistance) + vectorBytes(direction) +
+               vectorBytes(cruiseSpeed);
+    }
+};
+
+// Point of the lane `offset` metres left of the centreline, `distance` metres round the lap
+// (forward = (sin h, 0, cos h) has left = (cos h, 0, -sin h), i.e. (t.z, 0, -t.x))
+inline glm::vec3 aiLanePoint(const TrackMesh& track, float distance, float offset)
+{
+    glm::vec3 centre, tangent;
+    track.frameAt(distance, centre, tangent);
+    return centre + glm::vec3(tangent.z, 0.0f, -tangent.x) * offset;
+}
+
+// +1 if the outside of the loop is left of the driving order, -1 if it is on the right
+inline float aiOutsideSide(const TrackMesh& track)
+{
+    // Twice the signed area in the ground plane; negative when the lap turns to the right
+    float area = 0.0f;
+    glm::vec3 previous, tangent;
+    track.frameAt(0.0f, previous, tangent);
+    for (int i = 1; i <= AI_WINDING_SAMPLES; ++i) {
+        glm::vec3 p;
+        track.frameAt(track.length() * i / AI_WINDING_SAMPLES, p, tangent);
+        area += previous.x * p.z - p.x * previous.z;
+        previous = p;
+    }
+    return area < 0.0f ? -1.0f : 1.0f;
+}
+
+// Spawn slot for AI car `index` of `total`: lane, position along it, direction
+struct AiSpawn {
+    glm::vec3 position;
+    float heading;
+    float laneOffset;
+    float lapDistance;
+    float direction;
+};
+
+inline AiSpawn aiSpawnSlot(int index, int total, const TrackMesh& track, float outsideSide)
+{
+    int carsPerLaneMax = std::max(1, static_cast<int>(track.length() / AI_MIN_CAR_SPACING));
+    int lanes = std::max(2, (total + carsPerLaneMax - 1) / carsPerLaneMax);
+    int carsPerLane = (total + lanes - 1) / lanes;
+
+    int lane = index % lanes;           // deal round-robin so every lane gets traffic
+    int slot = index / lanes;
+
+    AiSpawn spawn;
+    if (lane < 2) spawn.laneOffset = (lane == 0 ? 1.0f : -1.0f) * AI_FIRST_LANE_OFFSET;
+    else spawn.laneOffset = outsideSide * (AI_FIRST_LANE_OFFSET + (lane - 1) * AI_LANE_SPACING);
+    spawn.direction = spawn.laneOffset > 0.0f ? 1.0f : -1.0f;   // keep left, like the road's two lanes
+    float spacing = track.length() / carsPerLane;
+    spawn.lapDistance = fmodf((slot + 0.5f) * spacing + 0.37f * spacing * (lane % 3), track.length());
+
+    glm::vec3 centre, tangent;
+    track.frameAt(spawn.lapDistance, centre, tangent);
+    spawn.position = centre + glm::vec3(tangent.z, 0.0f, -tangent.x) * spawn.laneOffset;
+    spawn.heading = atan2f(tangent.x * spawn.direction, tangent.z * spawn.direction);
+    return spawn;
+}
+
+// Set throttle, brake and steering for the AI cars in vehicle slots [begin, end)
+inline void driveAiVehicles(AiTraffic& ai, const TrackMesh& track, VehicleBatch& v, const VehicleParams& params,
+                            const SpatialHash& broadphase, const std::vector<int>& vehicleProxies,
+                            int begin, int end)
+{
+    float lapLength = track.length();
+    for (int i = begin; i < end; ++i) {
+        if (!ai.active[i]) continue;
+        float s = sinf(v.heading[i]), c = cosf(v.heading[i]);
+        glm::vec3 position(v.posX[i], v.posY[i], v.posZ[i]);
+        glm::vec3 forward(s, 0.0f, c);
+        glm::vec3 left(c, 0.0f, -s);
+        float forwardSpeed = v.velX[i] * s + v.velZ[i] * c;
+
+        // Move the lap distance to the lane point abreast of the car: one Newton step along
+        // the centreline tangent, over how far the lane moves that way per centreline metre.
+        // Where a far lane folds back on itself (a bend tighter than its offset) that goes
+        // negative; the floor keeps the step pointing the way the car is from its lane point.
+        float distance = ai.lapDistance[i];
+        glm::vec3 centre, tangent;
+        track.frameAt(distance, centre, tangent);
+        glm::vec3 lanePoint = centre + glm::vec3(tangent.z, 0.0f, -tangent.x) * ai.laneOffset[i];
+        glm::vec3 laneStep = aiLanePoint(track, distance + 1.0f, ai.laneOffset[i]) - lanePoint;
+        float stretch = std::max(AI_MIN_LANE_STRETCH, laneStep.x * tangent.x + laneStep.z * tangent.z);
+        float progress = ((position.x - lanePoint.x) * tangent.x + (position.z - lanePoint.z) * tangent.z) / stretch;
+        distance = fmodf(distance + std::max(-AI_LOOKAHEAD, std::min(AI_LOOKAHEAD, progress)), lapLength);
+        if (distance < 0.0f) distance += lapLength;
+        ai.lapDistance[i] = distance;
+
+        // Pure pursuit towards a point on the lane ahead; local +x is the car's left
+        glm::vec3 target = aiLanePoint(track, distance + ai.direction[i] * AI_LOOKAHEAD, ai.laneOffset[i]);
+        float dx = target.x - position.x;
+        float dz = target.z - position.z;
+        float lateral = dx * c - dz * s;
+        float curvature = 2.0f * lateral / std::max(1e-4f, dx * dx + dz * dz);
+        float steerAngle = atanf(AI_WHEELBASE * curvature);
+        v.steerInput[i] = std::max(-1.0f, std::min(1.0f, steerAngle / params.maxSteer));
+
+        // Follow whatever the broadphase finds just ahead (AI or player)
+        float gap = 1e9f;
+        int self = vehicleProxies[i];
+        broadphase.query(position + forward * AI_SCAN_AHEAD, AI_SCAN_RADIUS, [&](int handle) {
+            if (handle == self) return;
+            glm::vec3 offset = broadphase.positions[handle] - position;
+            float along = glm::dot(offset, forward);
+            if (along > 0.0f && fabsf(glm::dot(offset, left)) < AI_SCAN_HALF_WIDTH) gap = std::min(gap, along);
+        });
+        float desired = std::min(ai.cruiseSpeed[i], std::max(0.0f, (gap - AI_STOP_GAP) * AI_GAP_SPEED_GAIN));
+
+        float error = desired - forwardSpeed;
+        v.throttle[i] = std::max(0.0f, std::min(1.0f, error * 0.5f));
+        v.brake[i] = error < -0.5f ? std::min(1.0f, -error * 0.3f) : 0.0f;
+    }
+}
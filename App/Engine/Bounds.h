@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cfloat>
+#include <glm/glm.hpp>
+
+// Axis-aligned bounding box in world or model space
+struct Aabb {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    Aabb() {}
+    Aabb(const glm::vec3& lo, const glm::vec3& hi) : min(lo), max(hi) {}
+
+    bool valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+    void grow(const glm::vec3& p)
+    {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void grow(const Aabb& b)
+    {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+
+    float surfaceArea() const
+    {
+        if (!valid()) return 0.0f;
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool overlaps(const Aabb& b) const
+    {
+        return min.x <= b.max.x && max.x >= b.min.x &&
+               min.y <= b.max.y && max.y >= b.min.y &&
+               min.z <= b.max.z && max.z >= b.min.z;
+    }
+};
+
+inline Aabb aabbFromCenterExtents(const glm::vec3& center, const glm::vec3& extents)
+{
+    return Aabb(center - extents, center + extents);
+}
+
+// Bounds of a model-space box after an affine transform (Arvo's method)
+inline Aabb transformAabb(const glm::mat4& m, const Aabb& b)
+{
+    glm::vec3 center = glm::vec3(m * glm::vec4(b.center(), 1.0f));
+    glm::vec3 e = b.extents();
+    glm::vec3 extents(
+        fabsf(m[0][0]) * e.x + fabsf(m[1][0]) * e.y + fabsf(m[2][0]) * e.z,
+        fabsf(m[0][1]) * e.x + fabsf(m[1][1]) * e.y + fabsf(m[2][1]) * e.z,
+        fabsf(m[0][2]) * e.x + fabsf(m[1][2]) * e.y + fabsf(m[2][2]) * e.z);
+    return aabbFromCenterExtents(center, extents);
+}
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cfloat>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include "ResourceRegistry.h"
+
+// Static bounding volume hierarchy over scenery bounds.
+//
+// Built once with binned SAH, then flattened depth-first into a node array: a node's
+// left child is the next node, the right child is stored explicitly, and each node is
+// 32 bytes so two fit in a cache line. Leaf primitive bounds are copied into leaf order
+// so leaf tests walk memory linearly.
+//
+// Queries: overlap (box vs scenery), raycast (camera boom), sweep (moving box, for the
+// car and free camera each simulation step) and queryRay (any-hit segment tests against
+// primitives that are not boxes, for visibility baking).
+
+struct BvhNode {
+    float boundsMin[3];
+    uint32_t leftOrFirst;   // interior: index of right child; leaf: first entry in leafBounds
+    float boundsMax[3];
+    uint32_t primCount;     // 0 for interior nodes
+};
+
+struct BvhHit {
+    float t = FLT_MAX;      // ray: distance; sweep: fraction of the move in [0, 1]
+    int primitive = -1;
+    glm::vec3 normal = glm::vec3(0.0f);
+};
+
+const int BVH_SAH_BINS = 12;
+const int BVH_MAX_DEPTH = 64;
+
+struct StaticBvh {
+    std::vector<BvhNode> nodes;
+    std::vector<Aabb> leafBounds;        // primitive bounds in leaf order
+    std::vector<uint32_t> leafPrims;     // original primitive index for each leafBounds entry
+
+    bool empty() const { return nodes.empty(); }
+
+    size_t memoryBytes() const { return vectorBytes(nodes) + vectorBytes(leafBounds) + vectorBytes(leafPrims); }
+
+    void build(const std::vector<Aabb>& bounds, int maxLeafSize = 2)
+    {
+        nodes.clear();
+        leafBounds.clear();
+        leafPrims.clear();
+        if (bounds.empty()) return;
+
+        std::vector<uint32_t> refs(bounds.size());
+        std::vector<glm::vec3> centroids(bounds.size());
+        for (size_t i = 0; i < bounds.size(); ++i) {
+            refs[i] = static_cast<uint32_t>(i);
+            centroids[i] = bounds[i].center();
+        }
+        nodes.reserve(bounds.size() * 2);
+        buildNode(bounds, centroids, refs, 0, static_cast<uint32_t>(refs.size()), maxLeafSize, 0);
+
+        leafBounds.reserve(refs.size());
+        for (uint32_t r : refs) leafBounds.push_back(bounds[r]);
+        leafPrims = refs;
+    }
+
+    // Calls visit(primitiveIndex) for every primitive whose bounds overlap box
+    template <typename Visit>
+    void queryOverlap(const Aabb& box, Visit visit) const
+    {
+        if (nodes.empty()) return;
+        uint32_t stack[BVH_MAX_DEPTH];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const BvhNode& node = nodes[stack[--top]];
+            if (!nodeOverlaps(node, box)) continue;
+            if (node.primCount > 0) {
+                for (uint32_t i = 0; i < node.primCount; ++i) {
+                    uint32_t entry = node.leftOrFirst + i;
+                    if (leafBounds[entry].overlaps(box)) visit(static_cast<int>(leafPrims[entry]));
+                }
+            } else {
+                uint32_t self = static_cast<uint32_t>(&node - nodes.data());
+                stack[top++] = node.leftOrFirst;
+                stack[top++] = self + 1;
+            }
+        }
+    }
+
+    int overlap(const Aabb& box, std::vector<int>& out) const
+    {
+        out.clear();
+        queryOverlap(box, [&out](int prim) { out.push_back(prim); });
+        return static_cast<int>(out.size());
+    }
+
+    bool overlapsAny(const Aabb& box) const
+    {
+        bool found = false;
+        queryOverlap(box, [&found](int) { found = true; });
+        return found;
+    }
+
+    // Closest hit of the ray origin + t * dir for t in [0, maxDistance] (dir need not be unit)
+    bool raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDistance, BvhHit& hit) const
+    {
+        return castBox(origin, dir, glm::vec3(0.0f), maxDistance, hit);
+    }
+
+    // Calls visit(primitiveIndex) for every primitive whose bounds the segment origin + t * dir,
+    // t in [0, maxT], passes through, in no particular order, until visit returns true;
+    // returns whether one did
+    template <typename Visit>
+    bool queryRay(const glm::vec3& origin, const glm::vec3& dir, float maxT, Visit visit) const
+    {
+        if (nodes.empty()) return false;
+        glm::vec3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+        uint32_t stack[BVH_MAX_DEPTH];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            uint32_t index = stack[--top];
+            const BvhNode& node = nodes[index];
+            if (!segmentCrosses(node.boundsMin, node.boundsMax, origin, invDir, maxT)) continue;
+            if (node.primCount > 0) {
+                for (uint32_t i = 0; i < node.primCount; ++i) {
+                    const Aabb& b = leafBounds[node.leftOrFirst + i];
+                    if (segmentCrosses(&b.min.x, &b.max.x, origin, invDir, maxT) &&
+                        visit(static_cast<int>(leafPrims[node.leftOrFirst + i])))
+                        return true;
+                }
+            } else {
+                stack[top++] = node.leftOrFirst;
+                stack[top++] = index + 1;
+            }
+        }
+        return false;
+    }
+
+    // Earliest contact of box moving by delta; hit.t is the allowed fraction of delta.
+    // Primitives the box already overlaps are ignored so a stuck object can always move out.
+    bool sweep(const Aabb& box, const glm::vec3& delta, BvhHit& hit) const
+    {
+        return castBox(box.center(), delta, box.extents(), 1.0f, hit);
+    }
+
+private:
+    static bool nodeOverlaps(const BvhNode& n, const Aabb& b)
+    {
+        return n.boundsMin[0] <= b.max.x && n.boundsMax[0] >= b.min.x &&
+               n.boundsMin[1] <= b.max.y && n.boundsMax[1] >= b.min.y &&
+               n.boundsMin[2] <= b.max.z && n.boundsMax[2] >= b.min.z;
+    }
+
+    // Slab test of the segment t in [0, maxT]; an axis the segment runs along exactly on a
+    // face gives NaN, which the max/min leave out
+    static bool segmentCrosses(const float* lo, const float* hi, const glm::vec3& origin, const glm::vec3& invDir, float maxT)
+    {
+        float tNear = 0.0f, tFar = maxT;
+        for (int a = 0; a < 3; ++a) {
+            float t0 = (lo[a] - origin[a]) * invDir[a];
+            float t1 = (hi[a] - origin[a]) * invDir[a];
+            if (t0 > t1) std::swap(t0, t1);
+            tNear = std::max(tNear, t0);
+            tFar = std::min(tFar, t1);
+            if (tNear > tFar) return false;
+        }
+        return true;
+    }
+
+    // Slab test against [lo - inflate, hi + inflate]; returns entry distance or FLT_MAX
+    static float slabEntry(const float* lo, const float* hi, const glm::vec3& inflate,
+                           const glm::vec3& origin, const glm::vec3& invDir, float maxT, int* entryAxis)
+    {
+        float tNear = -FLT_MAX, tFar = maxT;
+        int axis = -1;
+        for (int a = 0; a < 3; ++a) {
+            float t0 = (lo[a] - inflate[a] - origin[a]) * invDir[a];
+            float t1 = (hi[a] + inflate[a] - origin[a]) * invDir[a];
+            if (t0 > t1) std::swap(t0, t1);
+            if (t0 > tNear) { tNear = t0; axis = a; }
+            if (t1 < tFar) tFar = t1;
+            if (tNear > tFar) return FLT_MAX;
+        }
+        if (entryAxis) *entryAxis = axis;
+        return tNear;
+    }
+
+    bool castBox(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& extents,
+                 float maxT, BvhHit& hit) const
+    {
+        hit = BvhHit();
+        if (nodes.empty()) return false;
+        glm::vec3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+        float best = maxT;
+
+        uint32_t stack[BVH_MAX_DEPTH];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            uint32_t index = stack[--top];
+            const BvhNode& node = nodes[index];
+            if (slabEntry(node.boundsMin, node.boundsMax, extents, origin, invDir, best, nullptr) == FLT_MAX)
+                continue;
+
+            if (node.primCount > 0) {
+                for (uint32_t i = 0; i < node.primCount; ++i) {
+                    const Aabb& b = leafBounds[node.leftOrFirst + i];
+                    int axis = -1;
+                    float t = slabEntry(&b.min.x, &b.max.x, extents, origin, invDir, best, &axis);
+                    // t < 0 means we start inside: not a contact, let the mover escape
+                    if (t == FLT_MAX || t < 0.0f || t > best) continue;
+                    best = t;
+                    hit.t = t;
+                    hit.primitive = static_cast<int>(leafPrims[node.leftOrFirst + i]);
+                    hit.normal = glm::vec3(0.0f);
+                    hit.normal[axis] = dir[axis] > 0.0f ? -1.0f : 1.0f;
+                }
+                continue;
+            }
+
+            // Visit the nearer child first so the far one is usually culled by best
+            uint32_t left = index + 1, right = node.leftOrFirst;
+            float tLeft = slabEntry(nodes[left].boundsMin, nodes[left].boundsMax, extents, origin, invDir, best, nullptr);
+            float tRight = slabEntry(nodes[right].boundsMin, nodes[right].boundsMax, extents, origin, invDir, best, nullptr);
+            if (tLeft > tRight) { std::swap(left, right); std::swap(tLeft, tRight); }
+            if (tRight != FLT_MAX) stack[top++] = right;
+            if (tLeft != FLT_MAX) stack[top++] = left;
+        }
+        return hit.primitive >= 0;
+    }
+
+    uint32_t buildNode(const std::vector<Aabb>& bounds, const std::vector<glm::vec3>& centroids,
+                       std::vector<uint32_t>& refs, uint32_t first, uint32_t count, int maxLeafSize, int depth)
+    {
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(BvhNode());
+
+        Aabb nodeBounds, centroidBounds;
+        for (uint32_t i = first; i < first + count; ++i) {
+            nodeBounds.grow(bounds[refs[i]]);
+            centroidBounds.grow(centroids[refs[i]]);
+        }
+
+        int splitAxis = -1;
+        float splitPos = 0.0f;
+        float leafCost = static_cast<float>(count) * nodeBounds.surfaceArea();
+        float bestCost = leafCost;
+
+        if (static_cast<int>(count) > maxLeafSize && depth < BVH_MAX_DEPTH - 2) {
+            for (int axis = 0; axis < 3; ++axis) {
+                float lo = centroidBounds.min[axis], hi = centroidBounds.max[axis];
+                if (hi - lo < 1e-6f) continue;
+
+                Aabb binBounds[BVH_SAH_BINS];
+                int binCount[BVH_SAH_BINS] = {};
+                float scale = BVH_SAH_BINS / (hi - lo);
+                for (uint32_t i = first; i < first + count; ++i) {
+                    int bin = std::min(BVH_SAH_BINS - 1, static_cast<int>((centroids[refs[i]][axis] - lo) * scale));
+                    binCount[bin]++;
+                    binBounds[bin].grow(bounds[refs[i]]);
+                }
+
+                // Sweep from both sides to get the cost of every bin boundary
+                float rightArea[BVH_SAH_BINS];
+                int rightCount[BVH_SAH_BINS];
+                Aabb acc;
+                int n = 0;
+                for (int b = BVH_SAH_BINS - 1; b > 0; --b) {
+                    acc.grow(binBounds[b]);
+                    n += binCount[b];
+                    rightArea[b] = acc.surfaceArea();
+                    rightCount[b] = n;
+                }
+                acc = Aabb();
+                n = 0;
+                for (int b = 0; b < BVH_SAH_BINS - 1; ++b) {
+                    acc.grow(binBounds[b]);
+                    n += binCount[b];
+                    if (n == 0 || rightCount[b + 1] == 0) continue;
+                    // Traversal cost of one extra node ~ one primitive test
+                    float cost = nodeBounds.surfaceArea() + acc.surfaceArea() * n + rightArea[b + 1] * rightCount[b + 1];
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        splitAxis = axis;
+                        splitPos = lo + (b + 1) / scale;
+                    }
+                }
+            }
+        }
+
+        uint32_t mid = first;
+        if (splitAxis >= 0) {
+            uint32_t* begin = refs.data() + first;
+            uint32_t* split = std::partition(begin, begin + count, [&](uint32_t r) {
+                return centroids[r][splitAxis] < splitPos;
+            });
+            mid = static_cast<uint32_t>(split - refs.data());
+        }
+
+        if (splitAxis < 0 || mid == first || mid == first + count) {
+            BvhNode& leaf = nodes[index];
+            setBounds(leaf, nodeBounds);
+            leaf.leftOrFirst = first;
+            leaf.primCount = count;
+            return index;
+        }
+
+        buildNode(bounds, centroids, refs, first, mid - first, maxLeafSize, depth + 1);
+        uint32_t right = buildNode(bounds, centroids, refs, mid, first + count - mid, maxLeafSize, depth + 1);
+        BvhNode& node = nodes[index];
+        setBounds(node, nodeBounds);
+        node.leftOrFirst = right;
+        node.primCount = 0;
+        return index;
+    }
+
+    static void setBounds(BvhNode& node, const Aabb& b)
+    {
+        for (int a = 0; a < 3; ++a) {
+            node.boundsMin[a] = b.min[a];
+            node.boundsMax[a] = b.max[a];
+        }
+    }
+};
+
+// Move a box by delta against the scenery, sliding along the first surface it hits.
+// Returns the displacement actually allowed; contactNormal is zero if nothing was hit.
+inline glm::vec3 sweepAndSlide(const StaticBvh& bvh, const Aabb& box, const glm::vec3& delta, glm::vec3& contactNormal)
+{
+    const float skin = 1e-3f;   // stop just short of the surface
+    contactNormal = glm::vec3(0.0f);
+    BvhHit hit;
+    if (!bvh.sweep(box, delta, hit)) return delta;
+
+    contactNormal = hit.normal;
+    float moveLength = glm::length(delta);
+    float allowedT = moveLength > 0.0f ? std::max(0.0f, hit.t - skin / moveLength) : 0.0f;
+    glm::vec3 moved = delta * allowedT;
+
+    // Slide the rest of the move along the contact plane, once
+    glm::vec3 remainder = delta - moved;
+    remainder -= hit.normal * glm::dot(remainder, hit.normal);
+    Aabb slid(box.min + moved, box.max + moved);
+    BvhHit slideHit;
+    if (bvh.sweep(slid, remainder, slideHit)) {
+        float slideLength = glm::length(remainder);
+        remainder *= slideLength > 0.0f ? std::max(0.0f, slideHit.t - skin / slideLength) : 0.0f;
+    }
+    return moved + remainder;
+}
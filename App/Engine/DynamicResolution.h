@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// Resolution scale controller: keeps the GPU frame time under a target by changing how
+// many pixels the world is rendered at (the caller renders into an offscreen target at
+// scale x the window size and stretches it onto the window).
+//
+// Fill-bound frame time grows with the pixel count, the square of the scale, so the scale
+// that would just fit the budget is scale * sqrt(budget / measured). The controller aims
+// a little under the target, moves down faster than up (a missed frame is worse than a
+// soft one), ignores changes too small to matter, and after a change skips the samples
+// still in flight from before it: GPU timings arrive a couple of frames late, and reacting
+// to them again would overshoot.
+
+const float DYNRES_MIN_SCALE = 0.5f;
+const float DYNRES_MAX_SCALE = 1.0f;
+const float DYNRES_HEADROOM = 0.9f;            // aim for this fraction of the target
+const float DYNRES_MAX_DOWN = 0.15f;           // largest change per adjustment
+const float DYNRES_MAX_UP = 0.05f;
+const float DYNRES_MIN_CHANGE = 0.02f;
+const float DYNRES_SMOOTHING = 0.25f;          // weight of a new sample in the average
+const int DYNRES_SETTLE_SAMPLES = 3;           // samples ignored after a change
+
+struct DynamicResolution {
+    bool enabled = true;
+    double targetMs = 1000.0 / 60.0;
+    float scale = DYNRES_MAX_SCALE;
+    double smoothedMs = 0.0;                   // 0 until the first sample after a change
+    int settle = 0;
+
+    // A newly measured GPU frame time
+    void update(double gpuMs)
+    {
+        if (!enabled || gpuMs <= 0.0) return;
+        if (settle > 0) {
+            --settle;
+            return;
+        }
+        smoothedMs = smoothedMs > 0.0 ? smoothedMs + (gpuMs - smoothedMs) * DYNRES_SMOOTHING : gpuMs;
+
+        float ideal = scale * static_cast<float>(std::sqrt(targetMs * DYNRES_HEADROOM / smoothedMs));
+        float next = std::max(scale - DYNRES_MAX_DOWN, std::min(scale + DYNRES_MAX_UP, ideal));
+        next = std::max(DYNRES_MIN_SCALE, std::min(DYNRES_MAX_SCALE, next));
+        if (std::fabs(next - scale) < DYNRES_MIN_CHANGE && next != DYNRES_MIN_SCALE && next != DYNRES_MAX_SCALE) return;
+        if (next == scale) return;
+        scale = next;
+        smoothedMs = 0.0;
+        settle = DYNRES_SETTLE_SAMPLES;
+    }
+
+    void reset()
+    {
+        scale = DYNRES_MAX_SCALE;
+        smoothedMs = 0.0;
+        settle = 0;
+    }
+
+    // Render size for a window of the given size
+    int scaledSize(int windowSize) const { return std::max(1, static_cast<int>(windowSize * scale + 0.5f)); }
+};
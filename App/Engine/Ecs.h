@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "JobSystem.h"
+#include "ResourceRegistry.h"
+
+// Archetype entity-component system.
+//
+// Every distinct set of component types is an archetype. An archetype stores its
+// entities in fixed-size chunks, and inside a chunk each component type is one tightly
+// packed array (SoA), so a system touching two components streams through two arrays and
+// nothing else. Queries name the components they need and visit every chunk of every
+// archetype that has them; chunks are independent, so a system can hand one chunk to
+// each job.
+//
+// Components must be trivially copyable (rows are moved with memcpy when an entity is
+// destroyed). Creating and destroying entities is single-threaded and must not overlap a
+// query; writing component values from jobs, one chunk per job, is fine.
+
+const int ECS_CHUNK_BYTES     = 16 * 1024;
+const int ECS_MAX_COMPONENTS  = 64;          // bits in an archetype mask
+const int ECS_COLUMN_ALIGN    = 16;
+
+struct Entity {
+    uint32_t index = 0;
+    uint32_t generation = 0;                 // 0 is never a live entity
+
+    bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+// ---------- Component type ids ----------
+struct EcsComponentInfo {
+    size_t size;
+    size_t align;
+};
+
+inline EcsComponentInfo* ecsComponentInfo()
+{
+    static EcsComponentInfo info[ECS_MAX_COMPONENTS];
+    return info;
+}
+
+inline int ecsRegisterComponent(size_t size, size_t align)
+{
+    static std::atomic<int> next{ 0 };
+    int id = next.fetch_add(1);
+    assert(id < ECS_MAX_COMPONENTS && "too many ECS component types");
+    ecsComponentInfo()[id] = { size, align };
+    return id;
+}
+
+template <class T>
+int ecsComponentId()
+{
+    static_assert(std::is_trivially_copyable<T>::value, "ECS components must be trivially copyable");
+    static const int id = ecsRegisterComponent(sizeof(T), alignof(T));
+    return id;
+}
+
+template <class... Cs>
+uint64_t ecsMask()
+{
+    uint64_t mask = 0;
+    int ids[] = { 0, ecsComponentId<Cs>()... };
+    for (size_t i = 1; i < sizeof(ids) / sizeof(ids[0]); ++i) mask |= uint64_t(1) << ids[i];
+    return mask;
+}
+
+// ---------- Storage ----------
+struct EcsArchetype;
+
+struct alignas(64) EcsChunkBytes {
+    uint8_t bytes[ECS_CHUNK_BYTES];
+};
+
+struct EcsChunk {
+    EcsArchetype* archetype = nullptr;
+    std::unique_ptr<EcsChunkBytes> storage{ new EcsChunkBytes };
+    int count = 0;
+
+    Entity* entities() { return reinterpret_cast<Entity*>(storage->bytes); }
+
+    template <class T>
+    T* array();
+};
+
+struct EcsArchetype {
+    uint64_t mask = 0;
+    int capacity = 0;                          // rows per chunk
+    int offset[ECS_MAX_COMPONENTS];            // column start in a chunk, -1 if absent
+    std::vector<int> components;               // ids in the mask
+    std::vector<std::unique_ptr<EcsChunk>> chunks;
+
+    explicit EcsArchetype(uint64_t componentMask) : mask(componentMask)
+    {
+        size_t rowBytes = sizeof(Entity);
+        for (int id = 0; id < ECS_MAX_COMPONENTS; ++id) {
+            offset[id] = -1;
+            if (mask & (uint64_t(1) << id)) {
+                components.push_back(id);
+                rowBytes += ecsComponentInfo()[id].size;
+            }
+        }
+        // Leave room for aligning every column
+        size_t usable = ECS_CHUNK_BYTES - ECS_COLUMN_ALIGN * (components.size() + 1);
+        capacity = static_cast<int>(usable / rowBytes);
+        assert(capacity > 0 && "ECS row does not fit in a chunk");
+
+        size_t at = sizeof(Entity) * capacity;
+        for (int id : components) {
+            size_t align = std::max<size_t>(ECS_COLUMN_ALIGN, ecsComponentInfo()[id].align);
+            at = (at + align - 1) / align * align;
+            offset[id] = static_cast<int>(at);
+            at += ecsComponentInfo()[id].size * capacity;
+        }
+    }
+
+    bool has(int id) const { return offset[id] >= 0; }
+
+    uint8_t* element(EcsChunk& chunk, int id, int row) const
+    {
+        return chunk.storage->bytes + offset[id] + ecsComponentInfo()[id].size * row;
+    }
+};
+
+template <class T>
+T* EcsChunk::array()
+{
+    int id = ecsComponentId<T>();
+    assert(archetype->has(id));
+    return reinterpret_cast<T*>(storage->bytes + archetype->offset[id]);
+}
+
+// ---------- World ----------
+class EcsWorld {
+public:
+    // New entity with exactly the given components
+    template <class... Cs>
+    Entity create(const Cs&... values)
+    {
+        EcsArchetype& archetype = archetypeFor(ecsMask<Cs...>());
+        Entity entity = allocateEntity();
+        EntityRecord& record = records[entity.index];
+        record.archetype = &archetype;
+        allocateRow(archetype, entity, record.chunk, record.row);
+
+        EcsChunk& chunk = *archetype.chunks[record.chunk];
+        int ignore[] = { 0, (std::memcpy(archetype.element(chunk, ecsComponentId<Cs>(), record.row), &values, sizeof(Cs)), 0)... };
+        (void)ignore;
+        return entity;
+    }
+
+    // Remove an entity; the last row of its archetype moves into the hole
+    void destroy(Entity entity)
+    {
+        if (!alive(entity)) return;
+        EntityRecord& record = records[entity.index];
+        EcsArchetype& archetype = *record.archetype;
+        EcsChunk& chunk = *archetype.chunks[record.chunk];
+        EcsChunk& last = *archetype.chunks.back();
+        int lastRow = last.count - 1;
+
+        if (&last != &chunk || lastRow != record.row) {
+            Entity moved = last.entities()[lastRow];
+            for (int id : archetype.components)
+                std::memcpy(archetype.element(chunk, id, record.row), archetype.element(last, id, lastRow),
+                            ecsComponentInfo()[id].size);
+            chunk.entities()[record.row] = moved;
+            records[moved.index].chunk = record.chunk;
+            records[moved.index].row = record.row;
+        }
+        if (--last.count == 0) archetype.chunks.pop_back();
+
+        record.archetype = nullptr;
+        ++record.generation;
+        freeIndices.push_back(entity.index);
+        --liveCount;
+    }
+
+    bool alive(Entity entity) const
+    {
+        return entity.index < records.size() && records[entity.index].generation == entity.generation &&
+               records[entity.index].archetype != nullptr;
+    }
+
+    template <class T>
+    bool has(Entity entity) const
+    {
+        return alive(entity) && records[entity.index].archetype->has(ecsComponentId<T>());
+    }
+
+    template <class T>
+    T& get(Entity entity)
+    {
+        assert(has<T>(entity));
+        const EntityRecord& record = records[entity.index];
+        EcsChunk& chunk = *record.archetype->chunks[record.chunk];
+        return chunk.array<T>()[record.row];
+    }
+
+    int size() const { return liveCount; }
+
+    // Every non-empty chunk whose archetype has all of Cs (possibly more)
+    template <class... Cs>
+    void query(std::vector<EcsChunk*>& out)
+    {
+        uint64_t mask = ecsMask<Cs...>();
+        out.clear();
+        for (const std::unique_ptr<EcsArchetype>& archetype : archetypes)
+            if ((archetype->mask & mask) == mask)
+                for (const std::unique_ptr<EcsChunk>& chunk : archetype->chunks)
+                    out.push_back(chunk.get());
+    }
+
+    // fn(Entity, Cs&...) for every matching entity, chunk by chunk
+    template <class... Cs, class Fn>
+    void each(Fn fn)
+    {
+        std::vector<EcsChunk*> chunks;
+        query<Cs...>(chunks);
+        for (EcsChunk* chunk : chunks) eachInChunk<Cs...>(*chunk, fn);
+    }
+
+    // Same, with the chunks spread over the job system (fn must be safe to call concurrently)
+    template <class... Cs, class Fn>
+    void parallelEach(Fn fn)
+    {
+        std::vector<EcsChunk*> chunks;
+        query<Cs...>(chunks);
+        parallelFor(static_cast<int>(chunks.size()), 1, [&](int begin, int end) {
+            for (int c = begin; c < end; ++c) eachInChunk<Cs...>(*chunks[c], fn);
+        });
+    }
+
+    template <class... Cs, class Fn>
+    static void eachInChunk(EcsChunk& chunk, Fn&& fn)
+    {
+        Entity* entities = chunk.entities();
+        std::tuple<Cs*...> arrays(chunk.array<Cs>()...);
+        for (int row = 0; row < chunk.count; ++row) fn(entities[row], std::get<Cs*>(arrays)[row]...);
+    }
+
+    // Chunks plus the entity and archetype tables
+    size_t memoryBytes() const
+    {
+        size_t bytes = vectorBytes(archetypes) + vectorBytes(records) + vectorBytes(freeIndices) +
+                       archetypeByMask.size() * (sizeof(uint64_t) + sizeof(EcsArchetype*));
+        for (const std::unique_ptr<EcsArchetype>& archetype : archetypes)
+            bytes += sizeof(EcsArchetype) + vectorBytes(archetype->components) + vectorBytes(archetype->chunks) +
+                     archetype->chunks.size() * (sizeof(EcsChunk) + sizeof(EcsChunkBytes));
+        return bytes;
+    }
+
+private:
+    struct EntityRecord {
+        EcsArchetype* archetype = nullptr;
+        int chunk = 0;
+        int row = 0;
+        uint32_t generation = 1;
+    };
+
+    std::vector<std::unique_ptr<EcsArchetype>> archetypes;        // creation order, for stable iteration
+    std::unordered_map<uint64_t, EcsArchetype*> archetypeByMask;
+    std::vector<EntityRecord> records;
+    std::vector<uint32_t> freeIndices;
+    int liveCount = 0;
+
+    EcsArchetype& archetypeFor(uint64_t mask)
+    {
+        auto found = archetypeByMask.find(mask);
+        if (found != archetypeByMask.end()) return *found->second;
+        archetypes.emplace_back(new EcsArchetype(mask));
+        archetypeByMask[mask] = archetypes.back().get();
+        return *archetypes.back();
+    }
+
+    Entity allocateEntity()
+    {
+        Entity entity;
+        if (!freeIndices.empty()) {
+            entity.index = freeIndices.back();
+            freeIndices.pop_back();
+        } else {
+            entity.index = static_cast<uint32_t>(records.size());
+            records.emplace_back();
+        }
+        entity.generation = records[entity.index].generation;
+        ++liveCount;
+        return entity;
+    }
+
+    void allocateRow(EcsArchetype& archetype, Entity entity, int& chunkIndex, int& row)
+    {
+        if (archetype.chunks.empty() || archetype.chunks.back()->count == archetype.capacity) {
+            archetype.chunks.emplace_back(new EcsChunk);
+            archetype.chunks.back()->archetype = &archetype;
+        }
+        chunkIndex = static_cast<int>(archetype.chunks.size()) - 1;
+        EcsChunk& chunk = *archetype.chunks.back();
+        row = chunk.count++;
+        chunk.entities()[row] = entity;
+    }
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+// Fixed-step simulation clock.
+//
+// The main loop hands in the wall clock once per frame; beginFrame() says how many
+// fixed steps to run and alpha() is how far the renderer sits between the last two
+// simulation states. The simulation never sees the real frame time, so it behaves
+// the same at 30, 60 or 500 FPS.
+struct FixedTimestep {
+    double stepSeconds;
+    double maxFrameSeconds;    // long frames (window drag, breakpoint) are clamped so we don't spiral
+    double accumulator = 0.0;
+    double lastTime = -1.0;
+    unsigned long long stepCount = 0;
+
+    explicit FixedTimestep(double hz = 120.0, double maxFrame = 0.25)
+        : stepSeconds(1.0 / hz), maxFrameSeconds(maxFrame) {}
+
+    // Returns the number of simulation steps to run this frame
+    int beginFrame(double now) {
+        if (lastTime < 0.0) {
+            lastTime = now;
+            return 0;
+        }
+        double frameSeconds = now - lastTime;
+        lastTime = now;
+        if (frameSeconds > maxFrameSeconds) frameSeconds = maxFrameSeconds;
+        if (frameSeconds < 0.0) frameSeconds = 0.0;
+        accumulator += frameSeconds;
+
+        int steps = 0;
+        while (accumulator >= stepSeconds) {
+            accumulator -= stepSeconds;
+            ++steps;
+        }
+        stepCount += steps;
+        return steps;
+    }
+
+    // Offline rendering: frame number `frame` of a sequence that advances exactly
+    // frameSeconds per frame, whatever the wall clock says. Steps are counted from the
+    // frame number rather than accumulated, so rounding never adds or drops a step over
+    // a long capture. Use instead of beginFrame(), from frame 0.
+    int beginFixedFrame(long long frame, double frameSeconds) {
+        double owed = frame * frameSeconds / stepSeconds;                 // steps since frame 0
+        unsigned long long whole = static_cast<unsigned long long>(owed + 1e-6);
+        int steps = whole > stepCount ? static_cast<int>(whole - stepCount) : 0;
+        stepCount += steps;
+        accumulator = owed > static_cast<double>(whole) ? (owed - whole) * stepSeconds : 0.0;
+        return steps;
+    }
+
+    // Blend factor between previous (0) and current (1) simulation state
+    float alpha() const { return static_cast<float>(accumulator / stepSeconds); }
+
+    float stepDelta() const { return static_cast<float>(stepSeconds); }
+};
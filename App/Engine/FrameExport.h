@@ -0,0 +1,371 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+// Frame sequence export: a pool of encoder threads that turn captured RGBA frames into
+// PNG files (one per frame, in a directory) or one raw YUV4MPEG2 stream (.y4m).
+//
+//     FrameEncoderPool encoders;
+//     encoders.open("capture.y4m", 60, 4);
+//     ExportFrame* frame = encoders.acquire(width, height);   // blocks while every buffer is in flight
+//     ... copy pixels into frame->rgba ...
+//     encoders.submit(frame);
+//     encoders.close();                                        // waits for the rest
+//
+// Frames are RGBA8, rows bottom to top as glReadPixels returns them; flipping, colour
+// conversion and compression happen on the encoder threads, so the render thread only
+// copies. PNG frames are independent files and are written in any order. A Y4M stream
+// has one writer: threads convert frames in parallel and then append them in frame order.
+// The pool holds a bounded number of buffers (a few per thread), so a render loop that
+// outruns the disk waits in acquire() instead of growing memory.
+//
+// PNG pixel data is stored without deflate compression (stored blocks), which keeps the
+// encoder small and fast at the cost of file size.
+
+enum FrameExportFormat {
+    FRAME_EXPORT_PNG,
+    FRAME_EXPORT_Y4M
+};
+
+const int EXPORT_BUFFERS_PER_THREAD = 2;
+
+struct ExportFrame {
+    int index = 0;                      // position in the sequence
+    int width = 0, height = 0;
+    std::vector<uint8_t> rgba;          // width * height * 4, bottom row first
+};
+
+// ---------- PNG ----------
+inline uint32_t pngCrc(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline void pngPut32(std::vector<uint8_t>& out, uint32_t value)
+{
+    uint8_t bytes[4] = { uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value) };
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+inline void pngChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+{
+    pngPut32(out, static_cast<uint32_t>(size));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    pngPut32(out, pngCrc(out.data() + start, out.size() - start));
+}
+
+// RGB PNG of a bottom-up RGBA frame, into out (reused between frames)
+inline void encodePng(const ExportFrame& frame, std::vector<uint8_t>& out, std::vector<uint8_t>& scanlines)
+{
+    const int w = frame.width, h = frame.height;
+    const size_t rowBytes = size_t(w) * 3 + 1;          // filter byte + RGB
+    scanlines.resize(rowBytes * h);
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* src = frame.rgba.data() + size_t(h - 1 - y) * w * 4;
+        uint8_t* dst = scanlines.data() + rowBytes * y;
+        *dst++ = 0;                                      // filter: none
+        for (int x = 0; x < w; ++x, src += 4, dst += 3) {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+    }
+
+    // zlib stream of stored deflate blocks, at most 65535 bytes each
+    std::vector<uint8_t> zlib;
+    size_t blocks = (scanlines.size() + 65534) / 65535;
+    zlib.reserve(scanlines.size() + blocks * 5 + 6);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    uint32_t a = 1, b = 0;                              // Adler-32, reduced every 5552 bytes so b cannot overflow
+    int run = 0;
+    for (size_t offset = 0; offset < scanlines.size(); offset += 65535) {
+        size_t size = std::min<size_t>(65535, scanlines.size() - offset);
+        bool last = offset + size == scanlines.size();
+        uint8_t header[5] = { uint8_t(last ? 1 : 0), uint8_t(size), uint8_t(size >> 8), uint8_t(~size), uint8_t(~size >> 8) };
+        zlib.insert(zlib.end(), header, header + 5);
+        const uint8_t* block = scanlines.data() + offset;
+        zlib.insert(zlib.end(), block, block + size);
+        for (size_t i = 0; i < size; ++i) {
+            a += block[i];
+            b += a;
+            if (++run == 5552) {
+                a %= 65521;
+                b %= 65521;
+                run = 0;
+            }
+        }
+    }
+    a %= 65521;
+    b %= 65521;
+    pngPut32(zlib, (b << 16) | a);
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.assign(signature, signature + 8);
+    std::vector<uint8_t> ihdr;
+    pngPut32(ihdr, w);
+    pngPut32(ihdr, h);
+    const uint8_t format[5] = { 8, 2, 0, 0, 0 };        // 8-bit RGB, deflate, no filter, no interlace
+    ihdr.insert(ihdr.end(), format, format + 5);
+    pngChunk(out, "IHDR", ihdr.data(), ihdr.size());
+    pngChunk(out, "IDAT", zlib.data(), zlib.size());
+    pngChunk(out, "IEND", nullptr, 0);
+}
+
+// ---------- Y4M ----------
+// BT.601 studio-range 4:2:0 (the Y4M default) of a bottom-up RGBA frame; width and height even
+inline void convertToI420(const ExportFrame& frame, std::vector<uint8_t>& planes)
+{
+    const int w = frame.width, h = frame.height;
+    planes.resize(size_t(w) * h * 3 / 2);
+    uint8_t* yPlane = planes.data();
+    uint8_t* uPlane = yPlane + size_t(w) * h;
+    uint8_t* vPlane = uPlane + size_t(w / 2) * (h / 2);
+    for (int y = 0; y < h; y += 2) {
+        const uint8_t* row0 = frame.rgba.data() + size_t(h - 1 - y) * w * 4;
+        const uint8_t* row1 = row0 - size_t(w) * 4;
+        for (int x = 0; x < w; x += 2) {
+            int r = 0, g = 0, b = 0;
+            for (int k = 0; k < 4; ++k) {
+                const uint8_t* p = (k < 2 ? row0 : row1) + (x + (k & 1)) * 4;
+                yPlane[size_t(y + k / 2) * w + x + (k & 1)] = uint8_t(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+                r += p[0];
+                g += p[1];
+                b += p[2];
+            }
+            r = (r + 2) >> 2;
+            g = (g + 2) >> 2;
+            b = (b + 2) >> 2;
+            size_t c = size_t(y / 2) * (w / 2) + x / 2;
+            uPlane[c] = uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            vPlane[c] = uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+}
+
+// ---------- Encoder pool ----------
+class FrameEncoderPool {
+public:
+    FrameEncoderPool() {}
+    ~FrameEncoderPool() { close(); }
+    FrameEncoderPool(const FrameEncoderPool&) = delete;
+    FrameEncoderPool& operator=(const FrameEncoderPool&) = delete;
+
+    // A path ending in .y4m is one video stream, anything else a directory of PNGs.
+    // False (with a message) if the output cannot be created.
+    bool open(const std::string& path, int framesPerSecond, int threads)
+    {
+        close();
+        outputPath = path;
+        fps = std::max(1, framesPerSecond);
+        format = path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0 ? FRAME_EXPORT_Y4M : FRAME_EXPORT_PNG;
+        if (format == FRAME_EXPORT_Y4M) {
+            stream = fopen(path.c_str(), "wb");
+            if (!stream) {
+                std::cerr << "Failed to create " << path << std::endl;
+                return false;
+            }
+        } else if (!makeDirectory(path)) {
+            std::cerr << "Failed to create directory " << path << std::endl;
+            return false;
+        }
+        quit = false;
+        failed = false;
+        nextToWrite = 0;
+        streamWidth = streamHeight = 0;
+        framesWritten = 0;
+        bytesWritten = 0;
+        threads = std::max(1, threads);
+        bufferLimit = threads * EXPORT_BUFFERS_PER_THREAD + 1;
+        for (int i = 0; i < threads; ++i) workers.emplace_back([this] { encodeLoop(); });
+        return true;
+    }
+
+    bool isOpen() const { return !workers.empty(); }
+    FrameExportFormat outputFormat() const { return format; }
+    int threadCount() const { return static_cast<int>(workers.size()); }
+
+    // A buffer for the next frame; waits while all of them are queued or being encoded
+    ExportFrame* acquire(int width, int height)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        spaceFreed.wait(lock, [this] { return !freeFrames.empty() || allocatedFrames < bufferLimit; });
+        ExportFrame* frame;
+        if (!freeFrames.empty()) {
+            frame = freeFrames.back();
+            freeFrames.pop_back();
+        } else {
+            frames.emplace_back(new ExportFrame);
+            frame = frames.back().get();
+            ++allocatedFrames;
+        }
+        frame->index = submitted;
+        frame->width = width;
+        frame->height = height;
+        frame->rgba.resize(size_t(width) * height * 4);
+        return frame;
+    }
+
+    // Hand a filled buffer to the encoders; frames must be submitted in acquire() order
+    void submit(ExportFrame* frame)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(frame);
+            ++submitted;
+        }
+        work.notify_one();
+    }
+
+    // Encode everything submitted, stop the threads and close the output
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        work.notify_all();
+        for (std::thread& t : workers) t.join();
+        workers.clear();
+        if (stream) fclose(stream);
+        stream = nullptr;
+        frames.clear();
+        freeFrames.clear();
+        allocatedFrames = 0;
+        submitted = 0;
+    }
+
+    int written() const { return framesWritten; }
+    uint64_t writtenBytes() const { return bytesWritten; }
+    bool hadErrors() const { return failed; }
+
+private:
+    std::string outputPath;
+    FrameExportFormat format = FRAME_EXPORT_PNG;
+    int fps = 60;
+    FILE* stream = nullptr;                            // Y4M only
+
+    std::mutex mutex;
+    std::condition_variable work;                      // queue gained a frame, or quit
+    std::condition_variable spaceFreed;                // a buffer went back to freeFrames
+    std::condition_variable streamTurn;                // nextToWrite advanced
+    std::deque<ExportFrame*> queue;
+    std::vector<std::unique_ptr<ExportFrame>> frames;
+    std::vector<ExportFrame*> freeFrames;
+    std::vector<std::thread> workers;
+    int allocatedFrames = 0;
+    int bufferLimit = 0;
+    int submitted = 0;
+    int nextToWrite = 0;                               // Y4M: frames are appended in order
+    int streamWidth = 0, streamHeight = 0;
+    int framesWritten = 0;
+    uint64_t bytesWritten = 0;
+    bool quit = false;
+    bool failed = false;
+
+    static bool makeDirectory(const std::string& path)
+    {
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0) return (info.st_mode & S_IFDIR) != 0;
+#ifdef _WIN32
+        return _mkdir(path.c_str()) == 0;
+#else
+        return mkdir(path.c_str(), 0755) == 0;
+#endif
+    }
+
+    void encodeLoop()
+    {
+        std::vector<uint8_t> encoded, scratch;
+        for (;;) {
+            ExportFrame* frame;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work.wait(lock, [this] { return quit || !queue.empty(); });
+                if (queue.empty()) return;
+                frame = queue.front();
+                queue.pop_front();
+            }
+
+            if (format == FRAME_EXPORT_PNG) {
+                encodePng(*frame, encoded, scratch);
+                char name[32];
+                snprintf(name, sizeof(name), "/frame_%06d.png", frame->index);
+                std::string path = outputPath + name;
+                FILE* file = fopen(path.c_str(), "wb");
+                bool ok = file && fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size();
+                if (file && fclose(file) != 0) ok = false;
+                finish(frame, ok, ok ? encoded.size() : 0, path);
+            } else {
+                bool evenSize = frame->width % 2 == 0 && frame->height % 2 == 0;
+                if (evenSize) convertToI420(*frame, encoded);
+                std::unique_lock<std::mutex> lock(mutex);
+                streamTurn.wait(lock, [this, frame] { return nextToWrite == frame->index; });
+                size_t bytes = 0;
+                bool ok = evenSize && appendToStream(*frame, encoded, bytes);
+                ++nextToWrite;
+                streamTurn.notify_all();
+                lock.unlock();
+                finish(frame, ok, bytes, outputPath);
+            }
+        }
+    }
+
+    // Called with the lock held, in frame order
+    bool appendToStream(const ExportFrame& frame, const std::vector<uint8_t>& planes, size_t& bytes)
+    {
+        if (streamWidth == 0) {
+            streamWidth = frame.width;
+            streamHeight = frame.height;
+            int header = fprintf(stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", streamWidth, streamHeight, fps);
+            if (header < 0) return false;
+            bytes += header;
+        }
+        if (frame.width != streamWidth || frame.height != streamHeight) return false;
+        if (fputs("FRAME\n", stream) < 0) return false;
+        size_t wrote = fwrite(planes.data(), 1, planes.size(), stream);
+        bytes += 6 + wrote;
+        return wrote == planes.size();
+    }
+
+    void finish(ExportFrame* frame, bool ok, size_t bytes, const std::string& path)
+    {
+        if (!ok) std::cerr << "Failed to write frame " << frame->index << " to " << path << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ok) ++framesWritten;
+            else failed = true;
+            bytesWritten += bytes;
+            freeFrames.push_back(frame);
+        }
+        spaceFreed.notify_one();
+    }
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+// Frame pacing: decides the swap interval and holds frames back to a target rate.
+//
+//   uncapped   no swap interval, no limiter (benchmarks, export)
+//   vsync      swap interval 1. If the swaps come back far faster than the display
+//              refreshes (no vsync on this machine, or the driver overrides it), the
+//              refresh rate is enforced by the limiter instead.
+//   cap        no swap interval, limited to a fixed rate
+//   adaptive   limited to refresh / n, where n is the smallest divisor the frame's work
+//              fits into, so a frame that cannot make 60 runs at a steady 30 rather than
+//              alternating. Late swaps tear (swap interval -1) where the driver allows it.
+//
+// The limiter waits at the top of the frame, before input is polled, so waiting never
+// adds to input latency. It sleeps until a margin before the deadline and spins the rest:
+// sleep wakes late by anything from tens of microseconds to a scheduler tick, spinning is
+// exact. The margin follows the worst oversleep seen recently. Deadlines advance by whole
+// periods, so the average rate is exact, and a frame that overruns resets the schedule
+// instead of making the next frames hurry to catch up.
+
+enum PacingMode { PACING_UNCAPPED, PACING_VSYNC, PACING_CAP, PACING_ADAPTIVE };
+
+const char* const PACING_MODE_NAMES[] = { "uncapped", "vsync", "cap", "adaptive" };
+const int PACING_MODE_COUNT = 4;
+
+const double PACING_SPIN_MIN_MS = 0.2;          // spin margin bounds
+const double PACING_SPIN_MAX_MS = 2.0;
+const double PACING_SPIN_DECAY = 0.98;          // per frame, towards PACING_SPIN_MIN_MS
+const double PACING_VSYNC_FAST = 0.7;           // intervals under this fraction of a refresh mean no vsync
+const int PACING_VSYNC_CHECK_FRAMES = 60;
+const int PACING_ADAPTIVE_MAX_DIVISOR = 4;
+const double PACING_ADAPTIVE_HEADROOM = 0.9;    // work must fit this fraction of a period
+const double PACING_ADAPTIVE_SMOOTHING = 0.1;
+const double PACING_LATE = 1.5;                 // intervals over this many periods count as late
+
+inline bool parsePacingMode(const char* name, PacingMode& mode)
+{
+    for (int i = 0; i < PACING_MODE_COUNT; ++i)
+        if (strcmp(name, PACING_MODE_NAMES[i]) == 0) {
+            mode = static_cast<PacingMode>(i);
+            return true;
+        }
+    std::cerr << "Unknown pacing mode " << name << " (uncapped, vsync, cap, adaptive)" << std::endl;
+    return false;
+}
+
+// Present intervals since the last resetStats()
+struct PacingStats {
+    int frames = 0;
+    double averageMs = 0.0;
+    double jitterMs = 0.0;                      // standard deviation of the interval
+    double worstMs = 0.0;
+    int late = 0;
+    double sleepMs = 0.0;                       // per frame
+    double spinMs = 0.0;
+};
+
+class FramePacer {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    void configure(PacingMode pacingMode, double capFps, double refreshHz)
+    {
+        mode = pacingMode;
+        refreshMs = 1000.0 / std::max(1.0, refreshHz);
+        capMs = 1000.0 / std::max(1.0, capFps);
+        vsyncMissing = false;
+        divisor = 1;
+        smoothedWorkMs = 0.0;
+        checkFrames = 0;
+        checkMs = 0.0;
+        hasDeadline = false;
+    }
+
+    PacingMode pacingMode() const { return mode; }
+
+    // Value for glfwSwapInterval; tearSupported says whether -1 (adaptive vsync) is allowed
+    int swapInterval(bool tearSupported) const
+    {
+        if (mode == PACING_VSYNC) return 1;
+        if (mode == PACING_ADAPTIVE) return tearSupported ? -1 : 0;
+        return 0;
+    }
+
+    // Time the limiter holds each frame to, 0 when it is off
+    double periodMs() const
+    {
+        switch (mode) {
+        case PACING_CAP: return capMs;
+        case PACING_ADAPTIVE: return refreshMs * divisor;
+        case PACING_VSYNC: return vsyncMissing ? refreshMs : 0.0;
+        default: return 0.0;
+        }
+    }
+
+    // Block until the next frame is due; call at the top of the frame
+    void wait()
+    {
+        Clock::time_point now = Clock::now();
+        double period = periodMs();
+        if (period <= 0.0) {
+            hasDeadline = false;
+            workStart = now;
+            return;
+        }
+        Clock::time_point deadline = hasDeadline ? lastDeadline + toDuration(period) : now;
+        if (deadline < now) deadline = now;     // overran: start a new schedule from here
+
+        if (deadline - now > toDuration(spinMarginMs)) {
+            Clock::time_point wake = deadline - toDuration(spinMarginMs);
+            std::this_thread::sleep_until(wake);
+            Clock::time_point woke = Clock::now();
+            double oversleepMs = toMs(woke - wake);
+            spinMarginMs = std::min(PACING_SPIN_MAX_MS, std::max(spinMarginMs, oversleepMs * 1.25 + PACING_SPIN_MIN_MS));
+            sleepTotalMs += toMs(woke - now);
+            now = woke;
+        }
+        Clock::time_point spinStart = now;
+        while (now < deadline) {
+            std::this_thread::yield();
+            now = Clock::now();
+        }
+        spinTotalMs += toMs(now - spinStart);
+        spinMarginMs = std::max(PACING_SPIN_MIN_MS, spinMarginMs * PACING_SPIN_DECAY);
+
+        lastDeadline = deadline;
+        hasDeadline = true;
+        workStart = now;
+    }
+
+    // The frame is drawn and about to be swapped
+    void workDone()
+    {
+        double workMs = toMs(Clock::now() - workStart);
+        smoothedWorkMs = smoothedWorkMs > 0.0 ? smoothedWorkMs + (workMs - smoothedWorkMs) * PACING_ADAPTIVE_SMOOTHING : workMs;
+        if (mode != PACING_ADAPTIVE) return;
+        // Step up as soon as the work no longer fits; step down only with room to spare
+        while (divisor < PACING_ADAPTIVE_MAX_DIVISOR && smoothedWorkMs > refreshMs * divisor * PACING_ADAPTIVE_HEADROOM) ++divisor;
+        while (divisor > 1 && smoothedWorkMs < refreshMs * (divisor - 1) * PACING_ADAPTIVE_HEADROOM * 0.8) --divisor;
+    }
+
+    // The swap returned
+    void presented()
+    {
+        Clock::time_point now = Clock::now();
+        if (hasPresent) {
+            double intervalMs = toMs(now - lastPresent);
+            ++frames;
+            intervalTotal += intervalMs;
+            intervalSquares += intervalMs * intervalMs;
+            worstMs = std::max(worstMs, intervalMs);
+            double period = periodMs() > 0.0 ? periodMs() : (mode == PACING_VSYNC ? refreshMs : 0.0);
+            if (period > 0.0 && intervalMs > period * PACING_LATE) ++late;
+
+            if (mode == PACING_VSYNC && !vsyncMissing) {
+                checkMs += intervalMs;
+                if (++checkFrames == PACING_VSYNC_CHECK_FRAMES) {
+                    if (checkMs / checkFrames < refreshMs * PACING_VSYNC_FAST) {
+                        vsyncMissing = true;
+                        std::cout << "Vsync is not limiting the frame rate: capping at " << 1000.0 / refreshMs << " fps" << std::endl;
+                    }
+                    checkFrames = 0;
+                    checkMs = 0.0;
+                }
+            }
+        }
+        lastPresent = now;
+        hasPresent = true;
+    }
+
+    PacingStats stats() const
+    {
+        PacingStats s;
+        s.frames = frames;
+        if (frames == 0) return s;
+        s.averageMs = intervalTotal / frames;
+        s.jitterMs = std::sqrt(std::max(0.0, intervalSquares / frames - s.averageMs * s.averageMs));
+        s.worstMs = worstMs;
+        s.late = late;
+        s.sleepMs = sleepTotalMs / frames;
+        s.spinMs = spinTotalMs / frames;
+        return s;
+    }
+
+    void resetStats()
+    {
+        frames = late = 0;
+        intervalTotal = intervalSquares = worstMs = 0.0;
+        sleepTotalMs = spinTotalMs = 0.0;
+    }
+
+private:
+    PacingMode mode = PACING_VSYNC;
+    double refreshMs = 1000.0 / 60.0;
+    double capMs = 1000.0 / 60.0;
+    bool vsyncMissing = false;
+    int checkFrames = 0;
+    double checkMs = 0.0;
+    int divisor = 1;
+    double smoothedWorkMs = 0.0;
+    double spinMarginMs = 1.0;
+
+    Clock::time_point lastDeadline, workStart, lastPresent;
+    bool hasDeadline = false;
+    bool hasPresent = false;
+
+    int frames = 0, late = 0;
+    double intervalTotal = 0.0, intervalSquares = 0.0, worstMs = 0.0;
+    double sleepTotalMs = 0.0, spinTotalMs = 0.0;
+
+    static Clock::duration toDuration(double ms)
+    {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+    }
+    static double toMs(Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstring>
+#include "FrameExport.h"
+#include "ResourceRegistry.h"
+
+// Asynchronous framebuffer readback for frame export.
+//
+// glReadPixels into client memory stalls until the GPU has finished the frame. Reading
+// into a pixel pack buffer instead only queues the copy: capture() starts it and drops a
+// fence behind it, and collect() maps the buffer frames later, once the fence says the
+// copy is done, and hands the pixels to the encoders. With READBACK_BUFFERS buffers in the
+// ring the CPU waits only when it gets that many frames ahead of the GPU (counted in
+// stalls()). Main thread only; needs GL 3.2 for fences.
+
+const int READBACK_BUFFERS = 3;
+
+class FrameReadback {
+public:
+    void init()
+    {
+        for (Slot& slot : slots) {
+            glGenBuffers(1, &slot.buffer);
+            resources().trackGpu(GPU_BUFFER, slot.buffer, 0, "frame readback");
+        }
+    }
+
+    void destroy()
+    {
+        for (Slot& slot : slots) {
+            if (slot.fence) glDeleteSync(slot.fence);
+            resources().releaseGpu(GPU_BUFFER, slot.buffer);
+            glDeleteBuffers(1, &slot.buffer);
+            slot = Slot();
+        }
+        pending = 0;
+    }
+
+    // Queue a copy of the back buffer (call after the frame is drawn, before the swap)
+    void capture(FrameEncoderPool& encoders, int width, int height)
+    {
+        if (pending == READBACK_BUFFERS) collect(encoders, true);
+        Slot& slot = slots[next];
+        size_t bytes = size_t(width) * height * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if (slot.capacity < bytes) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+            resources().resizeGpu(GPU_BUFFER, slot.buffer, bytes);
+            slot.capacity = bytes;
+        }
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadBuffer(GL_BACK);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.width = width;
+        slot.height = height;
+        next = (next + 1) % READBACK_BUFFERS;
+        ++pending;
+    }
+
+    // Pass the oldest pending frame to the encoders. Without wait, only if its copy has
+    // already finished; false when nothing was collected.
+    bool collect(FrameEncoderPool& encoders, bool wait)
+    {
+        if (pending == 0) return false;
+        Slot& slot = slots[(next + READBACK_BUFFERS - pending) % READBACK_BUFFERS];
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            if (!wait) return false;
+            ++stallCount;
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        }
+        if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED)
+            std::cerr << "Frame readback did not finish" << std::endl;
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+        --pending;
+
+        size_t bytes = size_t(slot.width) * slot.height * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+        if (pixels) {
+            ExportFrame* frame = encoders.acquire(slot.width, slot.height);
+            std::memcpy(frame->rgba.data(), pixels, bytes);
+            encoders.submit(frame);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        } else {
+            std::cerr << "Failed to map frame readback buffer" << std::endl;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return pixels != nullptr;
+    }
+
+    // Everything still in flight, oldest first (end of the export)
+    void flush(FrameEncoderPool& encoders)
+    {
+        while (pending > 0) collect(encoders, true);
+    }
+
+    // Frames whose copy had not finished when its buffer was needed again
+    int stalls() const { return stallCount; }
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = 0;
+        int width = 0, height = 0;
+        size_t capacity = 0;
+    };
+
+    Slot slots[READBACK_BUFFERS];
+    int next = 0;                       // slot the next capture writes
+    int pending = 0;                    // captures not yet collected
+    int stallCount = 0;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cmath>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+
+// View frustum as six planes (xyz = inward normal, w = distance), extracted from a
+// projection * view matrix (Gribb/Hartmann). Tests are conservative: a box or sphere
+// that straddles a corner may be reported visible.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum() {}
+
+    explicit Frustum(const glm::mat4& viewProjection)
+    {
+        const glm::mat4& m = viewProjection;
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+        planes[0] = row3 + row0;   // left
+        planes[1] = row3 - row0;   // right
+        planes[2] = row3 + row1;   // bottom
+        planes[3] = row3 - row1;   // top
+        planes[4] = row3 + row2;   // near
+        planes[5] = row3 - row2;   // far
+        for (glm::vec4& p : planes) p /= glm::length(glm::vec3(p));
+    }
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const
+    {
+        for (const glm::vec4& p : planes)
+            if (glm::dot(glm::vec3(p), center) + p.w < -radius) return false;
+        return true;
+    }
+
+    bool intersects(const Aabb& box) const
+    {
+        glm::vec3 c = box.center(), e = box.extents();
+        for (const glm::vec4& p : planes) {
+            float r = e.x * fabsf(p.x) + e.y * fabsf(p.y) + e.z * fabsf(p.z);
+            if (glm::dot(glm::vec3(p), c) + p.w < -r) return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+// Thin layer over the GL calls a frame is made of: program, texture and vertex array
+// binds, uniforms and draws. Per-frame GL work goes through these; one-off setup code
+// calls GL directly.
+//
+// Every call is counted. A shadow copy of the bound state (and of each program's uniform
+// values) spots calls that set what is already set; those are counted as redundant and,
+// with elision on, not passed to GL at all. The shadow state is forgotten at
+// glsBeginFrame(), so setup code between frames may change GL state behind its back, but
+// inside a frame all binds and uniforms must go through the layer.
+//
+// Build with -DGLS_STATE_TRACKING=0 to make every wrapper a plain forwarding call.
+// GL is used from the main thread only, so none of this is synchronized.
+
+#ifndef GLS_STATE_TRACKING
+#define GLS_STATE_TRACKING 1
+#endif
+
+const int GLS_TEXTURE_UNITS = 16;
+const GLuint GLS_UNKNOWN = 0xFFFFFFFFu;
+
+struct GlFrameStats {
+    int drawCalls = 0;
+    uint64_t triangles = 0;
+    int programSwitches = 0;                 // glUseProgram calls
+    int textureBinds = 0;                    // glBindTexture and glActiveTexture calls
+    int vertexArrayBinds = 0;
+    int uniformUpdates = 0;
+    int redundantPrograms = 0;               // calls that changed nothing (elided when elision is on)
+    int redundantTextures = 0;
+    int redundantVertexArrays = 0;
+    int redundantUniforms = 0;
+
+    int redundant() const { return redundantPrograms + redundantTextures + redundantVertexArrays + redundantUniforms; }
+
+    GlFrameStats& operator+=(const GlFrameStats& other)
+    {
+        drawCalls += other.drawCalls;
+        triangles += other.triangles;
+        programSwitches += other.programSwitches;
+        textureBinds += other.textureBinds;
+        vertexArrayBinds += other.vertexArrayBinds;
+        uniformUpdates += other.uniformUpdates;
+        redundantPrograms += other.redundantPrograms;
+        redundantTextures += other.redundantTextures;
+        redundantVertexArrays += other.redundantVertexArrays;
+        redundantUniforms += other.redundantUniforms;
+        return *this;
+    }
+};
+
+struct GlShadowState {
+    struct UniformValue {
+        size_t bytes = 0;
+        float data[16];
+    };
+
+    bool elide = true;
+    GLuint program = GLS_UNKNOWN;
+    GLenum activeUnit = GLS_UNKNOWN;         // GL_TEXTURE0 + i
+    GLuint textures[GLS_TEXTURE_UNITS];      // GL_TEXTURE_2D binding per unit
+    GLuint vertexArray = GLS_UNKNOWN;
+    std::unordered_map<uint64_t, UniformValue> uniforms;   // (program << 32 | location)
+
+    void forget()
+    {
+        program = GLS_UNKNOWN;
+        activeUnit = GLS_UNKNOWN;
+        for (GLuint& texture : textures) texture = GLS_UNKNOWN;
+        vertexArray = GLS_UNKNOWN;
+        uniforms.clear();
+    }
+};
+
+inline GlFrameStats& glsFrameStats()
+{
+    static GlFrameStats stats;
+    return stats;
+}
+
+inline GlFrameStats& glsPreviousFrameStats()
+{
+    static GlFrameStats stats;
+    return stats;
+}
+
+inline GlShadowState& glsShadow()
+{
+    static GlShadowState state;
+    return state;
+}
+
+// Start counting a new frame (the finished one stays readable as glsPreviousFrameStats())
+// and forget the shadow state
+inline void glsBeginFrame()
+{
+#if GLS_STATE_TRACKING
+    glsPreviousFrameStats() = glsFrameStats();
+    glsFrameStats() = GlFrameStats();
+    glsShadow().forget();
+#endif
+}
+
+// Whether redundant calls are skipped; they are counted either way
+inline void glsSetElision(bool on) { glsShadow().elide = on; }
+inline bool glsElision() { return GLS_STATE_TRACKING && glsShadow().elide; }
+
+inline uint64_t glsTriangles(GLenum mode, GLsizei count)
+{
+    switch (mode) {
+    case GL_TRIANGLES:      return count / 3;
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:   return count > 2 ? count - 2 : 0;
+    default:                return 0;
+    }
+}
+
+// Count a redundant call; true when it should be skipped
+inline bool glsRedundant(int& counter)
+{
+    ++counter;
+    return glsShadow().elide;
+}
+
+// Compare a uniform value with the shadow copy for the current program and remember it
+inline bool glsUniformUnchanged(GLint location, const void* data, size_t bytes)
+{
+    GlShadowState& shadow = glsShadow();
+    if (location < 0 || shadow.program == GLS_UNKNOWN) return false;
+    GlShadowState::UniformValue& value = shadow.uniforms[(uint64_t(shadow.program) << 32) | uint32_t(location)];
+    if (value.bytes == bytes && std::memcmp(value.data, data, bytes) == 0) return true;
+    value.bytes = bytes;
+    std::memcpy(value.data, data, bytes);
+    return false;
+}
+
+// ---------- State ----------
+inline void glsUseProgram(GLuint program)
+{
+#if GLS_STATE_TRACKING
+    GlShadowState& shadow = glsShadow();
+    ++glsFrameStats().programSwitches;
+    if (shadow.program == program && glsRedundant(glsFrameStats().redundantPrograms)) return;
+    shadow.program = program;
+#endif
+    glUseProgram(program);
+}
+
+inline void glsActiveTexture(GLenum unit)
+{
+#if GLS_STATE_TRACKING
+    GlShadowState& shadow = glsShadow();
+    ++glsFrameStats().textureBinds;
+    if (shadow.activeUnit == unit && glsRedundant(glsFrameStats().redundantTextures)) return;
+    shadow.activeUnit = unit;
+#endif
+    glActiveTexture(unit);
+}
+
+inline void glsBindTexture(GLenum target, GLuint texture)
+{
+#if GLS_STATE_TRACKING
+    GlShadowState& shadow = glsShadow();
+    ++glsFrameStats().textureBinds;
+    int unit = static_cast<int>(shadow.activeUnit - GL_TEXTURE0);
+    bool tracked = target == GL_TEXTURE_2D && shadow.activeUnit != GLS_UNKNOWN && unit >= 0 && unit < GLS_TEXTURE_UNITS;
+    if (tracked && shadow.textures[unit] == texture && glsRedundant(glsFrameStats().redundantTextures)) return;
+    if (tracked) shadow.textures[unit] = texture;
+#endif
+    glBindTexture(target, texture);
+}
+
+inline void glsBindVertexArray(GLuint vertexArray)
+{
+#if GLS_STATE_TRACKING
+    GlShadowState& shadow = glsShadow();
+    ++glsFrameStats().vertexArrayBinds;
+    if (shadow.vertexArray == vertexArray && glsRedundant(glsFrameStats().redundantVertexArrays)) return;
+    shadow.vertexArray = vertexArray;
+#endif
+    glBindVertexArray(vertexArray);
+}
+
+// ---------- Uniforms (of the current program) ----------
+inline void glsUniform1i(GLint location, GLint value)
+{
+#if GLS_STATE_TRACKING
+    ++glsFrameStats().uniformUpdates;
+    if (glsUniformUnchanged(location, &value, sizeof(value)) && glsRedundant(glsFrameStats().redundantUniforms)) return;
+#endif
+    glUniform1i(location, value);
+}
+
+inline void glsUniform1f(GLint location, GLfloat value)
+{
+#if GLS_STATE_TRACKING
+    ++glsFrameStats().uniformUpdates;
+    if (glsUniformUnchanged(location, &value, sizeof(value)) && glsRedundant(glsFrameStats().redundantUniforms)) return;
+#endif
+    glUniform1f(location, value);
+}
+
+inline void glsUniform2f(GLint location, GLfloat x, GLfloat y)
+{
+#if GLS_STATE_TRACKING
+    const GLfloat value[2] = { x, y };
+    ++glsFrameStats().uniformUpdates;
+    if (glsUniformUnchanged(location, value, sizeof(value)) && glsRedundant(glsFrameStats().redundantUniforms)) return;
+#endif
+    glUniform2f(location, x, y);
+}
+
+inline void glsUniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z)
+{
+#if GLS_STATE_TRACKING
+    const GLfloat value[3] = { x, y, z };
+    ++glsFrameStats().uniformUpdates;
+    if (glsUniformUnchanged(location, value, sizeof(value)) && glsRedundant(glsFrameStats().redundantUniforms)) return;
+#endif
+    glUniform3f(location, x, y, z);
+}
+
+// One matrix (count 1)
+inline void glsUniformMatrix4fv(GLint location, GLboolean transpose, const GLfloat* value)
+{
+#if GLS_STATE_TRACKING
+    ++glsFrameStats().uniformUpdates;
+    if (!transpose && glsUniformUnchanged(location, value, 16 * sizeof(GLfloat)) &&
+        glsRedundant(glsFrameStats().redundantUniforms))
+        return;
+#endif
+    glUniformMatrix4fv(location, 1, transpose, value);
+}
+
+// ---------- Draws ----------
+inline void glsCountDraw(GLenum mode, GLsizei count, GLsizei instances)
+{
+#if GLS_STATE_TRACKING
+    GlFrameStats& stats = glsFrameStats();
+    ++stats.drawCalls;
+    stats.triangles += glsTriangles(mode, count) * instances;
+#endif
+}
+
+inline void glsDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    glsCountDraw(mode, count, 1);
+    glDrawArrays(mode, first, count);
+}
+
+inline void glsDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+{
+    glsCountDraw(mode, count, instances);
+    glDrawArraysInstanced(mode, first, count, instances);
+}
+
+inline void glsDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+    glsCountDraw(mode, count, 1);
+    glDrawElements(mode, count, type, indices);
+}
+
+inline void glsDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances)
+{
+    glsCountDraw(mode, count, instances);
+    glDrawElementsInstanced(mode, count, type, indices, instances);
+}
+
+// One call for drawCount index ranges, each with its own base vertex
+inline void glsMultiDrawElementsBaseVertex(GLenum mode, const GLsizei* counts, GLenum type, const void* const* indices,
+                                           GLsizei drawCount, const GLint* baseVertices)
+{
+    if (drawCount == 0) return;
+#if GLS_STATE_TRACKING
+    GlFrameStats& stats = glsFrameStats();
+    ++stats.drawCalls;
+    for (GLsizei i = 0; i < drawCount; ++i) stats.triangles += glsTriangles(mode, counts[i]);
+#endif
+    glMultiDrawElementsBaseVertex(mode, counts, type, indices, drawCount, baseVertices);
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+#include "Profiler.h"
+
+// GPU time per render pass, from timestamp queries that are never waited on.
+//
+// beginPass()/endPass() put a glQueryCounter(GL_TIMESTAMP) before and after a pass's
+// commands. The queries of a frame come from one of GPU_TIMER_FRAMES sets used in turn,
+// and a set is read back when its turn comes round again, GPU_TIMER_FRAMES - 1 frames
+// later. By then the GPU has normally finished it; if it has not, that frame's results
+// are dropped rather than stalling on glGetQueryObject.
+//
+// Finished passes go to the profiler's "GPU" track. beginFrame() samples the GL clock and
+// Profiler::now() together, which maps GPU timestamps onto profiler ticks, so the trace
+// shows each pass below the CPU zones that submitted it. Per-pass averages are kept for
+// the frame report, like the job system's stats.
+
+const int GPU_TIMER_FRAMES = 3;
+const int GPU_TIMER_MAX_PASSES = 32;
+
+struct GpuPassStats {
+    const char* name;
+    double ms;                         // stats(): average per frame that ran the pass
+};
+
+class GpuPassTimer {
+public:
+    // Needs a current GL context (timer queries are core in 3.3)
+    void init()
+    {
+        for (FrameQueries& frame : frames) glGenQueries(GPU_TIMER_MAX_PASSES * 2, frame.queries);
+        track = &profiler().addTrack("GPU");
+        initialized = true;
+    }
+
+    // Before the context goes away
+    void destroy()
+    {
+        if (!initialized) return;
+        for (FrameQueries& frame : frames) glDeleteQueries(GPU_TIMER_MAX_PASSES * 2, frame.queries);
+        initialized = false;
+    }
+
+    // Collect the oldest set if it is ready and start this frame's passes
+    void beginFrame()
+    {
+        if (!initialized) return;
+        FrameQueries& frame = frames[current];
+        if (frame.passCount > 0) collect(frame);
+        frame.passCount = 0;
+        passOpen = false;
+        glGetInteger64v(GL_TIMESTAMP, &frame.gpuSync);
+        frame.cpuSync = Profiler::now();
+    }
+
+    // Passes do not nest; name must stay valid until the trace is written
+    void beginPass(const char* name)
+    {
+        FrameQueries& frame = frames[current];
+        if (!initialized || passOpen || frame.passCount == GPU_TIMER_MAX_PASSES) return;
+        frame.names[frame.passCount] = name;
+        glQueryCounter(frame.queries[frame.passCount * 2], GL_TIMESTAMP);
+        passOpen = true;
+    }
+
+    void endPass()
+    {
+        if (!passOpen) return;
+        FrameQueries& frame = frames[current];
+        glQueryCounter(frame.queries[frame.passCount * 2 + 1], GL_TIMESTAMP);
+        ++frame.passCount;
+        passOpen = false;
+    }
+
+    void endFrame()
+    {
+        if (!initialized) return;
+        endPass();
+        current = (current + 1) % GPU_TIMER_FRAMES;
+    }
+
+    // Averages since the last resetStats(), in first-seen order
+    std::vector<GpuPassStats> stats() const
+    {
+        std::vector<GpuPassStats> result;
+        for (const PassTotal& pass : totals)
+            result.push_back({ pass.name, pass.frames ? pass.totalMs / pass.frames : 0.0 });
+        return result;
+    }
+
+    // The passes of the most recently read back frame, and its first-to-last time
+    const std::vector<GpuPassStats>& latest() const { return latestPasses; }
+    double latestFrameMs() const { return latestMs; }
+
+    // The sum of that frame's pass times: what the GPU was busy for, without the gaps where
+    // it waited for the CPU to submit (the load to size the frame by)
+    double latestBusyMs() const { return latestBusy; }
+
+    // Frames read back so far (not reset by resetStats()); changes when latest() does
+    uint64_t readbacks() const { return readbackCount; }
+
+    // Average time from the first pass's start to the last pass's end
+    double averageFrameMs() const { return collectedFrames ? frameTotalMs / collectedFrames : 0.0; }
+
+    // Frames whose results were not ready in time
+    int droppedFrames() const { return dropped; }
+
+    void resetStats()
+    {
+        totals.clear();
+        frameTotalMs = 0.0;
+        collectedFrames = 0;
+        dropped = 0;
+    }
+
+private:
+    struct FrameQueries {
+        GLuint queries[GPU_TIMER_MAX_PASSES * 2];          // begin, end per pass
+        const char* names[GPU_TIMER_MAX_PASSES];
+        int passCount = 0;
+        GLint64 gpuSync = 0;                                // GL_TIMESTAMP (ns) ...
+        uint64_t cpuSync = 0;                               // ... and Profiler::now() at the same moment
+    };
+
+    struct PassTotal {
+        const char* name;
+        double totalMs;
+        int frames;
+    };
+
+    FrameQueries frames[GPU_TIMER_FRAMES];
+    int current = 0;
+    bool passOpen = false;
+    bool initialized = false;
+    ProfileTrack* track = nullptr;
+
+    std::vector<PassTotal> totals;
+    std::vector<GpuPassStats> latestPasses;
+    double latestMs = 0.0;
+    double latestBusy = 0.0;
+    uint64_t readbackCount = 0;
+    double frameTotalMs = 0.0;
+    int collectedFrames = 0;
+    int dropped = 0;
+
+    void collect(FrameQueries& frame)
+    {
+        // Queries complete in order, so the last one being ready means they all are
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[frame.passCount * 2 - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            ++dropped;
+            return;
+        }
+
+        double ticksPerNanosecond = profiler().ticksPerMicrosecond() / 1000.0;
+        latestPasses.clear();
+        GLuint64 first = 0, last = 0;
+        latestBusy = 0.0;
+        for (int pass = 0; pass < frame.passCount; ++pass) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(frame.queries[pass * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.queries[pass * 2 + 1], GL_QUERY_RESULT, &end);
+            if (pass == 0) first = begin;
+            last = end;
+
+            double startTicks = frame.cpuSync + (double(begin) - double(frame.gpuSync)) * ticksPerNanosecond;
+            double endTicks = frame.cpuSync + (double(end) - double(frame.gpuSync)) * ticksPerNanosecond;
+            if (profiler().enabled())
+                profiler().record(*track, frame.names[pass], static_cast<uint64_t>(startTicks), static_cast<uint64_t>(endTicks));
+            addTotal(frame.names[pass], (end - begin) * 1e-6);
+            latestPasses.push_back({ frame.names[pass], (end - begin) * 1e-6 });
+            latestBusy += (end - begin) * 1e-6;
+        }
+        latestMs = (last - first) * 1e-6;
+        ++readbackCount;
+        frameTotalMs += latestMs;
+        ++collectedFrames;
+    }
+
+    void addTotal(const char* name, double ms)
+    {
+        for (PassTotal& pass : totals) {
+            if (pass.name == name) {
+                pass.totalMs += ms;
+                ++pass.frames;
+                return;
+            }
+        }
+        totals.push_back({ name, ms, 1 });
+    }
+};
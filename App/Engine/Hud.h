@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Performance overlay: text, panels and the frame-time graph as one list of screen-space
+// quads, so the whole HUD is a single instanced draw.
+//
+// Text uses signed distance field glyphs. The atlas is built at startup from a 5x7 pixel
+// font (ASCII 32-95, lower case is drawn as upper case): every font pixel becomes a 3x3
+// block of texels and each texel stores its distance to the nearest glyph edge, so
+// glyphs stay sharp at any size once the shader thresholds the distance at 0.5. One atlas
+// cell is solid, and panels and graph bars sample it, which keeps them in the same draw.
+//
+// Nothing here calls GL: the caller uploads the atlas (one channel) and the quads.
+
+const int HUD_FONT_FIRST = 32;
+const int HUD_FONT_GLYPHS = 64;
+const int HUD_FONT_SCALE = 3;                // texels per font pixel
+const int HUD_CELL_WIDTH = 24;               // atlas cell, texels
+const int HUD_CELL_HEIGHT = 28;
+const int HUD_GLYPH_LEFT = 4;                // glyph position in its cell
+const int HUD_GLYPH_TOP = 3;
+const int HUD_SDF_SPREAD = 4;                // texels from the edge to distance 0 / 1
+const int HUD_ATLAS_COLUMNS = 16;
+const int HUD_SOLID_CELL = HUD_FONT_GLYPHS;  // last cell, completely inside
+const float HUD_GLYPH_ADVANCE = 6.0f * HUD_FONT_SCALE / HUD_CELL_HEIGHT;   // per unit of text height
+
+// Rows top to bottom, bit 4 is the leftmost pixel
+const uint8_t HUD_FONT[HUD_FONT_GLYPHS][7] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // space
+    { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 },   // !
+    { 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00 },   // "
+    { 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A },   // #
+    { 0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04 },   // $
+    { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },   // %
+    { 0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D },   // &
+    { 0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 },   // quote
+    { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 },   // (
+    { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },   // )
+    { 0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00 },   // *
+    { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 },   // +
+    { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 },   // ,
+    { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 },   // -
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C },   // .
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },   // /
+    { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },   // 0
+    { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },   // 1
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },   // 2
+    { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },   // 3
+    { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },   // 4
+    { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },   // 5
+    { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },   // 6
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },   // 7
+    { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },   // 8
+    { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },   // 9
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 },   // :
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08 },   // ;
+    { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 },   // <
+    { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 },   // =
+    { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 },   // >
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 },   // ?
+    { 0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E },   // @
+    { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },   // A
+    { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E },   // B
+    { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },   // C
+    { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },   // D
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },   // E
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 },   // F
+    { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F },   // G
+    { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },   // H
+    { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },   // I
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C },   // J
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },   // K
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },   // L
+    { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 },   // M
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },   // N
+    { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },   // O
+    { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 },   // P
+    { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D },   // Q
+    { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 },   // R
+    { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E },   // S
+    { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },   // T
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },   // U
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 },   // V
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A },   // W
+    { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 },   // X
+    { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 },   // Y
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F },   // Z
+    { 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E },   // [
+    { 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 },   // backslash
+    { 0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E },   // ]
+    { 0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00 },   // ^
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F },   // _
+};
+
+// ---------- Atlas ----------
+struct HudAtlas {
+    int width = 0, height = 0;
+    std::vector<uint8_t> texels;             // one channel, row 0 at the top
+};
+
+inline bool hudFontPixel(int glyph, int x, int y)
+{
+    if (glyph >= HUD_FONT_GLYPHS) return true;                   // solid cell
+    int fx = (x - HUD_GLYPH_LEFT) / HUD_FONT_SCALE, fy = (y - HUD_GLYPH_TOP) / HUD_FONT_SCALE;
+    if (x < HUD_GLYPH_LEFT || y < HUD_GLYPH_TOP || fx >= 5 || fy >= 7) return false;
+    return (HUD_FONT[glyph][fy] >> (4 - fx)) & 1;
+}
+
+inline HudAtlas buildHudAtlas()
+{
+    HudAtlas atlas;
+    int cells = HUD_FONT_GLYPHS + 1;
+    atlas.width = HUD_ATLAS_COLUMNS * HUD_CELL_WIDTH;
+    atlas.height = (cells + HUD_ATLAS_COLUMNS - 1) / HUD_ATLAS_COLUMNS * HUD_CELL_HEIGHT;
+    atlas.texels.assign(atlas.width * atlas.height, 0);
+
+    // Brute force within the spread: a few hundred thousand texel tests, once
+    for (int cell = 0; cell < cells; ++cell) {
+        int cellX = cell % HUD_ATLAS_COLUMNS * HUD_CELL_WIDTH, cellY = cell / HUD_ATLAS_COLUMNS * HUD_CELL_HEIGHT;
+        for (int y = 0; y < HUD_CELL_HEIGHT; ++y) {
+            for (int x = 0; x < HUD_CELL_WIDTH; ++x) {
+                bool inside = hudFontPixel(cell, x, y);
+                float nearest = float(HUD_SDF_SPREAD);
+                for (int dy = -HUD_SDF_SPREAD; dy <= HUD_SDF_SPREAD; ++dy) {
+                    for (int dx = -HUD_SDF_SPREAD; dx <= HUD_SDF_SPREAD; ++dx) {
+                        int sx = x + dx, sy = y + dy;
+                        bool other = sx >= 0 && sy >= 0 && sx < HUD_CELL_WIDTH && sy < HUD_CELL_HEIGHT
+                                         ? hudFontPixel(cell, sx, sy) : cell >= HUD_FONT_GLYPHS;
+                        if (other != inside) nearest = std::min(nearest, std::sqrt(float(dx * dx + dy * dy)));
+                    }
+                }
+                // The edge lies half a texel before the nearest texel on the other side
+                float distance = (nearest - 0.5f) * (inside ? 1.0f : -1.0f);
+                float value = 0.5f + 0.5f * distance / HUD_SDF_SPREAD;
+                atlas.texels[(cellY + y) * atlas.width + cellX + x] =
+                    static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, value)) * 255.0f + 0.5f);
+            }
+        }
+    }
+    return atlas;
+}
+
+// ---------- Quads ----------
+struct HudQuad {
+    float x, y, width, height;               // pixels, origin at the top left
+    float u0, v0, u1, v1;                    // atlas texture coordinates
+    float r, g, b, a;
+};
+
+struct HudColor {
+    float r, g, b, a;
+};
+
+class HudBatch {
+public:
+    HudBatch(int atlasWidth, int atlasHeight) : atlasWidth(atlasWidth), atlasHeight(atlasHeight) {}
+
+    void clear() { quadList.clear(); }
+    const std::vector<HudQuad>& quads() const { return quadList; }
+
+    void rect(float x, float y, float width, float height, HudColor color)
+    {
+        // Sample the middle of the solid cell so filtering never reaches a glyph
+        float u, v;
+        cellCenter(HUD_SOLID_CELL, u, v);
+        quadList.push_back({ x, y, width, height, u, v, u, v, color.r, color.g, color.b, color.a });
+    }
+
+    // One line of text, size = cell height in pixels; returns the x after the last glyph
+    float text(float x, float y, float size, const std::string& line, HudColor color)
+    {
+        float cellWidth = size * HUD_CELL_WIDTH / HUD_CELL_HEIGHT;
+        for (char c : line) {
+            int glyph = (c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c) - HUD_FONT_FIRST;
+            if (glyph > 0 && glyph < HUD_FONT_GLYPHS) {
+                int cellX = glyph % HUD_ATLAS_COLUMNS * HUD_CELL_WIDTH, cellY = glyph / HUD_ATLAS_COLUMNS * HUD_CELL_HEIGHT;
+                quadList.push_back({ x, y, cellWidth, size,
+                                     float(cellX) / atlasWidth, float(cellY) / atlasHeight,
+                                     float(cellX + HUD_CELL_WIDTH) / atlasWidth, float(cellY + HUD_CELL_HEIGHT) / atlasHeight,
+                                     color.r, color.g, color.b, color.a });
+            }
+            x += size * HUD_GLYPH_ADVANCE;
+        }
+        return x;
+    }
+
+    // Bar graph of values[0..count), oldest first, scaled so maxValue fills the height;
+    // bars over budget are drawn in overColor
+    void graph(float x, float y, float width, float height, const float* values, int count, float maxValue,
+               float budget, HudColor color, HudColor overColor)
+    {
+        if (count <= 0) return;
+        float barWidth = width / count;
+        for (int i = 0; i < count; ++i) {
+            float barHeight = std::min(values[i] / maxValue, 1.0f) * height;
+            rect(x + i * barWidth, y + height - barHeight, std::max(1.0f, barWidth - 1.0f), barHeight,
+                 values[i] > budget ? overColor : color);
+        }
+        float budgetY = y + height - std::min(budget / maxValue, 1.0f) * height;
+        rect(x, budgetY, width, 1.0f, overColor);
+    }
+
+private:
+    int atlasWidth, atlasHeight;
+    std::vector<HudQuad> quadList;
+
+    void cellCenter(int cell, float& u, float& v) const
+    {
+        u = (cell % HUD_ATLAS_COLUMNS * HUD_CELL_WIDTH + HUD_CELL_WIDTH * 0.5f) / atlasWidth;
+        v = (cell / HUD_ATLAS_COLUMNS * HUD_CELL_HEIGHT + HUD_CELL_HEIGHT * 0.5f) / atlasHeight;
+    }
+};
+
+// ---------- Smoothed timings ----------
+// Named timings averaged over recent frames (exponential moving average), so the numbers
+// on screen are readable; names are compared by pointer, like profiler zones.
+class HudTimings {
+public:
+    struct Entry {
+        const char* name;
+        float ms;                            // smoothed
+        float frameMs;                       // this frame so far
+        int age;                             // frames since the name was last seen
+    };
+
+    // A name seen more than once in a frame counts the sum
+    void add(const char* name, float ms)
+    {
+        for (Entry& entry : entries) {
+            if (entry.name == name) {
+                entry.frameMs += ms;
+                entry.age = 0;
+                return;
+            }
+        }
+        entries.push_back({ name, -1.0f, ms, 0 });
+    }
+
+    // Once per frame after the adds; names that stop appearing are dropped after a while
+    void endFrame()
+    {
+        for (Entry& entry : entries) {
+            if (entry.age == 0) entry.ms = entry.ms < 0.0f ? entry.frameMs : entry.ms + (entry.frameMs - entry.ms) * SMOOTHING;
+            entry.frameMs = 0.0f;
+            ++entry.age;
+        }
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [](const Entry& entry) { return entry.age > FORGET_FRAMES; }),
+                      entries.end());
+    }
+
+    const std::vector<Entry>& list() const { return entries; }
+
+private:
+    static constexpr float SMOOTHING = 0.1f;
+    static const int FORGET_FRAMES = 120;
+    std::vector<Entry> entries;
+};
+
+// Fixed-width number for the HUD
+inline std::string hudNumber(double value, int decimals)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.*f", decimals, value);
+    return text;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+// Event-driven input: the window system's callbacks push timestamped events while the
+// events are polled at the top of the frame, and beginFrame() folds them into the state
+// the rest of the frame reads. Unlike sampling key state once per frame, a tap shorter
+// than a frame still registers as pressed(), and mouse motion is the sum of every cursor
+// event rather than the difference between two samples.
+//
+// The queue also remembers when the oldest event it handed out arrived, so the caller
+// can measure how long input waits before the frame that used it is presented.
+// Callbacks run on the main thread inside the poll, so nothing here is locked.
+
+enum InputEventType { INPUT_KEY, INPUT_MOUSE_BUTTON, INPUT_CURSOR };
+
+const int INPUT_MAX_KEYS = 512;                 // above GLFW_KEY_LAST
+const int INPUT_MAX_BUTTONS = 8;
+
+struct InputEvent {
+    InputEventType type;
+    int code = 0;                               // key or button
+    bool down = false;                          // press or repeat, false for release
+    double x = 0.0, y = 0.0;                    // cursor position
+    double time = 0.0;                          // seconds, when the event was received
+};
+
+class InputQueue {
+public:
+    void push(const InputEvent& event) { events.push_back(event); }
+
+    // Apply everything queued since the last call
+    void beginFrame()
+    {
+        std::fill(pressedKeys, pressedKeys + INPUT_MAX_KEYS, false);
+        std::fill(pressedButtons, pressedButtons + INPUT_MAX_BUTTONS, false);
+        dx = dy = 0.0;
+        oldest = -1.0;
+        for (const InputEvent& event : events) {
+            if (oldest < 0.0 || event.time < oldest) oldest = event.time;
+            switch (event.type) {
+            case INPUT_KEY:
+                if (event.code < 0 || event.code >= INPUT_MAX_KEYS) break;
+                if (event.down && !keys[event.code]) pressedKeys[event.code] = true;
+                keys[event.code] = event.down;
+                break;
+            case INPUT_MOUSE_BUTTON:
+                if (event.code < 0 || event.code >= INPUT_MAX_BUTTONS) break;
+                if (event.down && !buttons[event.code]) pressedButtons[event.code] = true;
+                buttons[event.code] = event.down;
+                break;
+            case INPUT_CURSOR:
+                if (hasCursor) {
+                    dx += event.x - cursorX;
+                    dy += event.y - cursorY;
+                }
+                cursorX = event.x;
+                cursorY = event.y;
+                hasCursor = true;
+                break;
+            }
+        }
+        events.clear();
+    }
+
+    bool down(int key) const { return key >= 0 && key < INPUT_MAX_KEYS && keys[key]; }
+    // Went down since the last frame, even if it has been released again
+    bool pressed(int key) const { return key >= 0 && key < INPUT_MAX_KEYS && pressedKeys[key]; }
+    bool buttonDown(int button) const { return button >= 0 && button < INPUT_MAX_BUTTONS && buttons[button]; }
+    bool buttonPressed(int button) const { return button >= 0 && button < INPUT_MAX_BUTTONS && pressedButtons[button]; }
+
+    // Cursor motion this frame, in pixels
+    double mouseDx() const { return dx; }
+    double mouseDy() const { return dy; }
+
+    // Receive time of the oldest event applied this frame, negative if there was none
+    double oldestEventTime() const { return oldest; }
+
+    // Events arriving from now on are measured from this cursor position
+    void setCursor(double x, double y)
+    {
+        cursorX = x;
+        cursorY = y;
+        hasCursor = true;
+    }
+
+private:
+    std::vector<InputEvent> events;
+    bool keys[INPUT_MAX_KEYS] = {};
+    bool pressedKeys[INPUT_MAX_KEYS] = {};
+    bool buttons[INPUT_MAX_BUTTONS] = {};
+    bool pressedButtons[INPUT_MAX_BUTTONS] = {};
+    double cursorX = 0.0, cursorY = 0.0;
+    bool hasCursor = false;
+    double dx = 0.0, dy = 0.0;
+    double oldest = -1.0;
+};
+
+// Input-to-present latency over the frames that consumed input
+struct InputLatency {
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+    int frames = 0;
+
+    void add(double ms)
+    {
+        totalMs += ms;
+        maxMs = std::max(maxMs, ms);
+        ++frames;
+    }
+    double averageMs() const { return frames > 0 ? totalMs / frames : 0.0; }
+    void reset() { *this = InputLatency(); }
+};
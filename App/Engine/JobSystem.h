@@ -0,0 +1,323 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Profiler.h"
+
+// Work-stealing job system for the per-frame CPU work.
+//
+// Every thread (the main thread is index 0, workers 1..N) owns a Chase-Lev deque: the
+// owner pushes and pops jobs at the bottom, idle threads steal from the top of a random
+// victim. A job counts its unfinished children; it is finished when its own function and
+// every child have run, and finishing a child ticks its parent. wait() does not block:
+// the waiting thread runs other jobs until the one it waits for is finished, so the main
+// thread helps with the frame instead of sleeping on it.
+//
+// Jobs come from a per-thread ring and are recycled, so a thread must never have more
+// than JOB_RING_SIZE jobs in flight. Idle workers spin briefly and then sleep until new
+// work is pushed.
+
+const int JOB_RING_SIZE  = 8192;      // per thread, power of two
+const int JOB_DEQUE_SIZE = 8192;      // per thread, power of two
+const int JOB_IDLE_SPINS = 64;        // empty steal rounds before a worker sleeps
+
+struct Job {
+    std::function<void()> function;
+    Job* parent = nullptr;
+    std::atomic<int> unfinished{ 0 };   // 1 for the job itself + live children
+};
+
+// Chase-Lev work-stealing deque of job pointers (fixed capacity)
+class JobDeque {
+public:
+    // Owner only. Returns false when full (the caller then runs the job itself).
+    bool push(Job* job)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= JOB_DEQUE_SIZE) return false;
+        items[b & (JOB_DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Owner only: newest job first
+    Job* pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Job* job = items[b & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last item: race any thief for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    // Any thread: oldest job first
+    Job* steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return nullptr;
+        Job* job = items[t & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return job;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top{ 0 };
+    alignas(64) std::atomic<int64_t> bottom{ 0 };
+    std::atomic<Job*> items[JOB_DEQUE_SIZE];
+};
+
+// Per-thread counters since the last resetStats()
+struct JobWorkerStats {
+    double busySeconds = 0.0;     // time spent inside job functions
+    int jobsRun = 0;
+    int jobsStolen = 0;
+    double utilization = 0.0;     // busySeconds / wall time
+};
+
+class JobSystem {
+public:
+    explicit JobSystem(int workerCount = defaultWorkerCount())
+    {
+        int threads = workerCount + 1;
+        for (int i = 0; i < threads; ++i) contexts.emplace_back(new ThreadContext());
+        statsStart = Clock::now();
+        for (int i = 1; i < threads; ++i)
+            workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~JobSystem()
+    {
+        quit.store(true);
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        sleepCondition.notify_all();
+        for (std::thread& t : workers) t.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    static int defaultWorkerCount()
+    {
+        int cores = static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(0, cores - 1);     // the main thread runs jobs too
+    }
+
+    int threadCount() const { return static_cast<int>(contexts.size()); }
+
+    // Cap the threads parallelFor() spreads over (1 = run inline on the caller)
+    void setThreadLimit(int limit) { threadLimit = std::max(1, limit); }
+    int activeThreadCount() const { return std::min(threadLimit, threadCount()); }
+
+    // A job that runs `function` (may be empty). With a parent, the parent does not
+    // finish until this job has.
+    Job* create(std::function<void()> function, Job* parent = nullptr)
+    {
+        ThreadContext& context = *contexts[threadIndex()];
+        Job* job = &context.ring[context.ringNext++ & (JOB_RING_SIZE - 1)];
+        job->function = std::move(function);
+        job->parent = parent;
+        job->unfinished.store(1, std::memory_order_relaxed);
+        if (parent) parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    // Hand a job to the scheduler (it may run on any thread)
+    void run(Job* job)
+    {
+        if (!contexts[threadIndex()]->deque.push(job)) {
+            execute(job);
+            return;
+        }
+        if (sleepers.load(std::memory_order_relaxed) > 0) sleepCondition.notify_one();
+    }
+
+    bool finished(const Job* job) const { return job->unfinished.load(std::memory_order_acquire) == 0; }
+
+    // Run other jobs until `job` and all its children are done
+    void wait(const Job* job)
+    {
+        int index = threadIndex();
+        while (!finished(job)) {
+            Job* next = findJob(index);
+            if (next) execute(next);
+            else std::this_thread::yield();
+        }
+    }
+
+    // Split [0, count) into chunks of `grain` and run body(begin, end) on them as
+    // children of one root job. Returns when all chunks are done.
+    void parallelFor(int count, int grain, const std::function<void(int, int)>& body)
+    {
+        if (count <= 0) return;
+        grain = std::max(1, grain);
+        if (count <= grain || activeThreadCount() == 1) {
+            body(0, count);
+            return;
+        }
+        Job* root = create(std::function<void()>());
+        for (int begin = 0; begin < count; begin += grain) {
+            int end = std::min(count, begin + grain);
+            run(create([&body, begin, end] { body(begin, end); }, root));
+        }
+        run(root);
+        wait(root);
+    }
+
+    // ---------- Profiling ----------
+    void resetStats()
+    {
+        for (std::unique_ptr<ThreadContext>& c : contexts) {
+            c->busyNanos.store(0);
+            c->jobsRun.store(0);
+            c->jobsStolen.store(0);
+        }
+        statsStart = Clock::now();
+    }
+
+    // Index 0 is the main thread
+    std::vector<JobWorkerStats> stats() const
+    {
+        double wall = std::chrono::duration<double>(Clock::now() - statsStart).count();
+        std::vector<JobWorkerStats> result(contexts.size());
+        for (size_t i = 0; i < contexts.size(); ++i) {
+            result[i].busySeconds = contexts[i]->busyNanos.load() * 1e-9;
+            result[i].jobsRun = contexts[i]->jobsRun.load();
+            result[i].jobsStolen = contexts[i]->jobsStolen.load();
+            result[i].utilization = wall > 0.0 ? result[i].busySeconds / wall : 0.0;
+        }
+        return result;
+    }
+
+    // Deques and job rings of every thread
+    size_t memoryBytes() const { return contexts.size() * (sizeof(ThreadContext) + JOB_RING_SIZE * sizeof(Job)); }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct ThreadContext {
+        JobDeque deque;
+        std::unique_ptr<Job[]> ring{ new Job[JOB_RING_SIZE] };
+        uint32_t ringNext = 0;
+        uint32_t random = 0x9E3779B9u;
+        std::atomic<int64_t> busyNanos{ 0 };
+        std::atomic<int> jobsRun{ 0 };
+        std::atomic<int> jobsStolen{ 0 };
+    };
+
+    std::vector<std::unique_ptr<ThreadContext>> contexts;
+    std::vector<std::thread> workers;
+    std::atomic<bool> quit{ false };
+    std::atomic<int> sleepers{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    int threadLimit = 1 << 30;
+    Clock::time_point statsStart;
+
+    static int& threadIndex()
+    {
+        static thread_local int index = 0;
+        return index;
+    }
+
+    Job* findJob(int index)
+    {
+        ThreadContext& self = *contexts[index];
+        if (Job* job = self.deque.pop()) return job;
+
+        int threads = threadCount();
+        if (threads < 2) return nullptr;
+        self.random ^= self.random << 13;
+        self.random ^= self.random >> 17;
+        self.random ^= self.random << 5;
+        int start = static_cast<int>(self.random % threads);
+        for (int k = 0; k < threads; ++k) {
+            int victim = (start + k) % threads;
+            if (victim == index) continue;
+            if (Job* job = contexts[victim]->deque.steal()) {
+                self.jobsStolen.fetch_add(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+        return nullptr;
+    }
+
+    void execute(Job* job)
+    {
+        ThreadContext& self = *contexts[threadIndex()];
+        Clock::time_point start = Clock::now();
+        if (job->function) job->function();
+        self.busyNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count(),
+                                 std::memory_order_relaxed);
+        self.jobsRun.fetch_add(1, std::memory_order_relaxed);
+        finish(job);
+    }
+
+    void finish(Job* job)
+    {
+        // Read the parent first: once the count hits zero a waiter may recycle the slot
+        while (job) {
+            Job* parent = job->parent;
+            if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) break;
+            job = parent;
+        }
+    }
+
+    void workerLoop(int index)
+    {
+        threadIndex() = index;
+        profiler().setThreadName("job worker " + std::to_string(index));
+        int idle = 0;
+        while (!quit.load(std::memory_order_relaxed)) {
+            if (Job* job = findJob(index)) {
+                execute(job);
+                idle = 0;
+            } else if (++idle < JOB_IDLE_SPINS) {
+                std::this_thread::yield();
+            } else {
+                // The timeout covers a push that raced with going to sleep
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                sleepers.fetch_add(1);
+                sleepCondition.wait_for(lock, std::chrono::milliseconds(1));
+                sleepers.fetch_sub(1);
+                idle = 0;
+            }
+        }
+    }
+};
+
+// Process-wide job system, created on first use
+inline JobSystem& jobSystem()
+{
+    static JobSystem system;
+    return system;
+}
+
+inline void parallelFor(int count, int grain, const std::function<void(int, int)>& body)
+{
+    jobSystem().parallelFor(count, grain, body);
+}
@@ -0,0 +1,362 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "ResourceRegistry.h"
+#include "SimdMath.h"
+
+// Software occlusion culling on the CPU.
+//
+// A few large, simple occluders (quads standing in for walls, boxes under hills) are
+// rasterized into a small depth buffer, and the bounding boxes of everything else are
+// tested against it before anything is submitted. The occluders are conservative: each
+// one lies inside solid geometry, so whatever it hides the real mesh hides too.
+//
+// The buffer holds 1 / w, which is linear in screen space (so it interpolates exactly)
+// and grows towards the camera; 0 means nothing was drawn. Rasterization is conservative
+// in the same direction: a pixel is only written when the polygon covers all of it, with
+// the farthest depth the polygon has inside it, and polygons are clipped to the near
+// plane rather than guarded. Every pixel therefore lies behind the occluders wherever it
+// has a value. Occluders are drawn as whole convex quads, not as two triangles: pixels on
+// the shared diagonal are covered by neither triangle alone and would stay empty. Four
+// pixels of a row are shaded at once with f32x4. The setup is split over the quads and
+// the rasterization over bands of rows, both with parallelFor(), so it runs on the job
+// system's workers.
+//
+// A mip chain (HiZ) then keeps the farthest depth of every 2x2 block. A box is projected,
+// its nearest depth is taken from the corners, and it is hidden when that depth is behind
+// every texel of the first level at which the box's screen rectangle covers at most 4x4
+// texels. Boxes that reach the near plane are always visible.
+//
+// Occluders are picked per frame: those inside the frustum, largest on screen first, at
+// most OCCLUSION_MAX_OCCLUDERS of them.
+
+const int OCCLUSION_WIDTH = 256;                // pixels, multiple of 4 and power of two
+const int OCCLUSION_HEIGHT = 128;
+const int OCCLUSION_LEVELS = 6;                 // 256x128 down to 8x4
+const int OCCLUSION_BAND_ROWS = 16;             // rows per rasterization job
+const int OCCLUSION_SETUP_GRAIN = 64;           // quads per setup job
+const int OCCLUSION_MAX_OCCLUDERS = 256;
+const float OCCLUSION_MIN_SIZE = 0.02f;         // occluder radius / distance below which it is skipped
+const float OCCLUSION_NEAR = 0.1f;              // clip w; boxes nearer than this are visible
+
+// Occluders and quads rasterized by the last render()
+struct OcclusionStats {
+    int occluders = 0;
+    int quads = 0;
+};
+
+class OcclusionCuller {
+public:
+    OcclusionCuller() : depth(size_t(OCCLUSION_WIDTH) * OCCLUSION_HEIGHT, 0.0f)
+    {
+        for (int level = 1; level < OCCLUSION_LEVELS; ++level)
+            hiz[level].assign(size_t(levelWidth(level)) * levelHeight(level), 0.0f);
+    }
+
+    // ---------- Occluders (world space, set up once) ----------
+    void clearOccluders()
+    {
+        occluders.clear();
+        vertices.clear();
+    }
+
+    // A planar convex quad; the corners go round its edge in either direction
+    void addQuad(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d)
+    {
+        Occluder occluder;
+        occluder.firstVertex = static_cast<int>(vertices.size());
+        vertices.insert(vertices.end(), { a, b, c, d });
+        occluder.vertexCount = 4;
+        occluder.closed = false;
+        for (const glm::vec3& p : { a, b, c, d }) occluder.bounds.grow(p);
+        occluders.push_back(occluder);
+    }
+
+    // A solid box: its top and four sides (nothing is seen from below the ground). The
+    // faces go counter-clockwise seen from outside, so those facing away can be skipped.
+    void addBox(const Aabb& box)
+    {
+        Occluder occluder;
+        occluder.firstVertex = static_cast<int>(vertices.size());
+        const glm::vec3 &lo = box.min, &hi = box.max;
+        glm::vec3 top[4] = { glm::vec3(lo.x, hi.y, lo.z), glm::vec3(hi.x, hi.y, lo.z), glm::vec3(hi.x, hi.y, hi.z), glm::vec3(lo.x, hi.y, hi.z) };
+        glm::vec3 bottom[4] = { glm::vec3(lo.x, lo.y, lo.z), glm::vec3(hi.x, lo.y, lo.z), glm::vec3(hi.x, lo.y, hi.z), glm::vec3(lo.x, lo.y, hi.z) };
+        vertices.insert(vertices.end(), { top[0], top[3], top[2], top[1] });
+        for (int i = 0; i < 4; ++i) {
+            int j = (i + 1) % 4;
+            vertices.insert(vertices.end(), { bottom[i], top[i], top[j], bottom[j] });
+        }
+        occluder.vertexCount = static_cast<int>(vertices.size()) - occluder.firstVertex;
+        occluder.closed = true;
+        occluder.bounds = box;
+        occluders.push_back(occluder);
+    }
+
+    int occluderCount() const { return static_cast<int>(occluders.size()); }
+
+    // ---------- Per frame ----------
+    // Pick the occluders for this view, rasterize them and build the HiZ levels
+    void render(const glm::mat4& viewProjection, const Frustum& frustum, const glm::vec3& eye)
+    {
+        matrix = viewProjection;
+        lastStats = OcclusionStats();
+        if (!enabled) return;
+
+        // Largest on screen first: radius over distance
+        picked.clear();
+        for (int i = 0; i < static_cast<int>(occluders.size()); ++i) {
+            const Aabb& box = occluders[i].bounds;
+            if (!frustum.intersects(box)) continue;
+            float distance = glm::length(eye - glm::clamp(eye, box.min, box.max));
+            float size = glm::length(box.extents()) / std::max(distance, OCCLUSION_NEAR);
+            if (size >= OCCLUSION_MIN_SIZE) picked.push_back(PickedOccluder{ i, size });
+        }
+        if (static_cast<int>(picked.size()) > OCCLUSION_MAX_OCCLUDERS) {
+            std::nth_element(picked.begin(), picked.begin() + OCCLUSION_MAX_OCCLUDERS, picked.end(),
+                             [](const PickedOccluder& a, const PickedOccluder& b) { return a.size > b.size; });
+            picked.resize(OCCLUSION_MAX_OCCLUDERS);
+        }
+        quadVertices.clear();
+        quadClosed.clear();
+        for (const PickedOccluder& p : picked) {
+            const Occluder& occluder = occluders[p.occluder];
+            quadVertices.insert(quadVertices.end(), vertices.begin() + occluder.firstVertex,
+                                vertices.begin() + occluder.firstVertex + occluder.vertexCount);
+            quadClosed.insert(quadClosed.end(), occluder.vertexCount / 4, occluder.closed);
+        }
+
+        int quadCount = static_cast<int>(quadClosed.size());
+        setups.resize(quadCount);
+        parallelFor(quadCount, OCCLUSION_SETUP_GRAIN, [&](int begin, int end) {
+            for (int q = begin; q < end; ++q) setupQuad(&quadVertices[size_t(q) * 4], quadClosed[q] != 0, setups[q]);
+        });
+        lastStats.occluders = static_cast<int>(picked.size());
+        for (const PolygonSetup& setup : setups) lastStats.quads += setup.valid;
+
+        parallelFor(OCCLUSION_HEIGHT, OCCLUSION_BAND_ROWS, [&](int rowBegin, int rowEnd) {
+            std::fill(depth.begin() + size_t(rowBegin) * OCCLUSION_WIDTH, depth.begin() + size_t(rowEnd) * OCCLUSION_WIDTH, 0.0f);
+            for (const PolygonSetup& setup : setups)
+                if (setup.valid) rasterize(setup, rowBegin, rowEnd);
+        });
+        buildHiz();
+    }
+
+    // Whether any of the box might be seen; safe to call from several threads after render()
+    bool visible(const Aabb& box) const
+    {
+        if (!enabled) return true;
+        // The eight corners, four at a time: the low face, then the high one
+        const float xs[4] = { box.min.x, box.max.x, box.min.x, box.max.x };
+        const float zs[4] = { box.min.z, box.min.z, box.max.z, box.max.z };
+        f32x4 x = f32x4::load(xs), z = f32x4::load(zs);
+        float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX, nearest = 0.0f;
+        for (float y : { box.min.y, box.max.y }) {
+            f32x4 cy(y);
+            f32x4 cx = f32x4(matrix[0][0]) * x + f32x4(matrix[1][0]) * cy + f32x4(matrix[2][0]) * z + f32x4(matrix[3][0]);
+            f32x4 cyy = f32x4(matrix[0][1]) * x + f32x4(matrix[1][1]) * cy + f32x4(matrix[2][1]) * z + f32x4(matrix[3][1]);
+            f32x4 cw = f32x4(matrix[0][3]) * x + f32x4(matrix[1][3]) * cy + f32x4(matrix[2][3]) * z + f32x4(matrix[3][3]);
+            float w[4];
+            cw.store(w);
+            for (float wi : w)
+                if (wi < OCCLUSION_NEAR) return true;
+            f32x4 invW = f32x4(1.0f) / cw;
+            float sx[4], sy[4], iw[4];
+            ((cx * invW + f32x4(1.0f)) * f32x4(0.5f * OCCLUSION_WIDTH)).store(sx);
+            ((cyy * invW + f32x4(1.0f)) * f32x4(0.5f * OCCLUSION_HEIGHT)).store(sy);
+            invW.store(iw);
+            for (int i = 0; i < 4; ++i) {
+                minX = std::min(minX, sx[i]);
+                maxX = std::max(maxX, sx[i]);
+                minY = std::min(minY, sy[i]);
+                maxY = std::max(maxY, sy[i]);
+                nearest = std::max(nearest, iw[i]);
+            }
+        }
+        // Off screen is the frustum's business
+        if (maxX < 0.0f || maxY < 0.0f || minX >= OCCLUSION_WIDTH || minY >= OCCLUSION_HEIGHT) return true;
+        int x0 = std::max(0, static_cast<int>(minX)), x1 = std::min(OCCLUSION_WIDTH - 1, static_cast<int>(maxX));
+        int y0 = std::max(0, static_cast<int>(minY)), y1 = std::min(OCCLUSION_HEIGHT - 1, static_cast<int>(maxY));
+
+        int level = 0;
+        while (level + 1 < OCCLUSION_LEVELS && ((x1 >> level) - (x0 >> level) >= 4 || (y1 >> level) - (y0 >> level) >= 4)) ++level;
+        const float* texels = level == 0 ? depth.data() : hiz[level].data();
+        int width = levelWidth(level);
+        for (int y = y0 >> level; y <= y1 >> level; ++y)
+            for (int x = x0 >> level; x <= x1 >> level; ++x)
+                if (texels[size_t(y) * width + x] <= nearest) return true;
+        return false;
+    }
+
+    // With culling off nothing is rasterized and every box is visible
+    void setEnabled(bool on) { enabled = on; }
+    bool isEnabled() const { return enabled; }
+
+    const OcclusionStats& stats() const { return lastStats; }
+
+    size_t memoryBytes() const
+    {
+        size_t bytes = vectorBytes(occluders) + vectorBytes(vertices) + vectorBytes(picked) +
+                       vectorBytes(quadVertices) + vectorBytes(quadClosed) + vectorBytes(setups) + vectorBytes(depth);
+        for (int level = 1; level < OCCLUSION_LEVELS; ++level) bytes += vectorBytes(hiz[level]);
+        return bytes;
+    }
+
+private:
+    struct Occluder {
+        Aabb bounds;
+        int firstVertex = 0;
+        int vertexCount = 0;
+        bool closed = false;                    // part of a solid: its back faces are hidden
+    };
+
+    struct PickedOccluder {
+        int occluder;
+        float size;
+    };
+
+    // Edge functions e(x, y) = a x + b y + c, positive inside and already moved in by half a
+    // pixel, so e >= 0 at a pixel centre means the whole pixel is covered; depth likewise
+    // moved back by half a pixel's change, so it is the farthest depth inside the pixel.
+    // A quad clipped by the near plane has up to five edges; unused ones are always 0.
+    struct PolygonSetup {
+        float a[5], b[5], c[5];
+        float depthA, depthB, depthC;
+        int minX, maxX, minY, maxY;
+        bool valid = false;
+    };
+
+    std::vector<Occluder> occluders;
+    std::vector<glm::vec3> vertices;            // occluder quads, four corners each
+    std::vector<PickedOccluder> picked;
+    std::vector<glm::vec3> quadVertices;        // this frame's quads
+    std::vector<uint8_t> quadClosed;
+    std::vector<PolygonSetup> setups;
+    std::vector<float> depth;
+    std::vector<float> hiz[OCCLUSION_LEVELS];   // level 0 is `depth`
+    glm::mat4 matrix = glm::mat4(1.0f);
+    bool enabled = true;
+    OcclusionStats lastStats;
+
+    static int levelWidth(int level) { return OCCLUSION_WIDTH >> level; }
+    static int levelHeight(int level) { return OCCLUSION_HEIGHT >> level; }
+
+    // Clip to w >= OCCLUSION_NEAR and set up what is left; the back faces of closed
+    // occluders are dropped
+    void setupQuad(const glm::vec3* quad, bool closed, PolygonSetup& s) const
+    {
+        s.valid = false;
+        glm::vec4 in[4], clipped[5];
+        for (int i = 0; i < 4; ++i) in[i] = matrix * glm::vec4(quad[i], 1.0f);
+        int count = 0;
+        for (int i = 0; i < 4; ++i) {
+            const glm::vec4 &p = in[i], &q = in[(i + 1) % 4];
+            bool pInside = p.w >= OCCLUSION_NEAR, qInside = q.w >= OCCLUSION_NEAR;
+            if (pInside) clipped[count++] = p;
+            if (pInside != qInside) clipped[count++] = p + (q - p) * ((OCCLUSION_NEAR - p.w) / (q.w - p.w));
+        }
+        if (count < 3) return;
+
+        glm::vec3 screen[5];
+        float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+        for (int i = 0; i < count; ++i) {
+            float invW = 1.0f / clipped[i].w;
+            screen[i] = glm::vec3((clipped[i].x * invW + 1.0f) * 0.5f * OCCLUSION_WIDTH,
+                                  (clipped[i].y * invW + 1.0f) * 0.5f * OCCLUSION_HEIGHT, invW);
+            minX = std::min(minX, screen[i].x);
+            maxX = std::max(maxX, screen[i].x);
+            minY = std::min(minY, screen[i].y);
+            maxY = std::max(maxY, screen[i].y);
+        }
+        // Pixels whose centres are within the bounds, on screen
+        s.minX = std::max(0, static_cast<int>(std::ceil(std::max(minX, -1.0f) - 0.5f)));
+        s.maxX = std::min(OCCLUSION_WIDTH - 1, static_cast<int>(std::floor(std::min(maxX, float(OCCLUSION_WIDTH + 1)) - 0.5f)));
+        s.minY = std::max(0, static_cast<int>(std::ceil(std::max(minY, -1.0f) - 0.5f)));
+        s.maxY = std::min(OCCLUSION_HEIGHT - 1, static_cast<int>(std::floor(std::min(maxY, float(OCCLUSION_HEIGHT + 1)) - 0.5f)));
+        if (s.minX > s.maxX || s.minY > s.maxY) return;
+
+        // The depth plane through the widest fan triangle; its area's sign gives the winding
+        float area = 0.0f;
+        int widest = 1;
+        for (int i = 1; i + 1 < count; ++i) {
+            float fan = (screen[i].x - screen[0].x) * (screen[i + 1].y - screen[0].y) -
+                        (screen[i + 1].x - screen[0].x) * (screen[i].y - screen[0].y);
+            if (std::fabs(fan) > std::fabs(area)) {
+                area = fan;
+                widest = i;
+            }
+        }
+        if (std::fabs(area) < 1e-6f || (closed && area < 0.0f)) return;
+        const glm::vec3 &p0 = screen[0], &p1 = screen[widest], &p2 = screen[widest + 1];
+        float dx1 = p1.x - p0.x, dy1 = p1.y - p0.y, dz1 = p1.z - p0.z;
+        float dx2 = p2.x - p0.x, dy2 = p2.y - p0.y, dz2 = p2.z - p0.z;
+        s.depthA = (dz1 * dy2 - dz2 * dy1) / area;
+        s.depthB = (dz2 * dx1 - dz1 * dx2) / area;
+        s.depthC = p0.z - s.depthA * p0.x - s.depthB * p0.y - 0.5f * (std::fabs(s.depthA) + std::fabs(s.depthB));
+
+        // Edges turned inwards whichever way the corners go round
+        float sign = area > 0.0f ? 1.0f : -1.0f;
+        for (int i = 0; i < 5; ++i) {
+            if (i >= count) {
+                s.a[i] = s.b[i] = s.c[i] = 0.0f;
+                continue;
+            }
+            const glm::vec3 &from = screen[i], &to = screen[(i + 1) % count];
+            float a = (from.y - to.y) * sign, b = (to.x - from.x) * sign;
+            s.a[i] = a;
+            s.b[i] = b;
+            s.c[i] = -(a * from.x + b * from.y) - 0.5f * (std::fabs(a) + std::fabs(b));
+        }
+        s.valid = true;
+    }
+
+    // Max-write the fully covered pixels of rows [rowBegin, rowEnd)
+    void rasterize(const PolygonSetup& s, int rowBegin, int rowEnd)
+    {
+        int y0 = std::max(s.minY, rowBegin), y1 = std::min(s.maxY, rowEnd - 1);
+        if (y0 > y1) return;
+        static const float laneOffsets[4] = { 0.5f, 1.5f, 2.5f, 3.5f };
+        const f32x4 lanes = f32x4::load(laneOffsets), zero(0.0f);
+        const f32x4 a0(s.a[0]), a1(s.a[1]), a2(s.a[2]), a3(s.a[3]), a4(s.a[4]), depthA(s.depthA);
+        int xBegin = s.minX & ~3;
+        for (int y = y0; y <= y1; ++y) {
+            float cy = y + 0.5f;
+            f32x4 e0(s.b[0] * cy + s.c[0]), e1(s.b[1] * cy + s.c[1]), e2(s.b[2] * cy + s.c[2]);
+            f32x4 e3(s.b[3] * cy + s.c[3]), e4(s.b[4] * cy + s.c[4]);
+            f32x4 depthRow(s.depthB * cy + s.depthC);
+            float* row = &depth[size_t(y) * OCCLUSION_WIDTH];
+            for (int x = xBegin; x <= s.maxX; x += 4) {
+                f32x4 px = f32x4(float(x)) + lanes;
+                f32x4 outside = simdOr(simdOr(simdLess(a0 * px + e0, zero), simdLess(a1 * px + e1, zero)),
+                                       simdOr(simdLess(a2 * px + e2, zero), simdLess(a3 * px + e3, zero)));
+                outside = simdOr(outside, simdLess(a4 * px + e4, zero));
+                f32x4 old = f32x4::load(row + x);
+                f32x4 value = simdMax(old, simdMax(depthA * px + depthRow, zero));
+                simdSelect(outside, old, value).store(row + x);
+            }
+        }
+    }
+
+    // Each texel of a level is the farthest (smallest) of the 2x2 below it
+    void buildHiz()
+    {
+        for (int level = 1; level < OCCLUSION_LEVELS; ++level) {
+            const float* below = level == 1 ? depth.data() : hiz[level - 1].data();
+            int belowWidth = levelWidth(level - 1), width = levelWidth(level);
+            float* texels = hiz[level].data();
+            for (int y = 0; y < levelHeight(level); ++y) {
+                const float* r0 = below + size_t(2 * y) * belowWidth;
+                const float* r1 = r0 + belowWidth;
+                for (int x = 0; x < width; ++x)
+                    texels[size_t(y) * width + x] = std::min(std::min(r0[2 * x], r0[2 * x + 1]), std::min(r1[2 * x], r1[2 * x + 1]));
+            }
+        }
+    }
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PROFILER_RDTSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// CPU profiler: scoped zones recorded into per-thread rings, exported as Chrome
+// trace_event JSON (open it in Perfetto or chrome://tracing).
+//
+//     PROFILE_ZONE("cloud pass");      // times the rest of the enclosing scope
+//     ProfileZone zone("update");      // or a named zone, closed early with zone.end()
+//
+// A zone reads the time stamp counter twice (steady_clock where there is no rdtsc) and
+// writes one event into the calling thread's ring, which only that thread writes to, so
+// recording takes no lock. The rings always hold the most recent events;
+// writeChromeTrace() converts them to microseconds and must be called while no other
+// thread is recording (between frames, when the job system is idle). Zone names must
+// stay valid until the trace is written (string literals): only the pointer is stored. Events timed by
+// other means, such as GPU queries, go on tracks of their own (addTrack()).
+
+const int PROFILE_EVENTS_PER_THREAD = 1 << 16;      // power of two
+
+struct ProfileEvent {
+    const char* name;
+    uint64_t start, end;                             // Profiler::now() ticks
+};
+
+// One row of the trace: a thread, or a pseudo-thread such as the GPU. Only one thread
+// writes to a track.
+struct ProfileTrack {
+    std::unique_ptr<ProfileEvent[]> events{ new ProfileEvent[PROFILE_EVENTS_PER_THREAD] };
+    std::atomic<uint64_t> head{ 0 };                 // events ever recorded
+    uint64_t tail = 0;                               // first event not cleared
+    std::string name;
+};
+
+class Profiler {
+public:
+    // Ticks: TSC cycles with rdtsc, nanoseconds otherwise
+    static uint64_t now()
+    {
+#ifdef PROFILER_RDTSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    Profiler() : calibrationTicks(now()), calibrationTime(Clock::now()) {}
+
+    bool enabled() const { return active.load(std::memory_order_relaxed); }
+    void setEnabled(bool on) { active.store(on, std::memory_order_relaxed); }
+
+    void record(const char* name, uint64_t start, uint64_t end) { record(threadTrack(), name, start, end); }
+
+    void record(ProfileTrack& track, const char* name, uint64_t start, uint64_t end)
+    {
+        uint64_t head = track.head.load(std::memory_order_relaxed);
+        track.events[head & (PROFILE_EVENTS_PER_THREAD - 1)] = { name, start, end };
+        track.head.store(head + 1, std::memory_order_release);
+    }
+
+    // Label the calling thread in the trace
+    void setThreadName(const std::string& name) { threadTrack().name = name; }
+
+    // Position in the calling thread's events, for forEachEventSince()
+    uint64_t eventMark() { return threadTrack().head.load(std::memory_order_relaxed); }
+
+    // fn(const ProfileEvent&) for the calling thread's events recorded since mark, oldest first
+    template <class Fn>
+    void forEachEventSince(uint64_t mark, Fn fn)
+    {
+        ProfileTrack& track = threadTrack();
+        uint64_t head = track.head.load(std::memory_order_relaxed);
+        for (uint64_t i = std::max(mark, firstHeld(track, head)); i < head; ++i)
+            fn(track.events[i & (PROFILE_EVENTS_PER_THREAD - 1)]);
+    }
+
+    // A track that is not a thread, for events timed elsewhere (GPU queries)
+    ProfileTrack& addTrack(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffers.emplace_back(new ProfileTrack);
+        buffers.back()->name = name.empty() ? "thread " + std::to_string(buffers.size() - 1) : name;
+        return *buffers.back();
+    }
+
+    // Tick rate, measured against steady_clock over the profiler's lifetime (at least 20 ms)
+    double ticksPerMicrosecond()
+    {
+#ifdef PROFILER_RDTSC
+        Clock::duration elapsed = Clock::now() - calibrationTime;
+        if (elapsed < std::chrono::milliseconds(20)) std::this_thread::sleep_for(std::chrono::milliseconds(20) - elapsed);
+        uint64_t ticks = now() - calibrationTicks;
+        double microseconds = std::chrono::duration<double, std::micro>(Clock::now() - calibrationTime).count();
+        return ticks / microseconds;
+#else
+        return 1000.0;
+#endif
+    }
+
+    // Event rings of every track
+    size_t memoryBytes()
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        return buffers.size() * (sizeof(ProfileTrack) + PROFILE_EVENTS_PER_THREAD * sizeof(ProfileEvent));
+    }
+
+    // Forget everything recorded so far
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        for (std::unique_ptr<ProfileTrack>& buffer : buffers) buffer->tail = buffer->head.load(std::memory_order_acquire);
+    }
+
+    // Write the events still held by the rings; returns the number written, -1 on failure
+    int writeChromeTrace(const std::string& path)
+    {
+        double tickRate = ticksPerMicrosecond();
+        std::lock_guard<std::mutex> lock(buffersMutex);
+
+        uint64_t base = UINT64_MAX;
+        for (std::unique_ptr<ProfileTrack>& buffer : buffers) {
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            for (uint64_t i = firstHeld(*buffer, head); i < head; ++i)
+                base = std::min(base, buffer->events[i & (PROFILE_EVENTS_PER_THREAD - 1)].start);
+        }
+
+        FILE* file = fopen(path.c_str(), "w");
+        if (!file) {
+            std::cerr << "Failed to write profile trace " << path << std::endl;
+            return -1;
+        }
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        int written = 0;
+        for (size_t t = 0; t < buffers.size(); ++t) {
+            ProfileTrack& buffer = *buffers[t];
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    t == 0 ? "" : ",\n", static_cast<int>(t), escape(buffer.name).c_str());
+            uint64_t head = buffer.head.load(std::memory_order_acquire);
+            for (uint64_t i = firstHeld(buffer, head); i < head; ++i) {
+                const ProfileEvent& e = buffer.events[i & (PROFILE_EVENTS_PER_THREAD - 1)];
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        escape(e.name).c_str(), static_cast<int>(t),
+                        (e.start - base) / tickRate, (e.end - e.start) / tickRate);
+                ++written;
+            }
+        }
+        fprintf(file, "\n]}\n");
+        bool ok = fclose(file) == 0;
+        return ok ? written : -1;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::atomic<bool> active{ true };
+    std::mutex buffersMutex;                         // only taken when a track is added and when exporting
+    std::vector<std::unique_ptr<ProfileTrack>> buffers;
+    uint64_t calibrationTicks;
+    Clock::time_point calibrationTime;
+
+    ProfileTrack& threadTrack()
+    {
+        static thread_local ProfileTrack* track = nullptr;
+        if (!track) track = &addTrack(std::string());
+        return *track;
+    }
+
+    static uint64_t firstHeld(const ProfileTrack& buffer, uint64_t head)
+    {
+        uint64_t oldest = head > uint64_t(PROFILE_EVENTS_PER_THREAD) ? head - PROFILE_EVENTS_PER_THREAD : 0;
+        return std::max(oldest, buffer.tail);
+    }
+
+    static std::string escape(const std::string& text)
+    {
+        std::string out;
+        for (char c : text) {
+            if (c == '"' || c == '\\') out += '\\';
+            if (static_cast<unsigned char>(c) >= 0x20) out += c;
+        }
+        return out;
+    }
+};
+
+// Process-wide profiler
+inline Profiler& profiler()
+{
+    static Profiler instance;
+    return instance;
+}
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* zoneName) : name(zoneName), start(profiler().enabled() ? Profiler::now() : 0) {}
+    ~ProfileZone() { end(); }
+
+    // Close the zone before the end of its scope (for phases that declare variables used later)
+    void end()
+    {
+        if (start) profiler().record(name, start, Profiler::now());
+        start = 0;
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
@@ -0,0 +1,388 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include "Bvh.h"
+#include "JobSystem.h"
+#include "ResourceRegistry.h"
+
+// Precomputed potentially-visible sets (PVS).
+//
+// The camera follows the car along the road, so the places it looks from are known in
+// advance. The app splits that volume into cells (a box around every track chunk) and
+// bakes, offline, which objects can be seen from anywhere inside each cell. Runtime
+// culling is then a cell lookup, one bit and the frustum test, with no occlusion work per
+// frame; a camera outside every cell falls back to Engine/OcclusionCulling.h.
+//
+// Baking ray-samples: points spread through the cell (jittered on a grid) are joined to
+// points on the object's bounds (corners, face centres and jittered points on every
+// face), and the object is visible as soon as one of those segments is not blocked.
+// Objects overlapping a cell, or within PVS_NEAR_DISTANCE of it, are always visible. The
+// occluders are solid boxes (under the hills) and planar convex quads (walls), conservative
+// like the occlusion buffer's, in a BVH; a segment is blocked when it passes through one
+// strictly between its ends. Sampling is not exhaustive, so an object seen only through a
+// gap between samples can be missed; the sample counts keep that to slivers.
+//
+// Each cell's objects are baked with parallelFor(), so the bake uses every core; the grain
+// grows with the object count so one cell never has more than PVS_BAKE_MAX_JOBS jobs in
+// flight (the job system recycles jobs from a fixed ring, see Engine/JobSystem.h).
+// Each cell's result is a bitset of 64-bit words. The .pvs file holds the bitsets and a
+// signature of everything they were baked from: the cells, the object bounds, the occluder
+// geometry and the sampling parameters. load() refuses a file baked from anything else, so
+// a changed scene never culls with stale sets.
+
+const int PVS_CELL_GRID = 4;                    // jittered sample columns per horizontal axis of a cell
+const int PVS_CELL_LAYERS = 2;                  // sample layers in height
+const int PVS_FACE_SAMPLES = 2;                 // jittered samples per face of an object's bounds
+const float PVS_NEAR_DISTANCE = 2.0f;           // metres; objects this close to a cell are always visible
+const float PVS_RAY_EPSILON = 1e-4f;            // fraction of a segment ignored at either end
+const int PVS_BAKE_GRAIN = 16;                  // objects per bake job, at least
+const int PVS_BAKE_MAX_JOBS = 1024;             // per cell, well inside JOB_RING_SIZE
+const uint32_t PVS_FILE_VERSION = 1;
+
+const int PVS_CELL_SAMPLES = PVS_CELL_GRID * PVS_CELL_GRID * PVS_CELL_LAYERS;
+const int PVS_OBJECT_SAMPLES = 8 + 6 + 6 * PVS_FACE_SAMPLES;
+
+struct PvsFileHeader {
+    char magic[4];                              // "PVSB"
+    uint32_t version;
+    uint32_t cellCount, objectCount;
+    uint64_t signature;                         // of the cells, objects, occluders and parameters baked from
+};
+
+// FNV-1a, continued from hash over the given bytes
+inline uint64_t pvsHash(uint64_t hash, const void* data, size_t bytes)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < bytes; ++i) hash = (hash ^ p[i]) * 1099511628211ull;
+    return hash;
+}
+
+inline uint64_t pvsHash(uint64_t hash, const Aabb& box)
+{
+    const float values[6] = { box.min.x, box.min.y, box.min.z, box.max.x, box.max.y, box.max.z };
+    return pvsHash(hash, values, sizeof(values));
+}
+
+// Rays cast by the last bake, and how long it took
+struct PvsBakeStats {
+    long long rays = 0;
+    long long visiblePairs = 0;
+    double seconds = 0.0;
+};
+
+// ---------- Occluders for baking ----------
+class PvsOccluders {
+public:
+    void addBox(const Aabb& box) { boxes.push_back(box); }
+
+    // A planar convex quad; the corners go round its edge in either direction
+    void addQuad(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d)
+    {
+        quads.insert(quads.end(), { a, b, c, d });
+    }
+
+    int count() const { return static_cast<int>(boxes.size() + quads.size() / 4); }
+
+    // Call once all occluders are added, before blocked()
+    void build()
+    {
+        std::vector<Aabb> bounds = boxes;
+        for (size_t q = 0; q < quads.size(); q += 4) {
+            Aabb quadBounds;
+            for (size_t k = 0; k < 4; ++k) quadBounds.grow(quads[q + k]);
+            bounds.push_back(quadBounds);
+        }
+        bvh.build(bounds);
+    }
+
+    // Whether an occluder lies on the segment strictly between from and to
+    bool blocked(const glm::vec3& from, const glm::vec3& to) const
+    {
+        glm::vec3 dir = to - from;
+        int boxCount = static_cast<int>(boxes.size());
+        return bvh.queryRay(from, dir, 1.0f - PVS_RAY_EPSILON, [&](int prim) {
+            if (prim < boxCount) return true;   // the segment crosses the box itself
+            return crossesQuad(&quads[size_t(prim - boxCount) * 4], from, dir);
+        });
+    }
+
+    // The geometry, hashed into a bake's signature; does not need build()
+    uint64_t hash(uint64_t seed) const
+    {
+        for (const Aabb& box : boxes) seed = pvsHash(seed, box);
+        for (const glm::vec3& corner : quads) {
+            const float values[3] = { corner.x, corner.y, corner.z };
+            seed = pvsHash(seed, values, sizeof(values));
+        }
+        const uint64_t counts[2] = { boxes.size(), quads.size() };
+        return pvsHash(seed, counts, sizeof(counts));
+    }
+
+    size_t memoryBytes() const { return vectorBytes(boxes) + vectorBytes(quads) + bvh.memoryBytes(); }
+
+private:
+    std::vector<Aabb> boxes;
+    std::vector<glm::vec3> quads;               // four corners each
+    StaticBvh bvh;                              // boxes first, then the quads' bounds
+
+    static bool crossesQuad(const glm::vec3* corners, const glm::vec3& from, const glm::vec3& dir)
+    {
+        glm::vec3 normal = glm::cross(corners[2] - corners[0], corners[3] - corners[1]);
+        float along = glm::dot(normal, dir);
+        if (along == 0.0f) return false;
+        float t = glm::dot(normal, corners[0] - from) / along;
+        if (t <= PVS_RAY_EPSILON || t >= 1.0f - PVS_RAY_EPSILON) return false;
+        glm::vec3 p = from + dir * t;
+        for (int k = 0; k < 4; ++k) {
+            const glm::vec3& a = corners[k];
+            const glm::vec3& b = corners[(k + 1) % 4];
+            if (glm::dot(glm::cross(b - a, p - a), normal) < 0.0f) return false;
+        }
+        return true;
+    }
+};
+
+// ---------- Visible sets ----------
+class PotentiallyVisibleSet {
+public:
+    // Bake which objects can be seen from anywhere inside each cell, on all cores
+    void bake(const std::vector<Aabb>& cells, const std::vector<Aabb>& objects, const PvsOccluders& occluders)
+    {
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point start = Clock::now();
+        setLayout(cells, objects, occluders);
+
+        std::vector<glm::vec3> cellSamples(cells.size() * PVS_CELL_SAMPLES);
+        std::vector<glm::vec3> objectSamples(objects.size() * PVS_OBJECT_SAMPLES);
+        uint32_t seed = 1;
+        for (size_t c = 0; c < cells.size(); ++c) sampleCell(cells[c], seed, &cellSamples[c * PVS_CELL_SAMPLES]);
+        for (size_t o = 0; o < objects.size(); ++o) sampleBounds(objects[o], seed, &objectSamples[o * PVS_OBJECT_SAMPLES]);
+
+        // One byte per pair while baking: neighbouring objects share a word of the bitsets
+        std::vector<uint8_t> pairVisible(cells.size() * objects.size(), 0);
+        std::atomic<long long> rays{ 0 };
+        int grain = std::max(PVS_BAKE_GRAIN, (objectTotal + PVS_BAKE_MAX_JOBS - 1) / PVS_BAKE_MAX_JOBS);
+        for (size_t cell = 0; cell < cells.size(); ++cell) {
+            Aabb nearCell(cells[cell].min - glm::vec3(PVS_NEAR_DISTANCE), cells[cell].max + glm::vec3(PVS_NEAR_DISTANCE));
+            const glm::vec3* from = &cellSamples[cell * PVS_CELL_SAMPLES];
+            uint8_t* cellVisible = &pairVisible[cell * objects.size()];
+            parallelFor(objectTotal, grain, [&](int begin, int end) {
+                long long cast = 0;
+                for (int object = begin; object < end; ++object) {
+                    bool visible = nearCell.overlaps(objects[object]);
+                    const glm::vec3* to = &objectSamples[size_t(object) * PVS_OBJECT_SAMPLES];
+                    for (int s = 0; s < PVS_CELL_SAMPLES && !visible; ++s) {
+                        for (int t = 0; t < PVS_OBJECT_SAMPLES && !visible; ++t) {
+                            ++cast;
+                            visible = !occluders.blocked(from[s], to[t]);
+                        }
+                    }
+                    cellVisible[object] = visible;
+                }
+                rays += cast;
+            });
+        }
+
+        stats = PvsBakeStats();
+        for (size_t cell = 0; cell < cells.size(); ++cell) {
+            for (int object = 0; object < objectTotal; ++object) {
+                if (!pairVisible[cell * objectTotal + object]) continue;
+                bits[cell * wordsPerCell + object / 64] |= uint64_t(1) << (object % 64);
+                stats.visiblePairs++;
+            }
+        }
+        stats.rays = rays;
+        stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Write the bitsets next to the target and rename, like compiled scenes
+    bool save(const std::string& path) const
+    {
+        PvsFileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "PVSB", 4);
+        header.version = PVS_FILE_VERSION;
+        header.cellCount = static_cast<uint32_t>(cellBounds.size());
+        header.objectCount = static_cast<uint32_t>(objectTotal);
+        header.signature = signature;
+
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+                !file.write(reinterpret_cast<const char*>(bits.data()), bits.size() * sizeof(uint64_t))) {
+                std::cerr << "Failed to write visible sets " << temporaryPath << std::endl;
+                return false;
+            }
+        }
+        std::remove(path.c_str());
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            std::cerr << "Failed to write visible sets " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Read sets baked from exactly these cells, objects and occluders (which need not be
+    // built); false if the file is missing, and false with a message if it is malformed or
+    // was baked from something else
+    bool load(const std::string& path, const std::vector<Aabb>& cells, const std::vector<Aabb>& objects,
+              const PvsOccluders& occluders)
+    {
+        clear();
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        setLayout(cells, objects, occluders);
+        PvsFileHeader header;
+        bool valid = bytes.size() == sizeof(header) + bits.size() * sizeof(uint64_t);
+        if (valid) {
+            std::memcpy(&header, bytes.data(), sizeof(header));
+            valid = std::memcmp(header.magic, "PVSB", 4) == 0 && header.version == PVS_FILE_VERSION &&
+                    header.cellCount == cells.size() && header.objectCount == objects.size() &&
+                    header.signature == signature;
+        }
+        if (!valid) {
+            std::cerr << "Visible sets " << path << " are invalid or were baked for another scene" << std::endl;
+            clear();
+            return false;
+        }
+        std::memcpy(bits.data(), bytes.data() + sizeof(header), bits.size() * sizeof(uint64_t));
+        return true;
+    }
+
+    void clear()
+    {
+        cellBounds.clear();
+        bits.clear();
+        objectTotal = 0;
+        wordsPerCell = 0;
+        signature = 0;
+    }
+
+    bool empty() const { return cellBounds.empty(); }
+
+    // First cell that contains the point, or -1 when it is outside all of them
+    int cellAt(const glm::vec3& point) const
+    {
+        for (size_t c = 0; c < cellBounds.size(); ++c) {
+            const Aabb& b = cellBounds[c];
+            if (point.x >= b.min.x && point.y >= b.min.y && point.z >= b.min.z &&
+                point.x <= b.max.x && point.y <= b.max.y && point.z <= b.max.z)
+                return static_cast<int>(c);
+        }
+        return -1;
+    }
+
+    bool visible(int cell, int object) const
+    {
+        return (bits[size_t(cell) * wordsPerCell + object / 64] >> (object % 64)) & 1;
+    }
+
+    // Objects potentially visible from a cell
+    int visibleCount(int cell) const
+    {
+        int count = 0;
+        for (int w = 0; w < wordsPerCell; ++w) {
+            uint64_t word = bits[size_t(cell) * wordsPerCell + w];
+            for (; word; word &= word - 1) ++count;
+        }
+        return count;
+    }
+
+    int cellCount() const { return static_cast<int>(cellBounds.size()); }
+    int objectCount() const { return objectTotal; }
+    const PvsBakeStats& bakeStats() const { return stats; }
+
+    size_t memoryBytes() const { return vectorBytes(cellBounds) + vectorBytes(bits); }
+
+private:
+    std::vector<Aabb> cellBounds;
+    std::vector<uint64_t> bits;                 // wordsPerCell words per cell, bit i for object i
+    int objectTotal = 0;
+    int wordsPerCell = 0;
+    uint64_t signature = 0;
+    PvsBakeStats stats;
+
+    void setLayout(const std::vector<Aabb>& cells, const std::vector<Aabb>& objects, const PvsOccluders& occluders)
+    {
+        cellBounds = cells;
+        objectTotal = static_cast<int>(objects.size());
+        wordsPerCell = (objectTotal + 63) / 64;
+        bits.assign(cells.size() * wordsPerCell, 0);
+        signature = signatureOf(cells, objects, occluders);
+    }
+
+    // Everything the bitsets depend on; the cell and object counts are in the header
+    static uint64_t signatureOf(const std::vector<Aabb>& cells, const std::vector<Aabb>& objects, const PvsOccluders& occluders)
+    {
+        const float parameters[6] = { float(PVS_CELL_GRID), float(PVS_CELL_LAYERS), float(PVS_FACE_SAMPLES),
+                                      PVS_NEAR_DISTANCE, PVS_RAY_EPSILON, float(PVS_FILE_VERSION) };
+        uint64_t hash = pvsHash(14695981039346656037ull, parameters, sizeof(parameters));
+        for (const Aabb& box : cells) hash = pvsHash(hash, box);
+        for (const Aabb& box : objects) hash = pvsHash(hash, box);
+        return occluders.hash(hash);
+    }
+
+    // Uniform in [0, 1) from a linear congruential sequence, so bakes are repeatable
+    static float random(uint32_t& seed)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // One jittered point in every cell of a PVS_CELL_GRID x PVS_CELL_LAYERS x PVS_CELL_GRID grid
+    static void sampleCell(const Aabb& cell, uint32_t& seed, glm::vec3* out)
+    {
+        glm::vec3 size = cell.max - cell.min;
+        for (int y = 0; y < PVS_CELL_LAYERS; ++y)
+            for (int z = 0; z < PVS_CELL_GRID; ++z)
+                for (int x = 0; x < PVS_CELL_GRID; ++x)
+                    *out++ = cell.min + size * glm::vec3((x + random(seed)) / PVS_CELL_GRID,
+                                                         (y + random(seed)) / PVS_CELL_LAYERS,
+                                                         (z + random(seed)) / PVS_CELL_GRID);
+    }
+
+    // Corners, face centres, then PVS_FACE_SAMPLES random points on every face
+    static void sampleBounds(const Aabb& box, uint32_t& seed, glm::vec3* out)
+    {
+        glm::vec3 size = box.max - box.min;
+        for (int k = 0; k < 8; ++k)
+            *out++ = box.min + size * glm::vec3(k & 1, (k >> 1) & 1, (k >> 2) & 1);
+        for (int face = 0; face < 6; ++face) {
+            glm::vec3 f(0.5f);
+            f[face / 2] = float(face % 2);
+            *out++ = box.min + size * f;
+        }
+        for (int face = 0; face < 6; ++face) {
+            for (int s = 0; s < PVS_FACE_SAMPLES; ++s) {
+                glm::vec3 f(random(seed), random(seed), random(seed));
+                f[face / 2] = float(face % 2);
+                *out++ = box.min + size * f;
+            }
+        }
+    }
+};
+
+// Cells around the boxes the camera moves through (such as track chunks): margin metres
+// out to every side and below, height metres above
+inline std::vector<Aabb> pvsCellsAround(const std::vector<Aabb>& areas, float margin, float height)
+{
+    std::vector<Aabb> cells;
+    for (const Aabb& area : areas)
+        cells.push_back(Aabb(area.min - glm::vec3(margin), area.max + glm::vec3(margin, height, margin)));
+    return cells;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <iostream>
+#include <string>
+#include "GlState.h"
+#include "ResourceRegistry.h"
+
+// Offscreen framebuffer: an RGBA8 colour texture (so it can be sampled afterwards) and a
+// 24-bit depth renderbuffer of the same size. Every object is registered with
+// resources() under the given owner. Main thread only. create() can run in the middle of a
+// frame (dynamic resolution resizes), so its texture binds go through Engine/GlState.h.
+
+struct RenderTarget {
+    GLuint framebuffer = 0;
+    GLuint color = 0;                   // GL_TEXTURE_2D, linear filtering, clamped
+    GLuint depth = 0;
+    int width = 0, height = 0;
+
+    // False (with a message) if the framebuffer is incomplete; the target is then empty
+    bool create(int targetWidth, int targetHeight, const std::string& owner)
+    {
+        destroy();
+        width = targetWidth;
+        height = targetHeight;
+
+        glGenTextures(1, &color);
+        glsBindTexture(GL_TEXTURE_2D, color);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glsBindTexture(GL_TEXTURE_2D, 0);
+        resources().trackGpu(GPU_TEXTURE, color, size_t(width) * height * 4, owner);
+
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        resources().trackGpu(GPU_RENDERBUFFER, depth, size_t(width) * height * 4, owner);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        resources().trackGpu(GPU_FRAMEBUFFER, framebuffer, 0, owner);
+
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Render target " << owner << " (" << width << "x" << height << ") is incomplete: 0x"
+                      << std::hex << status << std::dec << std::endl;
+            destroy();
+            return false;
+        }
+        return true;
+    }
+
+    void destroy()
+    {
+        resources().releaseGpu(GPU_FRAMEBUFFER, framebuffer);
+        resources().releaseGpu(GPU_RENDERBUFFER, depth);
+        resources().releaseGpu(GPU_TEXTURE, color);
+        if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+        if (depth) glDeleteRenderbuffers(1, &depth);
+        if (color) glDeleteTextures(1, &color);
+        framebuffer = color = depth = 0;
+        width = height = 0;
+    }
+
+    bool valid() const { return framebuffer != 0; }
+};
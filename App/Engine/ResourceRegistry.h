@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Memory accounting: every GL buffer, texture, vertex array, renderbuffer and framebuffer
+// with its size and the asset that owns it, plus the CPU footprint of each subsystem.
+//
+// GL objects are registered by the code that creates them (trackGpu() again when a
+// buffer's storage is re-specified) and released by the code that deletes them, so
+// anything still registered at shutdown is a leak. CPU subsystems register a callback
+// that returns their current footprint (container capacities, rings, mapped files); the
+// report calls them, so the numbers are current whenever it is printed. Callbacks must
+// stay valid until the last report. Main thread only.
+//
+// Nothing here calls GL.
+
+enum GpuResourceKind {
+    GPU_BUFFER,
+    GPU_TEXTURE,
+    GPU_VERTEX_ARRAY,
+    GPU_RENDERBUFFER,
+    GPU_FRAMEBUFFER
+};
+
+inline const char* gpuResourceKindName(GpuResourceKind kind)
+{
+    switch (kind) {
+    case GPU_BUFFER:       return "buffer";
+    case GPU_TEXTURE:      return "texture";
+    case GPU_VERTEX_ARRAY: return "vertex array";
+    case GPU_RENDERBUFFER: return "renderbuffer";
+    case GPU_FRAMEBUFFER:  return "framebuffer";
+    default:               return "object";
+    }
+}
+
+// Heap bytes held by a vector
+template <class T>
+size_t vectorBytes(const std::vector<T>& values)
+{
+    return values.capacity() * sizeof(T);
+}
+
+inline std::string formatBytes(size_t bytes)
+{
+    char text[32];
+    if (bytes >= 1024 * 1024) snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024.0));
+    else if (bytes >= 1024) snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+    else snprintf(text, sizeof(text), "%d B", static_cast<int>(bytes));
+    return text;
+}
+
+class ResourceRegistry {
+public:
+    // A GL object was created, or its storage re-specified
+    void trackGpu(GpuResourceKind kind, uint32_t id, size_t bytes, const std::string& owner)
+    {
+        GpuResource& resource = gpu[key(kind, id)];
+        resource.kind = kind;
+        resource.id = id;
+        resource.bytes = bytes;
+        if (!owner.empty() || resource.owner.empty()) resource.owner = owner;
+    }
+
+    // New size for a tracked object, keeping its owner
+    void resizeGpu(GpuResourceKind kind, uint32_t id, size_t bytes)
+    {
+        auto found = gpu.find(key(kind, id));
+        if (found != gpu.end()) found->second.bytes = bytes;
+    }
+
+    // A GL object was deleted
+    void releaseGpu(GpuResourceKind kind, uint32_t id)
+    {
+        if (id == 0) return;
+        if (gpu.erase(key(kind, id)) == 0)
+            std::cerr << "Deleting untracked GL " << gpuResourceKindName(kind) << " " << id << std::endl;
+    }
+
+    void trackCpu(const std::string& subsystem, std::function<size_t()> bytes)
+    {
+        cpu.push_back({ subsystem, bytes });
+    }
+
+    size_t gpuBytes() const
+    {
+        size_t total = 0;
+        for (const auto& entry : gpu) total += entry.second.bytes;
+        return total;
+    }
+
+    // Size of one tracked object, 0 if it is not tracked
+    size_t gpuBytes(GpuResourceKind kind, uint32_t id) const
+    {
+        auto found = gpu.find(key(kind, id));
+        return found != gpu.end() ? found->second.bytes : 0;
+    }
+
+    // GPU memory by owner, then CPU memory by subsystem, largest first
+    void printReport(const std::string& title) const
+    {
+        struct Line {
+            std::string name;
+            size_t bytes;
+            int objects;
+        };
+        std::vector<Line> lines;
+        std::unordered_map<std::string, size_t> lineByOwner;
+        for (const auto& entry : gpu) {
+            const GpuResource& resource = entry.second;
+            auto found = lineByOwner.find(resource.owner);
+            if (found == lineByOwner.end()) {
+                found = lineByOwner.emplace(resource.owner, lines.size()).first;
+                lines.push_back({ resource.owner.empty() ? "(no owner)" : resource.owner, 0, 0 });
+            }
+            lines[found->second].bytes += resource.bytes;
+            ++lines[found->second].objects;
+        }
+        auto largestFirst = [](const Line& a, const Line& b) { return a.bytes != b.bytes ? a.bytes > b.bytes : a.name < b.name; };
+        std::sort(lines.begin(), lines.end(), largestFirst);
+
+        std::cout << "Memory (" << title << ")" << std::endl;
+        std::cout << "  GPU " << formatBytes(gpuBytes()) << " in " << gpu.size() << " objects" << std::endl;
+        for (const Line& line : lines)
+            std::cout << "    " << padded(formatBytes(line.bytes)) << line.name << " (" << line.objects
+                      << (line.objects == 1 ? " object)" : " objects)") << std::endl;
+
+        std::vector<Line> cpuLines;
+        size_t cpuTotal = 0;
+        for (const CpuSubsystem& subsystem : cpu) {
+            size_t bytes = subsystem.bytes();
+            cpuLines.push_back({ subsystem.name, bytes, 0 });
+            cpuTotal += bytes;
+        }
+        std::sort(cpuLines.begin(), cpuLines.end(), largestFirst);
+        std::cout << "  CPU " << formatBytes(cpuTotal) << " in tracked subsystems" << std::endl;
+        for (const Line& line : cpuLines)
+            std::cout << "    " << padded(formatBytes(line.bytes)) << line.name << std::endl;
+    }
+
+    // Print every GL object still registered as an error; returns how many there are
+    int reportLeaks() const
+    {
+        for (const auto& entry : gpu) {
+            const GpuResource& resource = entry.second;
+            std::cerr << "ERROR: leaked GL " << gpuResourceKindName(resource.kind) << " " << resource.id << " ("
+                      << (resource.owner.empty() ? "no owner" : resource.owner) << ", " << formatBytes(resource.bytes)
+                      << ")" << std::endl;
+        }
+        return static_cast<int>(gpu.size());
+    }
+
+private:
+    struct GpuResource {
+        GpuResourceKind kind;
+        uint32_t id;
+        size_t bytes;
+        std::string owner;
+    };
+
+    struct CpuSubsystem {
+        std::string name;
+        std::function<size_t()> bytes;
+    };
+
+    std::unordered_map<uint64_t, GpuResource> gpu;
+    std::vector<CpuSubsystem> cpu;
+
+    static uint64_t key(GpuResourceKind kind, uint32_t id) { return (uint64_t(kind) << 32) | id; }
+
+    static std::string padded(const std::string& text)
+    {
+        return std::string(text.size() < 10 ? 10 - text.size() : 1, ' ') + text + "  ";
+    }
+};
+
+// Process-wide registry
+inline ResourceRegistry& resources()
+{
+    static ResourceRegistry instance;
+    return instance;
+}
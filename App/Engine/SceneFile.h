@@ -0,0 +1,492 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Scene description: meshes, materials, static instances, cloud billboards, the track and
+// occluders.
+//
+// Scenes are authored as text (.scene) and compiled to a binary file (.sceneb) made of
+// fixed-size records. The binary is mapped into memory and used where it lies: the
+// loader checks the header and the record indices and hands out pointers into the
+// mapping, so load time does not depend on parsing however many instances the track
+// has. loadScene() recompiles the binary whenever the text is newer.
+//
+// Text format, one record per line ('#' starts a comment, quote paths with spaces):
+//     mesh      <name> <model path>
+//     material  <name> <texture path>
+//     instance  <mesh> <material> <x> <y> <z> [yaw <degrees>] [scale <s> | scale <sx> <sy> <sz>] [uv <scale>]
+//     billboard <material> <x> <y> <z> [scale <s>] [speed <units/s>]
+//     track     <x> <y> <z>
+//     occluder  <mesh> <x0> <y0> <z0> <x1> <y1> <z1> <x2> <y2> <z2> <x3> <y3> <z3>
+// Names must be declared before use. Track records are the control points of the closed
+// track centreline, in driving order (see Engine/TrackMesh.h). An instance's model matrix is
+// translate * rotate(yaw about +y) * scale, the order the scenery always used. Occluders
+// are planar quads in the mesh's model space, corners in order round the edge, that lie
+// inside the mesh's solid parts; every instance of the mesh hides what is behind them
+// (see Engine/OcclusionCulling.h).
+
+const uint32_t SCENE_FILE_VERSION = 4;
+const int SCENE_PATH_BYTES = 120;           // including the terminating zero
+const int SCENE_NAME_BYTES = 32;
+
+struct SceneMesh {
+    char name[SCENE_NAME_BYTES];            // as declared, for labelling draws and timings
+    char path[SCENE_PATH_BYTES];
+};
+
+struct SceneMaterial {
+    char texture[SCENE_PATH_BYTES];
+};
+
+struct SceneInstance {
+    uint32_t mesh;
+    uint32_t material;
+    float uvScale;
+    float padding;
+    float model[16];                        // column-major, like glm::mat4
+
+    glm::mat4 modelMatrix() const
+    {
+        glm::mat4 m;
+        std::memcpy(&m[0][0], model, sizeof(model));
+        return m;
+    }
+};
+
+struct SceneBillboard {
+    uint32_t material;
+    float position[3];
+    float scale;
+    float speed;
+};
+
+struct SceneTrackPoint {
+    float position[3];
+    float padding;
+};
+
+struct SceneOccluder {
+    uint32_t mesh;
+    float padding[3];
+    float corners[12];                      // four model-space corners
+};
+
+struct SceneFileHeader {
+    char magic[4];                          // "SCNB"
+    uint32_t version;
+    uint32_t meshCount, materialCount, instanceCount, billboardCount;
+    uint32_t trackPointCount, occluderCount;
+    uint64_t meshOffset, materialOffset, instanceOffset, billboardOffset, trackPointOffset, occluderOffset;
+};
+
+// ---------- Text -> binary ----------
+namespace scenefile_detail {
+
+// Whitespace-separated tokens; "quoted tokens" may contain spaces; '#' ends the line
+inline std::vector<std::string> tokenize(const std::string& line)
+{
+    std::vector<std::string> tokens;
+    size_t i = 0;
+    while (i < line.size()) {
+        char c = line[i];
+        if (c == '#') break;
+        if (c == ' ' || c == '\t' || c == '\r') { ++i; continue; }
+        std::string token;
+        if (c == '"') {
+            size_t end = line.find('"', i + 1);
+            if (end == std::string::npos) end = line.size();
+            token = line.substr(i + 1, end - i - 1);
+            i = end + 1;
+        } else {
+            while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r' && line[i] != '#')
+                token += line[i++];
+        }
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+inline bool parseNumber(const std::string& token, float& value)
+{
+    if (token.empty()) return false;
+    char* end = nullptr;
+    value = strtof(token.c_str(), &end);
+    return end && *end == '\0';
+}
+
+inline void copyPath(char* destination, const std::string& path)
+{
+    std::memset(destination, 0, SCENE_PATH_BYTES);
+    std::strncpy(destination, path.c_str(), SCENE_PATH_BYTES - 1);
+}
+
+inline uint64_t alignOffset(uint64_t offset) { return (offset + 15) & ~uint64_t(15); }
+
+} // namespace scenefile_detail
+
+// Parse a text scene into records. Errors go to std::cerr as "file:line: message".
+inline bool parseSceneText(const std::string& textPath, std::vector<SceneMesh>& meshes, std::vector<SceneMaterial>& materials,
+                           std::vector<SceneInstance>& instances, std::vector<SceneBillboard>& billboards,
+                           std::vector<SceneTrackPoint>& trackPoints, std::vector<SceneOccluder>& occluders)
+{
+    using namespace scenefile_detail;
+    std::ifstream file(textPath);
+    if (!file) {
+        std::cerr << "Failed to open scene " << textPath << std::endl;
+        return false;
+    }
+
+    std::map<std::string, uint32_t> meshByName, materialByName;
+    std::string line;
+    int lineNumber = 0;
+    bool ok = true;
+    auto fail = [&](const std::string& message) {
+        std::cerr << textPath << ":" << lineNumber << ": " << message << std::endl;
+        ok = false;
+    };
+
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        std::vector<std::string> t = tokenize(line);
+        if (t.empty()) continue;
+
+        if (t[0] == "mesh" || t[0] == "material") {
+            if (t.size() != 3) { fail("expected: " + t[0] + " <name> <path>"); continue; }
+            if (t[2].size() >= static_cast<size_t>(SCENE_PATH_BYTES)) { fail("path too long: " + t[2]); continue; }
+            if (t[0] == "mesh") {
+                if (t[1].size() >= static_cast<size_t>(SCENE_NAME_BYTES)) { fail("mesh name too long: " + t[1]); continue; }
+                SceneMesh mesh;
+                std::memset(mesh.name, 0, SCENE_NAME_BYTES);
+                std::strncpy(mesh.name, t[1].c_str(), SCENE_NAME_BYTES - 1);
+                copyPath(mesh.path, t[2]);
+                meshByName[t[1]] = static_cast<uint32_t>(meshes.size());
+                meshes.push_back(mesh);
+            } else {
+                SceneMaterial material;
+                copyPath(material.texture, t[2]);
+                materialByName[t[1]] = static_cast<uint32_t>(materials.size());
+                materials.push_back(material);
+            }
+        } else if (t[0] == "instance" || t[0] == "billboard") {
+            bool isInstance = t[0] == "instance";
+            size_t first = isInstance ? 3 : 2;        // index of x
+            if (t.size() < first + 3) { fail("missing position"); continue; }
+            if (isInstance && !meshByName.count(t[1])) { fail("unknown mesh " + t[1]); continue; }
+            const std::string& materialName = isInstance ? t[2] : t[1];
+            if (!materialByName.count(materialName)) { fail("unknown material " + materialName); continue; }
+
+            glm::vec3 position, scale(1.0f);
+            float yaw = 0.0f, uvScale = 1.0f, speed = 0.0f;
+            bool valid = parseNumber(t[first], position.x) && parseNumber(t[first + 1], position.y) &&
+                         parseNumber(t[first + 2], position.z);
+            for (size_t k = first + 3; valid && k < t.size(); k += 2) {
+                float value;
+                if (k + 1 >= t.size() || !parseNumber(t[k + 1], value)) { valid = false; break; }
+                if (t[k] == "scale") {
+                    float sy, sz;
+                    if (isInstance && k + 3 < t.size() && parseNumber(t[k + 2], sy) && parseNumber(t[k + 3], sz)) {
+                        scale = glm::vec3(value, sy, sz);
+                        k += 2;
+                    } else {
+                        scale = glm::vec3(value);
+                    }
+                } else if (isInstance && t[k] == "yaw") yaw = value;
+                else if (isInstance && t[k] == "uv") uvScale = value;
+                else if (!isInstance && t[k] == "speed") speed = value;
+                else valid = false;
+            }
+            if (!valid) { fail("bad " + t[0] + " fields"); continue; }
+
+            if (isInstance) {
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), position) *
+                                  glm::rotate(glm::mat4(1.0f), glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f)) *
+                                  glm::scale(glm::mat4(1.0f), scale);
+                SceneInstance instance;
+                instance.mesh = meshByName[t[1]];
+                instance.material = materialByName[t[2]];
+                instance.uvScale = uvScale;
+                instance.padding = 0.0f;
+                std::memcpy(instance.model, &model[0][0], sizeof(instance.model));
+                instances.push_back(instance);
+            } else {
+                SceneBillboard billboard;
+                billboard.material = materialByName[t[1]];
+                billboard.position[0] = position.x;
+                billboard.position[1] = position.y;
+                billboard.position[2] = position.z;
+                billboard.scale = scale.x;
+                billboard.speed = speed;
+                billboards.push_back(billboard);
+            }
+        } else if (t[0] == "track") {
+            SceneTrackPoint point;
+            if (t.size() != 4 || !parseNumber(t[1], point.position[0]) || !parseNumber(t[2], point.position[1]) ||
+                !parseNumber(t[3], point.position[2])) {
+                fail("expected: track <x> <y> <z>");
+                continue;
+            }
+            point.padding = 0.0f;
+            trackPoints.push_back(point);
+        } else if (t[0] == "occluder") {
+            if (t.size() != 14) { fail("expected: occluder <mesh> and four corners"); continue; }
+            if (!meshByName.count(t[1])) { fail("unknown mesh " + t[1]); continue; }
+            SceneOccluder occluder;
+            std::memset(&occluder, 0, sizeof(occluder));
+            occluder.mesh = meshByName[t[1]];
+            bool valid = true;
+            for (int k = 0; k < 12; ++k) valid = valid && parseNumber(t[2 + k], occluder.corners[k]);
+            if (!valid) { fail("bad occluder corners"); continue; }
+            occluders.push_back(occluder);
+        } else {
+            fail("unknown record " + t[0]);
+        }
+    }
+    return ok;
+}
+
+// Compile a text scene to the binary form
+inline bool compileScene(const std::string& textPath, const std::string& binaryPath)
+{
+    using namespace scenefile_detail;
+    std::vector<SceneMesh> meshes;
+    std::vector<SceneMaterial> materials;
+    std::vector<SceneInstance> instances;
+    std::vector<SceneBillboard> billboards;
+    std::vector<SceneTrackPoint> trackPoints;
+    std::vector<SceneOccluder> occluders;
+    if (!parseSceneText(textPath, meshes, materials, instances, billboards, trackPoints, occluders)) return false;
+
+    SceneFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "SCNB", 4);
+    header.version = SCENE_FILE_VERSION;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.materialCount = static_cast<uint32_t>(materials.size());
+    header.instanceCount = static_cast<uint32_t>(instances.size());
+    header.billboardCount = static_cast<uint32_t>(billboards.size());
+    header.trackPointCount = static_cast<uint32_t>(trackPoints.size());
+    header.occluderCount = static_cast<uint32_t>(occluders.size());
+    header.meshOffset = alignOffset(sizeof(header));
+    header.materialOffset = alignOffset(header.meshOffset + meshes.size() * sizeof(SceneMesh));
+    header.instanceOffset = alignOffset(header.materialOffset + materials.size() * sizeof(SceneMaterial));
+    header.billboardOffset = alignOffset(header.instanceOffset + instances.size() * sizeof(SceneInstance));
+    header.trackPointOffset = alignOffset(header.billboardOffset + billboards.size() * sizeof(SceneBillboard));
+    header.occluderOffset = alignOffset(header.trackPointOffset + trackPoints.size() * sizeof(SceneTrackPoint));
+    uint64_t size = header.occluderOffset + occluders.size() * sizeof(SceneOccluder);
+
+    std::vector<uint8_t> bytes(size, 0);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    if (!meshes.empty()) std::memcpy(&bytes[header.meshOffset], meshes.data(), meshes.size() * sizeof(SceneMesh));
+    if (!materials.empty()) std::memcpy(&bytes[header.materialOffset], materials.data(), materials.size() * sizeof(SceneMaterial));
+    if (!instances.empty()) std::memcpy(&bytes[header.instanceOffset], instances.data(), instances.size() * sizeof(SceneInstance));
+    if (!billboards.empty()) std::memcpy(&bytes[header.billboardOffset], billboards.data(), billboards.size() * sizeof(SceneBillboard));
+    if (!trackPoints.empty()) std::memcpy(&bytes[header.trackPointOffset], trackPoints.data(), trackPoints.size() * sizeof(SceneTrackPoint));
+    if (!occluders.empty()) std::memcpy(&bytes[header.occluderOffset], occluders.data(), occluders.size() * sizeof(SceneOccluder));
+
+    // Write next to the target and rename, so a mapped old copy is never overwritten in place
+    std::string temporaryPath = binaryPath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size())) {
+            std::cerr << "Failed to write compiled scene " << temporaryPath << std::endl;
+            return false;
+        }
+    }
+    std::remove(binaryPath.c_str());
+    if (std::rename(temporaryPath.c_str(), binaryPath.c_str()) != 0) {
+        std::cerr << "Failed to write compiled scene " << binaryPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// ---------- Binary scene, mapped ----------
+class SceneFile {
+public:
+    SceneFile() {}
+    ~SceneFile() { close(); }
+    SceneFile(const SceneFile&) = delete;
+    SceneFile& operator=(const SceneFile&) = delete;
+
+    // Map a compiled scene; false (with a message) if it is missing or malformed
+    bool open(const std::string& binaryPath)
+    {
+        close();
+        if (!mapFile(binaryPath)) return false;
+        if (!validate()) {
+            std::cerr << "Compiled scene " << binaryPath << " is invalid or from another version" << std::endl;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#ifndef _WIN32
+        if (mapping) munmap(mapping, size);
+#endif
+        mapping = nullptr;
+        buffer.clear();
+        data = nullptr;
+        size = 0;
+        header = nullptr;
+    }
+
+    bool isOpen() const { return header != nullptr; }
+
+    // Bytes mapped (or read) from the compiled file
+    size_t fileBytes() const { return size; }
+
+    int meshCount() const { return header ? static_cast<int>(header->meshCount) : 0; }
+    int materialCount() const { return header ? static_cast<int>(header->materialCount) : 0; }
+    int instanceCount() const { return header ? static_cast<int>(header->instanceCount) : 0; }
+    int billboardCount() const { return header ? static_cast<int>(header->billboardCount) : 0; }
+    int trackPointCount() const { return header ? static_cast<int>(header->trackPointCount) : 0; }
+    int occluderCount() const { return header ? static_cast<int>(header->occluderCount) : 0; }
+
+    const SceneMesh* meshes() const { return section<SceneMesh>(header->meshOffset); }
+    const SceneMaterial* materials() const { return section<SceneMaterial>(header->materialOffset); }
+    const SceneInstance* instances() const { return section<SceneInstance>(header->instanceOffset); }
+    const SceneBillboard* billboards() const { return section<SceneBillboard>(header->billboardOffset); }
+    const SceneTrackPoint* trackPoints() const { return section<SceneTrackPoint>(header->trackPointOffset); }
+    const SceneOccluder* occluders() const { return section<SceneOccluder>(header->occluderOffset); }
+
+private:
+    void* mapping = nullptr;                // mmap'ed file
+    std::vector<uint8_t> buffer;            // file read into memory where mmap is not available
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    const SceneFileHeader* header = nullptr;
+
+    template <class T>
+    const T* section(uint64_t offset) const { return reinterpret_cast<const T*>(data + offset); }
+
+    bool mapFile(const std::string& path)
+    {
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+        size = static_cast<size_t>(info.st_size);
+        void* bytes = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (bytes == MAP_FAILED) {
+            size = 0;
+            return false;
+        }
+        mapping = bytes;
+        data = static_cast<const uint8_t*>(bytes);
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+#endif
+        return true;
+    }
+
+    bool sectionFits(uint64_t offset, uint64_t count, size_t recordSize) const
+    {
+        return offset % 16 == 0 && offset <= size && count <= (size - offset) / recordSize;
+    }
+
+    static bool terminated(const char* text, size_t bytes) { return std::memchr(text, 0, bytes) != nullptr; }
+
+    // Header, index and string terminator checks only; the records themselves are used as they are
+    bool validate()
+    {
+        if (size < sizeof(SceneFileHeader)) return false;
+        const SceneFileHeader* h = reinterpret_cast<const SceneFileHeader*>(data);
+        if (std::memcmp(h->magic, "SCNB", 4) != 0 || h->version != SCENE_FILE_VERSION) return false;
+        if (!sectionFits(h->meshOffset, h->meshCount, sizeof(SceneMesh)) ||
+            !sectionFits(h->materialOffset, h->materialCount, sizeof(SceneMaterial)) ||
+            !sectionFits(h->instanceOffset, h->instanceCount, sizeof(SceneInstance)) ||
+            !sectionFits(h->billboardOffset, h->billboardCount, sizeof(SceneBillboard)) ||
+            !sectionFits(h->trackPointOffset, h->trackPointCount, sizeof(SceneTrackPoint)) ||
+            !sectionFits(h->occluderOffset, h->occluderCount, sizeof(SceneOccluder)))
+            return false;
+        header = h;
+        for (int i = 0; i < meshCount(); ++i)
+            if (!terminated(meshes()[i].name, SCENE_NAME_BYTES) || !terminated(meshes()[i].path, SCENE_PATH_BYTES)) return false;
+        for (int i = 0; i < materialCount(); ++i)
+            if (!terminated(materials()[i].texture, SCENE_PATH_BYTES)) return false;
+        for (int i = 0; i < instanceCount(); ++i)
+            if (instances()[i].mesh >= h->meshCount || instances()[i].material >= h->materialCount) return false;
+        for (int i = 0; i < billboardCount(); ++i)
+            if (billboards()[i].material >= h->materialCount) return false;
+        for (int i = 0; i < occluderCount(); ++i)
+            if (occluders()[i].mesh >= h->meshCount) return false;
+        return true;
+    }
+};
+
+// Calls quad(a, b, c, d) with the world-space corners of every occluder on every instance
+// of its mesh
+template <typename Quad>
+void forEachSceneOccluder(const SceneFile& scene, Quad quad)
+{
+    for (int i = 0; i < scene.instanceCount(); ++i) {
+        const SceneInstance& instance = scene.instances()[i];
+        glm::mat4 model = instance.modelMatrix();
+        for (int o = 0; o < scene.occluderCount(); ++o) {
+            const SceneOccluder& occluder = scene.occluders()[o];
+            if (occluder.mesh != instance.mesh) continue;
+            glm::vec3 corners[4];
+            for (int k = 0; k < 4; ++k) {
+                const float* c = &occluder.corners[k * 3];
+                corners[k] = glm::vec3(model * glm::vec4(c[0], c[1], c[2], 1.0f));
+            }
+            quad(corners[0], corners[1], corners[2], corners[3]);
+        }
+    }
+}
+
+inline bool fileModifiedTime(const std::string& path, time_t& modified)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return false;
+    modified = info.st_mtime;
+    return true;
+}
+
+// Open the compiled form of a text scene (textPath + "b"), compiling it first when it
+// is missing, older than the text, or unreadable. Works with only the binary present.
+inline bool loadScene(const std::string& textPath, SceneFile& scene)
+{
+    std::string binaryPath = textPath + "b";
+    time_t textTime = 0, binaryTime = 0;
+    bool haveText = fileModifiedTime(textPath, textTime);
+    bool haveBinary = fileModifiedTime(binaryPath, binaryTime);
+
+    if (haveBinary && (!haveText || binaryTime >= textTime) && scene.open(binaryPath)) return true;
+    if (!haveText) {
+        std::cerr << "Scene " << textPath << " not found" << std::endl;
+        return false;
+    }
+    return compileScene(textPath, binaryPath) && scene.open(binaryPath);
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Minimal 4-wide float SIMD wrapper used by the batched solvers.
+//
+// SSE2 on x86-64, NEON on Apple Silicon / arm64, plain scalar code everywhere else
+// (or when SIMD_FORCE_SCALAR is defined, handy for checking results).
+// Comparisons return lane masks (all bits set / clear) stored as f32x4.
+
+#if !defined(SIMD_FORCE_SCALAR) && (defined(__SSE2__) || defined(_M_X64))
+    #define SIMD_SSE2 1
+    #include <emmintrin.h>
+#elif !defined(SIMD_FORCE_SCALAR) && defined(__ARM_NEON) && defined(__aarch64__)
+    #define SIMD_NEON 1
+    #include <arm_neon.h>
+#else
+    #define SIMD_SCALAR 1
+#endif
+
+inline const char* simdPathName()
+{
+#if defined(SIMD_SSE2)
+    return "SSE2";
+#elif defined(SIMD_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+struct f32x4 {
+#if defined(SIMD_SSE2)
+    __m128 v;
+    f32x4() {}
+    f32x4(__m128 x) : v(x) {}
+    explicit f32x4(float s) : v(_mm_set1_ps(s)) {}
+    static f32x4 load(const float* p) { return _mm_loadu_ps(p); }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+#elif defined(SIMD_NEON)
+    float32x4_t v;
+    f32x4() {}
+    f32x4(float32x4_t x) : v(x) {}
+    explicit f32x4(float s) : v(vdupq_n_f32(s)) {}
+    static f32x4 load(const float* p) { return vld1q_f32(p); }
+    void store(float* p) const { vst1q_f32(p, v); }
+#else
+    float v[4];
+    f32x4() {}
+    explicit f32x4(float s) { v[0] = v[1] = v[2] = v[3] = s; }
+    static f32x4 load(const float* p) { f32x4 r; std::memcpy(r.v, p, sizeof(r.v)); return r; }
+    void store(float* p) const { std::memcpy(p, v, sizeof(v)); }
+#endif
+};
+
+#if defined(SIMD_SSE2)
+
+inline f32x4 operator+(f32x4 a, f32x4 b) { return _mm_add_ps(a.v, b.v); }
+inline f32x4 operator-(f32x4 a, f32x4 b) { return _mm_sub_ps(a.v, b.v); }
+inline f32x4 operator*(f32x4 a, f32x4 b) { return _mm_mul_ps(a.v, b.v); }
+inline f32x4 operator/(f32x4 a, f32x4 b) { return _mm_div_ps(a.v, b.v); }
+inline f32x4 operator-(f32x4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+inline f32x4 simdMin(f32x4 a, f32x4 b) { return _mm_min_ps(a.v, b.v); }
+inline f32x4 simdMax(f32x4 a, f32x4 b) { return _mm_max_ps(a.v, b.v); }
+inline f32x4 simdAbs(f32x4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+inline f32x4 simdSqrt(f32x4 a) { return _mm_sqrt_ps(a.v); }
+inline f32x4 simdGreater(f32x4 a, f32x4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline f32x4 simdLess(f32x4 a, f32x4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline f32x4 simdAnd(f32x4 a, f32x4 b) { return _mm_and_ps(a.v, b.v); }
+inline f32x4 simdOr(f32x4 a, f32x4 b) { return _mm_or_ps(a.v, b.v); }
+// mask ? a : b
+inline f32x4 simdSelect(f32x4 mask, f32x4 a, f32x4 b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+// Round to nearest integer (|x| < 2^31)
+inline f32x4 simdRound(f32x4 a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)); }
+inline f32x4 simdCopySign(f32x4 magnitude, f32x4 sign)
+{
+    __m128 signBit = _mm_set1_ps(-0.0f);
+    return _mm_or_ps(_mm_andnot_ps(signBit, magnitude.v), _mm_and_ps(signBit, sign.v));
+}
+
+#elif defined(SIMD_NEON)
+
+inline f32x4 operator+(f32x4 a, f32x4 b) { return vaddq_f32(a.v, b.v); }
+inline f32x4 operator-(f32x4 a, f32x4 b) { return vsubq_f32(a.v, b.v); }
+inline f32x4 operator*(f32x4 a, f32x4 b) { return vmulq_f32(a.v, b.v); }
+inline f32x4 operator/(f32x4 a, f32x4 b) { return vdivq_f32(a.v, b.v); }
+inline f32x4 operator-(f32x4 a) { return vnegq_f32(a.v); }
+inline f32x4 simdMin(f32x4 a, f32x4 b) { return vminq_f32(a.v, b.v); }
+inline f32x4 simdMax(f32x4 a, f32x4 b) { return vmaxq_f32(a.v, b.v); }
+inline f32x4 simdAbs(f32x4 a) { return vabsq_f32(a.v); }
+inline f32x4 simdSqrt(f32x4 a) { return vsqrtq_f32(a.v); }
+inline f32x4 simdGreater(f32x4 a, f32x4 b) { return vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v)); }
+inline f32x4 simdLess(f32x4 a, f32x4 b) { return vreinterpretq_f32_u32(vcltq_f32(a.v, b.v)); }
+inline f32x4 simdAnd(f32x4 a, f32x4 b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))); }
+inline f32x4 simdOr(f32x4 a, f32x4 b) { return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))); }
+inline f32x4 simdSelect(f32x4 mask, f32x4 a, f32x4 b) { return vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v); }
+inline f32x4 simdRound(f32x4 a) { return vrndnq_f32(a.v); }
+inline f32x4 simdCopySign(f32x4 magnitude, f32x4 sign)
+{
+    uint32x4_t signBit = vdupq_n_u32(0x80000000u);
+    return vbslq_f32(signBit, sign.v, magnitude.v);
+}
+
+#else
+
+#define SIMD_SCALAR_BINARY(name, expr) \
+    inline f32x4 name(f32x4 a, f32x4 b) { f32x4 r; for (int i = 0; i < 4; ++i) { float x = a.v[i], y = b.v[i]; r.v[i] = (expr); } return r; }
+
+inline float simdMaskBits(bool b) { uint32_t bits = b ? 0xFFFFFFFFu : 0u; float f; std::memcpy(&f, &bits, 4); return f; }
+inline uint32_t simdFloatBits(float f) { uint32_t bits; std::memcpy(&bits, &f, 4); return bits; }
+inline float simdBitsFloat(uint32_t bits) { float f; std::memcpy(&f, &bits, 4); return f; }
+
+SIMD_SCALAR_BINARY(operator+, x + y)
+SIMD_SCALAR_BINARY(operator-, x - y)
+SIMD_SCALAR_BINARY(operator*, x * y)
+SIMD_SCALAR_BINARY(operator/, x / y)
+SIMD_SCALAR_BINARY(simdMin, y < x ? y : x)
+SIMD_SCALAR_BINARY(simdMax, y > x ? y : x)
+SIMD_SCALAR_BINARY(simdGreater, simdMaskBits(x > y))
+SIMD_SCALAR_BINARY(simdLess, simdMaskBits(x < y))
+SIMD_SCALAR_BINARY(simdAnd, simdBitsFloat(simdFloatBits(x) & simdFloatBits(y)))
+SIMD_SCALAR_BINARY(simdOr, simdBitsFloat(simdFloatBits(x) | simdFloatBits(y)))
+SIMD_SCALAR_BINARY(simdCopySign, std::copysign(x, y))
+#undef SIMD_SCALAR_BINARY
+
+inline f32x4 operator-(f32x4 a) { f32x4 r; for (int i = 0; i < 4; ++i) r.v[i] = -a.v[i]; return r; }
+inline f32x4 simdAbs(f32x4 a) { f32x4 r; for (int i = 0; i < 4; ++i) r.v[i] = std::fabs(a.v[i]); return r; }
+inline f32x4 simdSqrt(f32x4 a) { f32x4 r; for (int i = 0; i < 4; ++i) r.v[i] = std::sqrt(a.v[i]); return r; }
+inline f32x4 simdRound(f32x4 a) { f32x4 r; for (int i = 0; i < 4; ++i) r.v[i] = std::nearbyint(a.v[i]); return r; }
+inline f32x4 simdSelect(f32x4 mask, f32x4 a, f32x4 b)
+{
+    f32x4 r;
+    for (int i = 0; i < 4; ++i) {
+        uint32_t m = simdFloatBits(mask.v[i]);
+        r.v[i] = simdBitsFloat((simdFloatBits(a.v[i]) & m) | (simdFloatBits(b.v[i]) & ~m));
+    }
+    return r;
+}
+
+#endif
+
+inline f32x4& operator+=(f32x4& a, f32x4 b) { a = a + b; return a; }
+inline f32x4& operator-=(f32x4& a, f32x4 b) { a = a - b; return a; }
+inline f32x4& operator*=(f32x4& a, f32x4 b) { a = a * b; return a; }
+
+inline f32x4 simdClamp(f32x4 x, f32x4 lo, f32x4 hi) { return simdMin(simdMax(x, lo), hi); }
+
+// atan, max error ~1e-5 rad over the whole real line
+inline f32x4 simdAtan(f32x4 x)
+{
+    const f32x4 one(1.0f);
+    f32x4 ax = simdAbs(x);
+    f32x4 invert = simdGreater(ax, one);
+    f32x4 t = simdSelect(invert, one / simdMax(ax, one), ax);   // t in [0, 1]
+    f32x4 t2 = t * t;
+    f32x4 p(-0.0117212f);
+    p = p * t2 + f32x4(0.05265332f);
+    p = p * t2 + f32x4(-0.11643287f);
+    p = p * t2 + f32x4(0.19354346f);
+    p = p * t2 + f32x4(-0.33262347f);
+    p = p * t2 + f32x4(0.99997726f);
+    f32x4 r = p * t;
+    r = simdSelect(invert, f32x4(1.57079632679f) - r, r);
+    return simdCopySign(r, x);
+}
+
+// sin and cos of any angle: reduce to [-pi, pi], then fold into [-pi/2, pi/2]
+inline void simdSinCos(f32x4 x, f32x4& outSin, f32x4& outCos)
+{
+    const f32x4 twoPi(6.28318530718f);
+    const f32x4 pi(3.14159265359f);
+    const f32x4 halfPi(1.57079632679f);
+    x = x - twoPi * simdRound(x * f32x4(0.15915494309f));
+
+    // sin(x) = sin(pi - x), cos(x) = -cos(pi - x) for |x| > pi/2
+    f32x4 fold = simdGreater(simdAbs(x), halfPi);
+    f32x4 folded = simdCopySign(pi, x) - x;
+    x = simdSelect(fold, folded, x);
+    f32x4 cosSign = simdSelect(fold, f32x4(-1.0f), f32x4(1.0f));
+
+    f32x4 x2 = x * x;
+    f32x4 s(-2.3889859e-08f);
+    s = s * x2 + f32x4(2.7525562e-06f);
+    s = s * x2 + f32x4(-1.9840874e-04f);
+    s = s * x2 + f32x4(8.3333310e-03f);
+    s = s * x2 + f32x4(-1.6666667e-01f);
+    outSin = x + x * x2 * s;
+
+    f32x4 c(-2.6051615e-07f);
+    c = c * x2 + f32x4(2.4760495e-05f);
+    c = c * x2 + f32x4(-1.3888378e-03f);
+    c = c * x2 + f32x4(4.1666638e-02f);
+    c = c * x2 + f32x4(-0.5f);
+    outCos = (f32x4(1.0f) + x2 * c) * cosSign;
+}
+
+inline f32x4 simdSin(f32x4 x)
+{
+    f32x4 s, c;
+    simdSinCos(x, s, c);
+    return s;
+}
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "VehicleDynamics.h"
+#include "Bvh.h"
+#include "SpatialHash.h"
+#include "AiTraffic.h"
+#include "Terrain.h"
+#include "TrackMesh.h"
+#include "JobSystem.h"
+
+// Fixed-step game simulation: player car, AI field and free camera.
+//
+// Everything here is integrated with the constant step from FixedTimestep, never with
+// the render frame time. The renderer draws interpolateSimState(previous, current, alpha).
+// The player's car is slot PLAYER_VEHICLE of the VehicleBatch; SimState keeps a copy of
+// its pose so the renderer can interpolate it. The car and the free camera are swept
+// against the static scenery BVH every step; cars are kept apart from each other through
+// the spatial hash broadphase. AI cars fill the other vehicle slots and drive round the
+// track's lap; driving, ground probes (onto the terrain) and the dynamics run in parallel
+// over 4-aligned vehicle ranges.
+
+// ---------- Simulation tuning constants ----------
+const double SIM_HZ = 120.0;
+const int   PLAYER_VEHICLE     = 0;
+const float REVERSE_THROTTLE   = 0.5f;
+const float BRAKE_SWITCH_SPEED = 0.5f;          // m/s, above this the opposite pedal brakes
+const float CAMERA_MOVE_SPEED  = 1.0f;          // units per second
+const float CAMERA_FAST_FACTOR = 3.0f;          // Shift multiplier
+const float CAMERA_MOUSE_SENSITIVITY = 8.0f / 60.0f; // degrees per pixel (old 8 * deltaTime at 60 FPS)
+const glm::vec3 CAR_COLLISION_EXTENTS = glm::vec3(0.85f, 0.45f, 1.4f);   // half size in car space
+const float CAR_COLLISION_CENTER_Y    = 0.5f;
+const float CAMERA_COLLISION_RADIUS   = 0.2f;
+const float CAR_BROADPHASE_RADIUS     = 1.65f;   // encloses the collision box
+const float CAR_CONTACT_RADIUS        = 1.1f;    // narrowphase circle in the ground plane
+const float CAR_RESTITUTION           = 0.2f;
+const float BROADPHASE_CELL_SIZE      = 4.0f;    // >= largest dynamic object diameter
+const int   AI_DEFAULT_CARS           = 24;
+const int   VEHICLE_UPDATE_GRAIN      = 64;      // vehicles per parallel chunk, multiple of 4
+
+// Input sampled once per rendered frame
+struct SimInput {
+    bool cameraForward = false;
+    bool cameraBack    = false;
+    bool cameraLeft    = false;
+    bool cameraRight   = false;
+    bool cameraFast    = false;
+    bool carForward    = false;   // I
+    bool carBackward   = false;   // K
+    bool steerLeft     = false;   // J
+    bool steerRight    = false;   // L
+    float mouseDx = 0.0f;         // pixels, consumed by the first step that sees them
+    float mouseDy = 0.0f;
+};
+
+// Simulation objects that are too big to copy into every SimState snapshot
+struct SimWorld {
+    VehicleBatch vehicles;
+    VehicleParams vehicleParams;
+    StaticBvh scenery;              // static collision, built once from the track layout
+    Terrain terrain;                // ground height; flat y = 0 until generated
+    TrackMesh track;                // the lap the AI field drives; no AI cars until built
+    SpatialHash broadphase = SpatialHash(BROADPHASE_CELL_SIZE);
+    std::vector<int> vehicleProxies;                            // broadphase handle per vehicle
+    std::vector<std::pair<uint32_t, uint32_t>> contactPairs;    // scratch, reused every step
+    std::vector<int> proxyVehicle;                              // broadphase handle -> vehicle, -1 for others
+    AiTraffic ai;
+
+    // Vehicle poses at the start of the last step, for render interpolation of the AI cars
+    std::vector<float> previousPosX, previousPosY, previousPosZ, previousHeading, previousWheelSpin;
+
+    // Everything except the scenery BVH, the terrain and the track, which are reported on their own
+    size_t memoryBytes() const
+    {
+        return vehicles.memoryBytes() + broadphase.memoryBytes() + ai.memoryBytes() +
+               vectorBytes(vehicleProxies) + vectorBytes(contactPairs) + vectorBytes(proxyVehicle) +
+               vectorBytes(previousPosX) + vectorBytes(previousPosY) + vectorBytes(previousPosZ) +
+               vectorBytes(previousHeading) + vectorBytes(previousWheelSpin);
+    }
+};
+
+inline int addVehicle(SimWorld& world, const glm::vec3& position, float headingRadians)
+{
+    int vehicle = world.vehicles.add(position.x, position.y, position.z, headingRadians);
+    int proxy = world.broadphase.insert(position, CAR_BROADPHASE_RADIUS);
+    world.vehicleProxies.push_back(proxy);
+    if (static_cast<int>(world.proxyVehicle.size()) <= proxy) world.proxyVehicle.resize(proxy + 1, -1);
+    world.proxyVehicle[proxy] = vehicle;
+    world.ai.resize(world.vehicles.count);
+    world.ai.active[vehicle] = 0;
+    return vehicle;
+}
+
+// Replace the AI field with `count` cars spread over the lanes (the player keeps slot 0);
+// without a built track there is nowhere to drive and the field stays empty
+inline void setAiCarCount(SimWorld& world, int count)
+{
+    for (int i = PLAYER_VEHICLE + 1; i < world.vehicles.count; ++i) {
+        world.broadphase.remove(world.vehicleProxies[i]);
+        world.proxyVehicle[world.vehicleProxies[i]] = -1;
+    }
+    world.vehicles.truncate(PLAYER_VEHICLE + 1);
+    world.vehicleProxies.resize(PLAYER_VEHICLE + 1);
+
+    if (world.track.length() <= 0.0f) count = 0;
+    float outsideSide = count > 0 ? aiOutsideSide(world.track) : 1.0f;
+    for (int n = 0; n < count; ++n) {
+        AiSpawn spawn = aiSpawnSlot(n, count, world.track, outsideSide);
+        int vehicle = addVehicle(world, spawn.position, spawn.heading);
+        world.ai.active[vehicle] = 1;
+        world.ai.laneOffset[vehicle] = spawn.laneOffset;
+        world.ai.lapDistance[vehicle] = spawn.lapDistance;
+        world.ai.direction[vehicle] = spawn.direction;
+        // Deterministic spread of cruise speeds so the field doesn't move as one block
+        float t = static_cast<float>((n * 7919) % 101) / 100.0f;
+        world.ai.cruiseSpeed[vehicle] = AI_MIN_CRUISE_SPEED + t * (AI_MAX_CRUISE_SPEED - AI_MIN_CRUISE_SPEED);
+    }
+    world.broadphase.update();
+
+    VehicleBatch& v = world.vehicles;
+    world.previousPosX.assign(v.posX.begin(), v.posX.begin() + v.count);
+    world.previousPosY.assign(v.posY.begin(), v.posY.begin() + v.count);
+    world.previousPosZ.assign(v.posZ.begin(), v.posZ.begin() + v.count);
+    world.previousHeading.assign(v.heading.begin(), v.heading.begin() + v.count);
+    world.previousWheelSpin.assign(v.wheelSpin.begin(), v.wheelSpin.begin() + v.count);
+}
+
+inline int aiCarCount(const SimWorld& world)
+{
+    return world.vehicles.count - (PLAYER_VEHICLE + 1);
+}
+
+// Car-vs-car contacts: broadphase pairs, then circles in the ground plane.
+// Overlap is split evenly and the closing velocity along the normal is removed.
+inline void resolveVehicleContacts(SimWorld& world)
+{
+    VehicleBatch& v = world.vehicles;
+    for (int i = 0; i < v.count; ++i)
+        world.broadphase.move(world.vehicleProxies[i], glm::vec3(v.posX[i], v.posY[i], v.posZ[i]));
+    world.broadphase.update();
+    world.broadphase.findPairs(world.contactPairs);
+
+    for (const std::pair<uint32_t, uint32_t>& pair : world.contactPairs) {
+        int a = world.proxyVehicle[pair.first];
+        int b = world.proxyVehicle[pair.second];
+        if (a < 0 || b < 0) continue;
+
+        float dx = v.posX[b] - v.posX[a];
+        float dz = v.posZ[b] - v.posZ[a];
+        float distance = sqrtf(dx * dx + dz * dz);
+        float overlap = 2.0f * CAR_CONTACT_RADIUS - distance;
+        if (overlap <= 0.0f) continue;
+
+        float nx = distance > 1e-4f ? dx / distance : 1.0f;
+        float nz = distance > 1e-4f ? dz / distance : 0.0f;
+        v.posX[a] -= nx * overlap * 0.5f;
+        v.posZ[a] -= nz * overlap * 0.5f;
+        v.posX[b] += nx * overlap * 0.5f;
+        v.posZ[b] += nz * overlap * 0.5f;
+
+        float closing = (v.velX[a] - v.velX[b]) * nx + (v.velZ[a] - v.velZ[b]) * nz;
+        if (closing <= 0.0f) continue;
+        float impulse = 0.5f * (1.0f + CAR_RESTITUTION) * closing;   // equal masses
+        v.velX[a] -= nx * impulse;
+        v.velZ[a] -= nz * impulse;
+        v.velX[b] += nx * impulse;
+        v.velZ[b] += nz * impulse;
+    }
+}
+
+// Everything the simulation integrates
+struct SimState {
+    glm::vec3 carPos = glm::vec3(0.0f, 0.0f, 5.0f);
+    float carYaw     = 0.0f;          // degrees about +Y, forward = (sin, 0, cos)
+    float carPitch   = 0.0f;          // degrees
+    float carRoll    = 0.0f;          // degrees
+    float wheelAngle = 0.0f;          // degrees of wheel rotation
+    float steerAngle = 0.0f;          // degrees, positive = left
+
+    glm::vec3 cameraPos = glm::vec3(0.0f, 1.5f, 5.0f);
+    float cameraHorizontalAngle = 270.0f;
+    float cameraVerticalAngle   = 0.0f;
+
+    double time = 0.0;            // seconds of simulated time
+};
+
+inline glm::vec3 cameraFrontFromAngles(float horizontalDegrees, float verticalDegrees)
+{
+    float theta = glm::radians(horizontalDegrees);
+    float phi   = glm::radians(verticalDegrees);
+    return glm::vec3(cosf(phi) * cosf(theta), sinf(phi), -cosf(phi) * sinf(theta));
+}
+
+// World bounds of a car's collision box (the box is rotated with the car, so take its AABB)
+inline Aabb carCollisionBounds(const glm::vec3& position, float heading)
+{
+    float s = fabsf(sinf(heading)), c = fabsf(cosf(heading));
+    glm::vec3 e = CAR_COLLISION_EXTENTS;
+    glm::vec3 extents(c * e.x + s * e.z, e.y, s * e.x + c * e.z);
+    return aabbFromCenterExtents(position + glm::vec3(0.0f, CAR_COLLISION_CENTER_Y, 0.0f), extents);
+}
+
+inline void stepSimulation(SimState& state, SimInput& input, SimWorld& world, float dt)
+{
+    PROFILE_ZONE("simulation step");
+    VehicleBatch& vehicles = world.vehicles;
+
+    // Mouse look is a displacement, not a rate: apply it once, on the first step
+    state.cameraHorizontalAngle -= input.mouseDx * CAMERA_MOUSE_SENSITIVITY;
+    state.cameraVerticalAngle   -= input.mouseDy * CAMERA_MOUSE_SENSITIVITY;
+    input.mouseDx = input.mouseDy = 0.0f;
+
+    // Clamp vertical angle to [-85, 85] degrees
+    state.cameraVerticalAngle = std::max(-85.0f, std::min(85.0f, state.cameraVerticalAngle));
+
+    glm::vec3 cameraFront = cameraFrontFromAngles(state.cameraHorizontalAngle, state.cameraVerticalAngle);
+    glm::vec3 cameraSide  = glm::normalize(glm::cross(cameraFront, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    float cameraStep = CAMERA_MOVE_SPEED * dt * (input.cameraFast ? CAMERA_FAST_FACTOR : 1.0f);
+    glm::vec3 cameraMove(0.0f);
+    if (input.cameraForward) cameraMove += cameraFront * cameraStep;
+    if (input.cameraBack)    cameraMove -= cameraFront * cameraStep;
+    if (input.cameraLeft)    cameraMove -= cameraSide * cameraStep;
+    if (input.cameraRight)   cameraMove += cameraSide * cameraStep;
+    glm::vec3 cameraContact;
+    state.cameraPos += sweepAndSlide(world.scenery,
+                                     aabbFromCenterExtents(state.cameraPos, glm::vec3(CAMERA_COLLISION_RADIUS)),
+                                     cameraMove, cameraContact);
+
+    // Car commands: I accelerates, K brakes and then reverses
+    float forwardSpeed = vehicles.velX[PLAYER_VEHICLE] * sinf(vehicles.heading[PLAYER_VEHICLE]) +
+                         vehicles.velZ[PLAYER_VEHICLE] * cosf(vehicles.heading[PLAYER_VEHICLE]);
+    float throttle = 0.0f, brake = 0.0f;
+    if (input.carForward) {
+        if (forwardSpeed < -BRAKE_SWITCH_SPEED) brake = 1.0f;
+        else throttle = 1.0f;
+    }
+    if (input.carBackward) {
+        if (forwardSpeed > BRAKE_SWITCH_SPEED) brake = 1.0f;
+        else throttle = -REVERSE_THROTTLE;
+    }
+    vehicles.throttle[PLAYER_VEHICLE] = throttle;
+    vehicles.brake[PLAYER_VEHICLE] = brake;
+
+    // Steering (J = left, L = right)
+    float steer = 0.0f;
+    if (input.steerLeft)  steer += 1.0f;
+    if (input.steerRight) steer -= 1.0f;
+    vehicles.steerInput[PLAYER_VEHICLE] = steer;
+
+    int vehicleCount = vehicles.count;
+    world.previousPosX.assign(vehicles.posX.begin(), vehicles.posX.begin() + vehicleCount);
+    world.previousPosY.assign(vehicles.posY.begin(), vehicles.posY.begin() + vehicleCount);
+    world.previousPosZ.assign(vehicles.posZ.begin(), vehicles.posZ.begin() + vehicleCount);
+    world.previousHeading.assign(vehicles.heading.begin(), vehicles.heading.begin() + vehicleCount);
+    world.previousWheelSpin.assign(vehicles.wheelSpin.begin(), vehicles.wheelSpin.begin() + vehicleCount);
+
+    // AI, ground probes onto the terrain and dynamics, in parallel chunks.
+    // Chunks only write their own vehicle slots and only read the broadphase, which is
+    // not touched until resolveVehicleContacts() below.
+    glm::vec3 oldCarPos(vehicles.posX[PLAYER_VEHICLE], vehicles.posY[PLAYER_VEHICLE], vehicles.posZ[PLAYER_VEHICLE]);
+    parallelFor(vehicleCount, VEHICLE_UPDATE_GRAIN, [&](int begin, int end) {
+        PROFILE_ZONE("vehicles");
+        driveAiVehicles(world.ai, world.track, vehicles, world.vehicleParams, world.broadphase, world.vehicleProxies, begin, end);
+        probeVehicleGround(vehicles, begin, end, [&world](float x, float z) { return world.terrain.heightAt(x, z); });
+        stepVehicles(vehicles, world.vehicleParams, dt, begin, end);
+    });
+
+    // Keep the car out of the scenery: sweep the step's motion, slide, and drop the
+    // velocity component going into the wall
+    glm::vec3 newCarPos(vehicles.posX[PLAYER_VEHICLE], vehicles.posY[PLAYER_VEHICLE], vehicles.posZ[PLAYER_VEHICLE]);
+    glm::vec3 carContact;
+    glm::vec3 allowed = sweepAndSlide(world.scenery, carCollisionBounds(oldCarPos, vehicles.heading[PLAYER_VEHICLE]),
+                                      newCarPos - oldCarPos, carContact);
+    if (carContact != glm::vec3(0.0f)) {
+        glm::vec3 carPos = oldCarPos + allowed;
+        vehicles.posX[PLAYER_VEHICLE] = carPos.x;
+        vehicles.posY[PLAYER_VEHICLE] = carPos.y;
+        vehicles.posZ[PLAYER_VEHICLE] = carPos.z;
+        glm::vec3 velocity(vehicles.velX[PLAYER_VEHICLE], vehicles.velY[PLAYER_VEHICLE], vehicles.velZ[PLAYER_VEHICLE]);
+        velocity -= carContact * std::min(0.0f, glm::dot(velocity, carContact));
+        vehicles.velX[PLAYER_VEHICLE] = velocity.x;
+        vehicles.velY[PLAYER_VEHICLE] = velocity.y;
+        vehicles.velZ[PLAYER_VEHICLE] = velocity.z;
+        vehicles.yawRate[PLAYER_VEHICLE] *= 0.5f;
+    }
+
+    resolveVehicleContacts(world);
+
+    state.carPos     = glm::vec3(vehicles.posX[PLAYER_VEHICLE], vehicles.posY[PLAYER_VEHICLE], vehicles.posZ[PLAYER_VEHICLE]);
+    state.carYaw     = glm::degrees(vehicles.heading[PLAYER_VEHICLE]);
+    state.carPitch   = glm::degrees(vehicles.pitch[PLAYER_VEHICLE]);
+    state.carRoll    = glm::degrees(vehicles.roll[PLAYER_VEHICLE]);
+    state.wheelAngle = glm::degrees(vehicles.wheelSpin[PLAYER_VEHICLE]);
+    state.steerAngle = glm::degrees(vehicles.steer[PLAYER_VEHICLE]);
+
+    state.time += dt;
+}
+
+// Render pose of any vehicle, interpolated between the last two steps (degrees like SimState)
+struct VehicleRenderPose {
+    glm::vec3 position;
+    float yaw, pitch, roll, wheelAngle, steerAngle;
+};
+
+inline VehicleRenderPose vehicleRenderPose(const SimWorld& world, int i, float alpha)
+{
+    const VehicleBatch& v = world.vehicles;
+    VehicleRenderPose pose;
+    pose.position = glm::mix(glm::vec3(world.previousPosX[i], world.previousPosY[i], world.previousPosZ[i]),
+                             glm::vec3(v.posX[i], v.posY[i], v.posZ[i]), alpha);
+    pose.yaw        = glm::degrees(glm::mix(world.previousHeading[i], v.heading[i], alpha));
+    pose.pitch      = glm::degrees(v.pitch[i]);
+    pose.roll       = glm::degrees(v.roll[i]);
+    pose.wheelAngle = glm::degrees(glm::mix(world.previousWheelSpin[i], v.wheelSpin[i], alpha));
+    pose.steerAngle = glm::degrees(v.steer[i]);
+    return pose;
+}
+
+inline SimState interpolateSimState(const SimState& previous, const SimState& current, float alpha)
+{
+    SimState s = current;
+    s.carPos     = glm::mix(previous.carPos, current.carPos, alpha);
+    s.carYaw     = glm::mix(previous.carYaw, current.carYaw, alpha);
+    s.carPitch   = glm::mix(previous.carPitch, current.carPitch, alpha);
+    s.carRoll    = glm::mix(previous.carRoll, current.carRoll, alpha);
+    s.wheelAngle = glm::mix(previous.wheelAngle, current.wheelAngle, alpha);
+    s.steerAngle = glm::mix(previous.steerAngle, current.steerAngle, alpha);
+    s.cameraPos  = glm::mix(previous.cameraPos, current.cameraPos, alpha);
+    s.cameraHorizontalAngle = glm::mix(previous.cameraHorizontalAngle, current.cameraHorizontalAngle, alpha);
+    s.cameraVerticalAngle   = glm::mix(previous.cameraVerticalAngle, current.cameraVerticalAngle, alpha);
+    s.time = previous.time + (current.time - previous.time) * alpha;
+    return s;
+}
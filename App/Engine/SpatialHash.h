@@ -0,0 +1,274 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "ResourceRegistry.h"
+
+// Uniform-grid broadphase for dynamic objects (cars, birds, particles).
+//
+// Objects are bounding spheres bucketed by the cell holding their centre. The cell size
+// must be at least the largest diameter, so any overlapping pair lies in the same or an
+// adjacent cell. Layout is flat on purpose:
+//   - entries: (cell key, object) sorted by key, so a cell is a contiguous run
+//   - cellTable: open-addressing hash from cell key to its run, rebuilt by update()
+//   - sortedSpheres: position + radius copied in entry order so the pair loop streams
+// Moves that stay inside a cell only touch the object's position. Moves across cells
+// re-key the object; update() re-sorts just those and merges them back in.
+
+struct SpatialHash {
+    struct Entry {
+        uint64_t cell;
+        uint32_t object;
+    };
+
+    struct CellSlot {
+        uint64_t cell;
+        uint32_t first;
+        uint32_t count;     // 0 = empty slot
+    };
+
+    float cellSize = 4.0f;
+    float invCellSize = 0.25f;
+
+    // Per object, indexed by handle
+    std::vector<glm::vec3> positions;
+    std::vector<float> radii;
+    std::vector<uint64_t> objectCell;
+    std::vector<uint8_t> alive;
+    std::vector<uint32_t> freeHandles;
+    std::vector<uint32_t> pendingInserts;
+    std::vector<uint32_t> pendingFree;      // handles are recycled only after update() drops them
+    int liveCount = 0;
+
+    // Sorted view, valid after update()
+    std::vector<Entry> entries;
+    std::vector<glm::vec4> sortedSpheres;     // xyz = centre, w = radius
+    std::vector<CellSlot> cellTable;
+    uint64_t cellMask = 0;
+
+    bool needsResort = false;
+    std::vector<Entry> scratch, moved;      // update() working storage
+
+    explicit SpatialHash(float size = 4.0f) { setCellSize(size); }
+
+    size_t memoryBytes() const
+    {
+        return vectorBytes(positions) + vectorBytes(radii) + vectorBytes(objectCell) + vectorBytes(alive) +
+               vectorBytes(freeHandles) + vectorBytes(pendingInserts) + vectorBytes(pendingFree) +
+               vectorBytes(entries) + vectorBytes(sortedSpheres) + vectorBytes(cellTable) +
+               vectorBytes(scratch) + vectorBytes(moved);
+    }
+
+    void setCellSize(float size)
+    {
+        cellSize = size;
+        invCellSize = 1.0f / size;
+        for (size_t i = 0; i < positions.size(); ++i)
+            if (alive[i]) objectCell[i] = cellKey(positions[i]);
+        needsResort = true;
+    }
+
+    // 21 bits per axis, biased so negative coordinates sort correctly
+    uint64_t cellKey(const glm::vec3& p) const
+    {
+        const int64_t bias = 1 << 20;
+        uint64_t x = static_cast<uint64_t>(static_cast<int64_t>(floorf(p.x * invCellSize)) + bias) & 0x1FFFFF;
+        uint64_t y = static_cast<uint64_t>(static_cast<int64_t>(floorf(p.y * invCellSize)) + bias) & 0x1FFFFF;
+        uint64_t z = static_cast<uint64_t>(static_cast<int64_t>(floorf(p.z * invCellSize)) + bias) & 0x1FFFFF;
+        return (z << 42) | (y << 21) | x;
+    }
+
+    static uint64_t offsetKey(uint64_t key, int dx, int dy, int dz)
+    {
+        uint64_t x = ((key & 0x1FFFFF) + dx) & 0x1FFFFF;
+        uint64_t y = (((key >> 21) & 0x1FFFFF) + dy) & 0x1FFFFF;
+        uint64_t z = (((key >> 42) & 0x1FFFFF) + dz) & 0x1FFFFF;
+        return (z << 42) | (y << 21) | x;
+    }
+
+    int insert(const glm::vec3& position, float radius)
+    {
+        uint32_t handle;
+        if (!freeHandles.empty()) {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        } else {
+            handle = static_cast<uint32_t>(positions.size());
+            positions.push_back(position);
+            radii.push_back(radius);
+            objectCell.push_back(0);
+            alive.push_back(0);
+        }
+        positions[handle] = position;
+        radii[handle] = radius;
+        objectCell[handle] = cellKey(position);
+        alive[handle] = 1;
+        pendingInserts.push_back(handle);
+        ++liveCount;
+        return static_cast<int>(handle);
+    }
+
+    void move(int handle, const glm::vec3& position)
+    {
+        positions[handle] = position;
+        uint64_t key = cellKey(position);
+        if (key != objectCell[handle]) {
+            objectCell[handle] = key;
+            needsResort = true;
+        }
+    }
+
+    void remove(int handle)
+    {
+        alive[handle] = 0;
+        pendingFree.push_back(static_cast<uint32_t>(handle));
+        --liveCount;
+        needsResort = true;
+    }
+
+    // Bring the sorted entries and the cell table up to date with inserts/moves/removes
+    void update()
+    {
+        if (needsResort || !pendingInserts.empty()) {
+            // Split into entries still in place (already sorted) and re-keyed ones
+            scratch.clear();
+            moved.clear();
+            for (const Entry& e : entries) {
+                if (!alive[e.object]) continue;
+                if (objectCell[e.object] == e.cell) scratch.push_back(e);
+                else moved.push_back({ objectCell[e.object], e.object });
+            }
+            for (uint32_t handle : pendingInserts)
+                if (alive[handle]) moved.push_back({ objectCell[handle], handle });
+            pendingInserts.clear();
+            freeHandles.insert(freeHandles.end(), pendingFree.begin(), pendingFree.end());
+            pendingFree.clear();
+
+            std::sort(moved.begin(), moved.end(), lessEntry);
+            entries.resize(scratch.size() + moved.size());
+            std::merge(scratch.begin(), scratch.end(), moved.begin(), moved.end(), entries.begin(), lessEntry);
+            needsResort = false;
+            rebuildCellTable();
+        }
+
+        sortedSpheres.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            uint32_t o = entries[i].object;
+            sortedSpheres[i] = glm::vec4(positions[o], radii[o]);
+        }
+    }
+
+    // Candidate pairs (object handles) whose bounding spheres overlap. Call update() first.
+    void findPairs(std::vector<std::pair<uint32_t, uint32_t>>& pairs) const
+    {
+        pairs.clear();
+        // Half of the 26-neighbourhood, so each adjacent cell pair is visited once
+        static const int forward[13][3] = {
+            { 1, 0, 0 }, { -1, 1, 0 }, { 0, 1, 0 }, { 1, 1, 0 },
+            { -1, -1, 1 }, { 0, -1, 1 }, { 1, -1, 1 },
+            { -1, 0, 1 }, { 0, 0, 1 }, { 1, 0, 1 },
+            { -1, 1, 1 }, { 0, 1, 1 }, { 1, 1, 1 }
+        };
+
+        size_t runStart = 0;
+        while (runStart < entries.size()) {
+            uint64_t cell = entries[runStart].cell;
+            size_t runEnd = runStart + 1;
+            while (runEnd < entries.size() && entries[runEnd].cell == cell) ++runEnd;
+
+            for (size_t i = runStart; i < runEnd; ++i)
+                for (size_t j = i + 1; j < runEnd; ++j)
+                    testPair(i, j, pairs);
+
+            for (const int* d : forward) {
+                const CellSlot* other = findCell(offsetKey(cell, d[0], d[1], d[2]));
+                if (!other) continue;
+                for (size_t i = runStart; i < runEnd; ++i)
+                    for (uint32_t j = other->first; j < other->first + other->count; ++j)
+                        testPair(i, j, pairs);
+            }
+            runStart = runEnd;
+        }
+    }
+
+    // Calls visit(handle) for every object whose sphere overlaps the query sphere.
+    // The query radius plus the largest object radius must not exceed cellSize.
+    template <typename Visit>
+    void query(const glm::vec3& centre, float radius, Visit visit) const
+    {
+        uint64_t key = cellKey(centre);
+        for (int dz = -1; dz <= 1; ++dz)
+            for (int dy = -1; dy <= 1; ++dy)
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const CellSlot* slot = findCell(offsetKey(key, dx, dy, dz));
+                    if (!slot) continue;
+                    for (uint32_t i = slot->first; i < slot->first + slot->count; ++i) {
+                        const glm::vec4& s = sortedSpheres[i];
+                        glm::vec3 d = glm::vec3(s) - centre;
+                        float r = s.w + radius;
+                        if (glm::dot(d, d) <= r * r) visit(static_cast<int>(entries[i].object));
+                    }
+                }
+    }
+
+private:
+    static bool lessEntry(const Entry& a, const Entry& b)
+    {
+        return a.cell < b.cell || (a.cell == b.cell && a.object < b.object);
+    }
+
+    static uint64_t hashKey(uint64_t key)
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    void rebuildCellTable()
+    {
+        size_t cells = 0;
+        for (size_t i = 0; i < entries.size(); ++i)
+            if (i == 0 || entries[i].cell != entries[i - 1].cell) ++cells;
+
+        size_t capacity = 16;
+        while (capacity < cells * 2) capacity <<= 1;
+        cellTable.assign(capacity, CellSlot{ 0, 0, 0 });
+        cellMask = capacity - 1;
+
+        for (size_t i = 0; i < entries.size();) {
+            size_t j = i + 1;
+            while (j < entries.size() && entries[j].cell == entries[i].cell) ++j;
+            uint64_t slot = hashKey(entries[i].cell) & cellMask;
+            while (cellTable[slot].count != 0) slot = (slot + 1) & cellMask;
+            cellTable[slot] = { entries[i].cell, static_cast<uint32_t>(i), static_cast<uint32_t>(j - i) };
+            i = j;
+        }
+    }
+
+    const CellSlot* findCell(uint64_t key) const
+    {
+        if (cellTable.empty()) return nullptr;
+        uint64_t slot = hashKey(key) & cellMask;
+        while (cellTable[slot].count != 0) {
+            if (cellTable[slot].cell == key) return &cellTable[slot];
+            slot = (slot + 1) & cellMask;
+        }
+        return nullptr;
+    }
+
+    void testPair(size_t i, size_t j, std::vector<std::pair<uint32_t, uint32_t>>& pairs) const
+    {
+        const glm::vec4& a = sortedSpheres[i];
+        const glm::vec4& b = sortedSpheres[j];
+        glm::vec3 d = glm::vec3(a) - glm::vec3(b);
+        float r = a.w + b.w;
+        if (glm::dot(d, d) <= r * r) {
+            uint32_t oa = entries[i].object, ob = entries[j].object;
+            pairs.push_back(oa < ob ? std::make_pair(oa, ob) : std::make_pair(ob, oa));
+        }
+    }
+};
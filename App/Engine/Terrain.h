@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "ResourceRegistry.h"
+
+// Heightmap terrain in square chunks with geomipmapped levels of detail.
+//
+// The heightmap is generated (fractal value noise) and kept flat around the track, so the
+// road, curbs and scenery that sit on y = 0 stay where they were. Every chunk has the same
+// size and is drawn from the same mesh: a grid of TERRAIN_CHUNK_QUADS^2 quads whose
+// vertices are only grid coordinates; the vertex shader reads the heights. Level n uses
+// every 2^n-th vertex through its own index list, so all levels share one vertex buffer
+// and one index buffer. All levels split their quads along the same diagonal, so a level
+// n + 1 edge always runs through the level n vertex in its middle.
+//
+// Levels are picked per chunk from the distance between the camera and the chunk's box:
+// level n out to lodRange(n), which doubles with every level. Towards the end of its range
+// a chunk morphs into the next level: the vertex shader moves each vertex that the
+// coarser level does not have towards the middle of the coarser edge it lies on, by a
+// factor that depends on the vertex's own distance. Two chunks that share an edge compute
+// the same factor for the vertices on it, and morphRange() keeps the ranges far enough
+// apart that a chunk next to a coarser one is fully morphed along their common edge and
+// the coarser one has not started morphing there yet. Neighbouring levels therefore match
+// exactly and no skirts are needed. Chunks outside the frustum are skipped, so the
+// triangle count depends on the view distance rather than on the terrain size.
+
+const int TERRAIN_CHUNK_QUADS = 64;             // finest grid per chunk side, power of two, < 256
+const int TERRAIN_LODS = 5;                     // 64, 32, 16, 8 and 4 quads per side
+const int TERRAIN_CHUNKS = 32;                  // per side
+const float TERRAIN_SPACING = 2.0f;             // metres between heights: 32 * 64 * 2 = 4096 m across
+const float TERRAIN_LOD0_RANGE = 300.0f;        // metres; every level reaches twice as far
+const float TERRAIN_MORPH_FRACTION = 0.3f;      // last part of a range spent morphing
+const float TERRAIN_FLAT_HALF_SIZE = 80.0f;     // flat square around the track
+const float TERRAIN_RAMP = 500.0f;              // distance over which the hills grow to full height
+const float TERRAIN_HEIGHT = 140.0f;            // height scale of the hills
+const float TERRAIN_WAVELENGTH = 900.0f;        // size of the largest features
+const int TERRAIN_OCTAVES = 6;
+const float TERRAIN_FLAT_HEIGHT = -0.01f;       // just under the road and curbs, like the old floor
+
+struct TerrainChunk {
+    int texelX, texelZ;                         // heightmap texel of the chunk's first corner
+    Aabb bounds;
+};
+
+// Range of the shared index buffer that draws one level
+struct TerrainLod {
+    int firstIndex;
+    int indexCount;
+};
+
+// A chunk to draw this frame and its level
+struct TerrainDraw {
+    int chunk;
+    int lod;
+};
+
+// Hash-based value noise in [-1, 1]
+inline float terrainLattice(int x, int z, uint32_t seed)
+{
+    uint32_t h = static_cast<uint32_t>(x) * 374761393u + static_cast<uint32_t>(z) * 668265263u + seed * 2246822519u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    h ^= h >> 16;
+    return (h & 0xffffff) / float(0x7fffff) - 1.0f;
+}
+
+inline float terrainValueNoise(float x, float z, uint32_t seed)
+{
+    int x0 = static_cast<int>(std::floor(x)), z0 = static_cast<int>(std::floor(z));
+    float fx = x - x0, fz = z - z0;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fz = fz * fz * (3.0f - 2.0f * fz);
+    float a = terrainLattice(x0, z0, seed), b = terrainLattice(x0 + 1, z0, seed);
+    float c = terrainLattice(x0, z0 + 1, seed), d = terrainLattice(x0 + 1, z0 + 1, seed);
+    return a + (b - a) * fx + (c - a) * fz + (a - b - c + d) * fx * fz;
+}
+
+class Terrain {
+public:
+    void generate(uint32_t seed)
+    {
+        mapSize = TERRAIN_CHUNKS * TERRAIN_CHUNK_QUADS + 1;
+        mapOrigin = -0.5f * (mapSize - 1) * TERRAIN_SPACING;
+        heightData.assign(size_t(mapSize) * mapSize, 0.0f);
+        parallelFor(mapSize, 32, [&](int rowBegin, int rowEnd) {
+            for (int z = rowBegin; z < rowEnd; ++z)
+                for (int x = 0; x < mapSize; ++x)
+                    heightData[size_t(z) * mapSize + x] = generatedHeight(mapOrigin + x * TERRAIN_SPACING, mapOrigin + z * TERRAIN_SPACING, seed);
+        });
+
+        chunkList.clear();
+        chunkDiagonal = 0.0f;
+        float chunkSize = TERRAIN_CHUNK_QUADS * TERRAIN_SPACING;
+        for (int cz = 0; cz < TERRAIN_CHUNKS; ++cz) {
+            for (int cx = 0; cx < TERRAIN_CHUNKS; ++cx) {
+                TerrainChunk chunk;
+                chunk.texelX = cx * TERRAIN_CHUNK_QUADS;
+                chunk.texelZ = cz * TERRAIN_CHUNK_QUADS;
+                float lo = FLT_MAX, hi = -FLT_MAX;
+                for (int z = 0; z <= TERRAIN_CHUNK_QUADS; ++z)
+                    for (int x = 0; x <= TERRAIN_CHUNK_QUADS; ++x) {
+                        float h = texel(chunk.texelX + x, chunk.texelZ + z);
+                        lo = std::min(lo, h);
+                        hi = std::max(hi, h);
+                    }
+                glm::vec3 corner(mapOrigin + chunk.texelX * TERRAIN_SPACING, lo, mapOrigin + chunk.texelZ * TERRAIN_SPACING);
+                chunk.bounds = Aabb(corner, corner + glm::vec3(chunkSize, hi - lo, chunkSize));
+                chunkDiagonal = std::max(chunkDiagonal, glm::length(chunk.bounds.max - chunk.bounds.min));
+                chunkList.push_back(chunk);
+            }
+        }
+        if (chunkDiagonal >= TERRAIN_LOD0_RANGE)
+            std::cerr << "Terrain chunks (" << chunkDiagonal << " m across) are too large for the LOD ranges; "
+                      << "levels may crack" << std::endl;
+    }
+
+    bool empty() const { return heightData.empty(); }
+    int size() const { return mapSize; }                        // heights per side
+    float origin() const { return mapOrigin; }                  // world x and z of the first height
+    const float* heights() const { return heightData.data(); }
+    const std::vector<TerrainChunk>& chunks() const { return chunkList; }
+
+    // Height of the finest triangulation at world (x, z); 0 without a terrain
+    float heightAt(float x, float z) const
+    {
+        if (heightData.empty()) return 0.0f;
+        float gx = (x - mapOrigin) / TERRAIN_SPACING, gz = (z - mapOrigin) / TERRAIN_SPACING;
+        gx = std::min(std::max(gx, 0.0f), float(mapSize - 1) - 1e-3f);
+        gz = std::min(std::max(gz, 0.0f), float(mapSize - 1) - 1e-3f);
+        int ix = static_cast<int>(gx), iz = static_cast<int>(gz);
+        float fx = gx - ix, fz = gz - iz;
+        float h00 = texel(ix, iz), h11 = texel(ix + 1, iz + 1);
+        // Quads are split from (0, 0) to (1, 1), as in terrainLodIndices()
+        if (fx >= fz) return h00 + (texel(ix + 1, iz) - h00) * fx + (h11 - texel(ix + 1, iz)) * fz;
+        return h00 + (texel(ix, iz + 1) - h00) * fz + (h11 - texel(ix, iz + 1)) * fx;
+    }
+
+    // Chunks at least this far from the camera use a coarser level than lod
+    float lodRange(int lod) const { return lod + 1 < TERRAIN_LODS ? TERRAIN_LOD0_RANGE * float(1 << lod) : FLT_MAX; }
+
+    // Distances over which level lod morphs into lod + 1 (never, for the last level).
+    // The morph starts at least a chunk diagonal beyond the previous level's range, so a
+    // finer neighbour's vertices never reach it.
+    glm::vec2 morphRange(int lod) const
+    {
+        if (lod + 1 >= TERRAIN_LODS) return glm::vec2(1e30f, 2e30f);
+        float end = lodRange(lod);
+        float previous = lod > 0 ? lodRange(lod - 1) : 0.0f;
+        float start = std::max(end * (1.0f - TERRAIN_MORPH_FRACTION), previous + chunkDiagonal);
+        return glm::vec2(std::min(start, end - 1.0f), end);
+    }
+
+    // Triangles in one chunk drawn at level lod
+    static int lodTriangles(int lod)
+    {
+        int quads = TERRAIN_CHUNK_QUADS >> lod;
+        return 2 * quads * quads;
+    }
+
+    // Visible chunks and their levels; returns the triangle count
+    int select(const glm::vec3& camera, const Frustum& frustum, std::vector<TerrainDraw>& draws) const
+    {
+        draws.clear();
+        int triangles = 0;
+        for (int i = 0; i < static_cast<int>(chunkList.size()); ++i) {
+            const Aabb& box = chunkList[i].bounds;
+            if (!frustum.intersects(box)) continue;
+            float distance = glm::length(camera - glm::clamp(camera, box.min, box.max));
+            int lod = 0;
+            while (lod + 1 < TERRAIN_LODS && distance >= lodRange(lod)) ++lod;
+            draws.push_back(TerrainDraw{ i, lod });
+            triangles += lodTriangles(lod);
+        }
+        return triangles;
+    }
+
+    // Boxes that lie entirely under the surface, for occlusion culling: one per square of
+    // cellTexels quads whose lowest height is above minHeight, from the lowest height of
+    // the whole map up to the square's lowest height. Every level of detail only drops
+    // vertices and interpolates between the rest, so no level dips into a box as long as
+    // each square is made of whole quads of the coarsest level: a smaller square would be
+    // crossed by coarse triangles interpolating heights from outside it, which can run
+    // below its lowest height. cellTexels must be a multiple of the coarsest step.
+    std::vector<Aabb> occluderBoxes(int cellTexels, float minHeight) const
+    {
+        assert(cellTexels > 0 && cellTexels % (1 << (TERRAIN_LODS - 1)) == 0 &&
+               "terrain occluder squares must be whole quads of the coarsest level");
+        std::vector<Aabb> boxes;
+        if (heightData.empty()) return boxes;
+        float bottom = *std::min_element(heightData.begin(), heightData.end());
+        for (int cz = 0; cz + cellTexels < mapSize; cz += cellTexels)
+            for (int cx = 0; cx + cellTexels < mapSize; cx += cellTexels) {
+                float lo = FLT_MAX;
+                for (int z = 0; z <= cellTexels; ++z)
+                    for (int x = 0; x <= cellTexels; ++x) lo = std::min(lo, texel(cx + x, cz + z));
+                if (lo <= minHeight) continue;
+                glm::vec3 corner(mapOrigin + cx * TERRAIN_SPACING, bottom, mapOrigin + cz * TERRAIN_SPACING);
+                boxes.push_back(Aabb(corner, glm::vec3(corner.x + cellTexels * TERRAIN_SPACING, lo,
+                                                       corner.z + cellTexels * TERRAIN_SPACING)));
+            }
+        return boxes;
+    }
+
+    size_t memoryBytes() const { return vectorBytes(heightData) + vectorBytes(chunkList); }
+
+private:
+    std::vector<float> heightData;
+    std::vector<TerrainChunk> chunkList;
+    int mapSize = 0;
+    float mapOrigin = 0.0f;
+    float chunkDiagonal = 0.0f;
+
+    float texel(int x, int z) const { return heightData[size_t(z) * mapSize + x]; }
+
+    static float generatedHeight(float x, float z, uint32_t seed)
+    {
+        // Distance outside the flat square decides how much of the hills show
+        float outside = std::max(std::fabs(x), std::fabs(z)) - TERRAIN_FLAT_HALF_SIZE;
+        float ramp = std::min(1.0f, std::max(0.0f, outside / TERRAIN_RAMP));
+        ramp = ramp * ramp * (3.0f - 2.0f * ramp);
+        if (ramp <= 0.0f) return TERRAIN_FLAT_HEIGHT;
+        float sum = 0.0f, amplitude = 1.0f, frequency = 1.0f / TERRAIN_WAVELENGTH;
+        for (int octave = 0; octave < TERRAIN_OCTAVES; ++octave) {
+            sum += terrainValueNoise(x * frequency, z * frequency, seed + octave) * amplitude;
+            amplitude *= 0.5f;
+            frequency *= 2.0f;
+        }
+        return TERRAIN_FLAT_HEIGHT + (sum * 0.5f + 0.5f) * TERRAIN_HEIGHT * ramp;
+    }
+};
+
+// The mesh every chunk is drawn with: the finest grid's coordinates as (x, z) pairs
+inline std::vector<float> terrainGridVertices()
+{
+    std::vector<float> vertices;
+    for (int z = 0; z <= TERRAIN_CHUNK_QUADS; ++z)
+        for (int x = 0; x <= TERRAIN_CHUNK_QUADS; ++x) {
+            vertices.push_back(float(x));
+            vertices.push_back(float(z));
+        }
+    return vertices;
+}
+
+// Triangle lists of every level into one index buffer
+inline std::vector<uint16_t> terrainLodIndices(TerrainLod lods[TERRAIN_LODS])
+{
+    std::vector<uint16_t> indices;
+    const int row = TERRAIN_CHUNK_QUADS + 1;
+    for (int lod = 0; lod < TERRAIN_LODS; ++lod) {
+        int step = 1 << lod;
+        lods[lod].firstIndex = static_cast<int>(indices.size());
+        for (int z = 0; z < TERRAIN_CHUNK_QUADS; z += step) {
+            for (int x = 0; x < TERRAIN_CHUNK_QUADS; x += step) {
+                uint16_t v00 = uint16_t(z * row + x), v10 = uint16_t(z * row + x + step);
+                uint16_t v01 = uint16_t((z + step) * row + x), v11 = uint16_t((z + step) * row + x + step);
+                const uint16_t quad[6] = { v00, v11, v10, v00, v01, v11 };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+        lods[lod].indexCount = static_cast<int>(indices.size()) - lods[lod].firstIndex;
+    }
+    return indices;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+// Screenshots larger than any framebuffer: the image is cut into tiles, each rendered on
+// its own with an off-centre version of the normal projection, read back and written
+// straight into its place in the output file.
+//
+// tileProjection() narrows a projection to one tile: it scales and shifts clip space so
+// the tile's part of the view fills [-1, 1], which is the same as building the frustum
+// for that sub-rectangle. The output is an uncompressed bottom-up TGA, so every pixel has
+// a fixed offset and tiles can be written in any order without holding the image in
+// memory: the writer only keeps one row of converted pixels.
+
+const int SCREENSHOT_MAX_SIZE = 65535;          // TGA stores 16-bit dimensions
+
+// Projection for the tile at pixel (x, y) (bottom-left), w x h, of an imageWidth x imageHeight image
+inline glm::mat4 tileProjection(const glm::mat4& projection, int imageWidth, int imageHeight, int x, int y, int w, int h)
+{
+    float scaleX = float(imageWidth) / w;
+    float scaleY = float(imageHeight) / h;
+    glm::mat4 narrow(1.0f);
+    narrow[0][0] = scaleX;
+    narrow[1][1] = scaleY;
+    narrow[3][0] = scaleX - 1.0f - 2.0f * x / w;
+    narrow[3][1] = scaleY - 1.0f - 2.0f * y / h;
+    return narrow * projection;
+}
+
+class TgaTileWriter {
+public:
+    ~TgaTileWriter() { close(); }
+
+    // Create the file at its full size; false (with a message) on failure
+    bool open(const std::string& path, int imageWidth, int imageHeight)
+    {
+        close();
+        if (imageWidth <= 0 || imageHeight <= 0 || imageWidth > SCREENSHOT_MAX_SIZE || imageHeight > SCREENSHOT_MAX_SIZE) {
+            std::cerr << "Screenshot size " << imageWidth << "x" << imageHeight << " is not supported" << std::endl;
+            return false;
+        }
+        file = fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Failed to create screenshot " << path << std::endl;
+            return false;
+        }
+        width = imageWidth;
+        height = imageHeight;
+        const uint8_t header[18] = { 0, 0, 2,                  // no id, no colour map, uncompressed true colour
+                                     0, 0, 0, 0, 0,            // colour map spec
+                                     0, 0, 0, 0,               // origin
+                                     uint8_t(width), uint8_t(width >> 8), uint8_t(height), uint8_t(height >> 8),
+                                     24, 0 };                  // BGR, bottom-left origin
+        ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+        // Extend the file to its final size so tiles can be written in any order
+        ok = ok && seek(pixelOffset(width - 1, height - 1) + 2) && fputc(0, file) != EOF;
+        return ok;
+    }
+
+    // Write a tile of RGBA8 pixels, rows bottom to top as glReadPixels returns them
+    void writeTile(int x, int y, int w, int h, const uint8_t* rgba)
+    {
+        if (!file) return;
+        row.resize(size_t(w) * 3);
+        for (int r = 0; r < h; ++r) {
+            const uint8_t* src = rgba + size_t(r) * w * 4;
+            for (int i = 0; i < w; ++i) {
+                row[i * 3 + 0] = src[i * 4 + 2];
+                row[i * 3 + 1] = src[i * 4 + 1];
+                row[i * 3 + 2] = src[i * 4 + 0];
+            }
+            ok = ok && seek(pixelOffset(x, y + r)) && fwrite(row.data(), 1, row.size(), file) == row.size();
+        }
+    }
+
+    // False if anything failed to write
+    bool close()
+    {
+        if (!file) return ok;
+        if (fclose(file) != 0) ok = false;
+        file = nullptr;
+        row = std::vector<uint8_t>();
+        return ok;
+    }
+
+private:
+    FILE* file = nullptr;
+    int width = 0, height = 0;
+    bool ok = false;
+    std::vector<uint8_t> row;
+
+    // Offsets pass 4 GB at the largest sizes, beyond a 32-bit long (as on Windows)
+    int64_t pixelOffset(int x, int y) const { return 18 + (int64_t(y) * width + x) * 3; }
+
+    bool seek(int64_t offset)
+    {
+#ifdef _WIN32
+        return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+        return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    }
+};
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+
+// Track surfaces swept along a closed centreline.
+//
+// The centreline is a closed uniform Catmull-Rom spline through the scene's track points:
+// it passes through every point and its tangent is continuous everywhere, including where
+// the lap closes. The spline is sampled densely into an arc-length table and then cut into
+// sections of equal length (about TRACK_SECTION_LENGTH), so the mesh density does not
+// depend on how far apart the control points are. The track does not bank: each section's
+// lateral axis is the horizontal perpendicular of its tangent.
+//
+// The cross-section is a list of flat strips (road, curbs and shoulders) given as offsets
+// from the centreline. Every strip gets two vertices per section. U runs 0 to 1 across the
+// strip; V is the distance along the centreline in texture repeats, with the repeat length
+// stretched so that a whole number of repeats fits the lap, so the texture also runs on
+// across the start line.
+//
+// The lap is cut into chunks of TRACK_CHUNK_SECTIONS sections (the section count is
+// rounded to a whole number of chunks). Only the chunks' bounds are kept: buildChunk()
+// sweeps a chunk's vertices on demand, from any thread, so a long circuit never has to be
+// in memory at once (see Engine/TrackStreamer.h). Every chunk has the same topology, so
+// one short index list drawn with a base vertex serves them all; its indices are grouped
+// by surface. Each chunk's V starts in [0, 1): the offset is a whole number of repeats, so
+// neighbouring chunks still meet seamlessly, and V stays precise on long circuits.
+
+const float TRACK_SECTION_LENGTH = 1.0f;        // metres between cross-sections
+const int TRACK_CHUNK_SECTIONS = 24;            // sections per chunk
+const int TRACK_SPLINE_STEPS = 64;              // arc-length samples per control point
+const int TRACK_VERTEX_FLOATS = 8;              // position, colour, uv: the textured shader's layout
+
+enum TrackSurface { TRACK_ROAD, TRACK_CURB, TRACK_SHOULDER, TRACK_SURFACE_COUNT };
+
+const char* const TRACK_SURFACE_NAMES[] = { "road", "curbs", "shoulders" };
+
+// One strip of the cross-section, from offset `from` to offset `to` (positive is to the
+// right of the direction of travel)
+struct TrackStrip {
+    TrackSurface surface;
+    float from, to;
+    float height;                               // above the centreline, keeps the surfaces off the terrain
+    float textureLength;                        // metres per texture repeat along the track
+};
+
+// Same widths, heights and texture repeats as the old road and curb quads
+const TrackStrip TRACK_PROFILE[] = {
+    { TRACK_ROAD,     -1.5f,  1.5f, 0.001f, 10.0f },
+    { TRACK_CURB,     -1.8f, -1.5f, 0.003f,  2.0f },
+    { TRACK_CURB,      1.5f,  1.8f, 0.003f,  2.0f },
+    { TRACK_SHOULDER, -4.0f, -1.8f, 0.002f,  2.2f },
+    { TRACK_SHOULDER,  1.8f,  4.0f, 0.002f,  2.2f },
+};
+const int TRACK_STRIP_COUNT = sizeof(TRACK_PROFILE) / sizeof(TRACK_PROFILE[0]);
+
+// Vertices in one chunk: a row of two per section boundary for every strip
+const int TRACK_CHUNK_VERTICES = TRACK_STRIP_COUNT * (TRACK_CHUNK_SECTIONS + 1) * 2;
+const int TRACK_CHUNK_FLOATS = TRACK_CHUNK_VERTICES * TRACK_VERTEX_FLOATS;
+
+struct TrackChunk {
+    int firstSection;
+    Aabb bounds;
+};
+
+// Range of the shared chunk index list that draws one surface
+struct TrackSurfaceRange {
+    int firstIndex;
+    int indexCount;
+};
+
+// Index list of one chunk (relative to its first vertex), grouped by surface; triangles face up
+inline std::vector<uint16_t> trackChunkIndices(TrackSurfaceRange (&surfaces)[TRACK_SURFACE_COUNT])
+{
+    std::vector<uint16_t> indices;
+    for (int surface = 0; surface < TRACK_SURFACE_COUNT; ++surface) {
+        surfaces[surface].firstIndex = static_cast<int>(indices.size());
+        for (int strip = 0; strip < TRACK_STRIP_COUNT; ++strip) {
+            if (TRACK_PROFILE[strip].surface != surface) continue;
+            int base = strip * (TRACK_CHUNK_SECTIONS + 1) * 2;
+            for (int s = 0; s < TRACK_CHUNK_SECTIONS; ++s) {
+                uint16_t a = static_cast<uint16_t>(base + s * 2), b = a + 1, c = a + 2, d = a + 3;   // from, to; next from, next to
+                indices.insert(indices.end(), { a, b, c, b, d, c });
+            }
+        }
+        surfaces[surface].indexCount = static_cast<int>(indices.size()) - surfaces[surface].firstIndex;
+    }
+    return indices;
+}
+
+class TrackMesh {
+public:
+    // Lay out the lap through the closed loop of control points; false (with a message) if
+    // there are too few of them
+    bool build(const std::vector<glm::vec3>& controlPoints)
+    {
+        points = controlPoints;
+        chunkList.clear();
+        arcLengths.clear();
+        trackLength = 0.0f;
+        sectionCount = 0;
+        if (points.size() < 4) {
+            std::cerr << "Track needs at least 4 control points, got " << points.size() << std::endl;
+            return false;
+        }
+
+        // Arc length at every spline sample
+        int samples = static_cast<int>(points.size()) * TRACK_SPLINE_STEPS;
+        arcLengths.resize(samples + 1);
+        arcLengths[0] = 0.0f;
+        glm::vec3 previous = splinePoint(0.0f);
+        for (int i = 1; i <= samples; ++i) {
+            glm::vec3 p = splinePoint(float(i) / TRACK_SPLINE_STEPS);
+            arcLengths[i] = arcLengths[i - 1] + glm::length(p - previous);
+            previous = p;
+        }
+        trackLength = arcLengths[samples];
+        if (trackLength <= 0.0f) {
+            std::cerr << "Track control points are all in one place" << std::endl;
+            return false;
+        }
+        int chunkCount = std::max(1, static_cast<int>(std::lround(trackLength / (TRACK_SECTION_LENGTH * TRACK_CHUNK_SECTIONS))));
+        sectionCount = chunkCount * TRACK_CHUNK_SECTIONS;
+
+        // Chunk bounds from the outer edges of the cross-section
+        float left = 0.0f, right = 0.0f, low = 0.0f, high = 0.0f;
+        for (const TrackStrip& strip : TRACK_PROFILE) {
+            left = std::min(left, strip.from);
+            right = std::max(right, strip.to);
+            low = std::min(low, strip.height);
+            high = std::max(high, strip.height);
+        }
+        chunkList.resize(chunkCount);
+        for (int c = 0; c < chunkCount; ++c) {
+            TrackChunk& chunk = chunkList[c];
+            chunk.firstSection = c * TRACK_CHUNK_SECTIONS;
+            chunk.bounds = Aabb();
+            for (int s = 0; s <= TRACK_CHUNK_SECTIONS; ++s) {
+                glm::vec3 centre, lateral;
+                sectionFrame(chunk.firstSection + s, centre, lateral);
+                chunk.bounds.grow(centre + lateral * left + glm::vec3(0.0f, low, 0.0f));
+                chunk.bounds.grow(centre + lateral * right + glm::vec3(0.0f, high, 0.0f));
+            }
+        }
+        return true;
+    }
+
+    // Sweep one chunk into TRACK_CHUNK_FLOATS floats at `out`; safe to call from several threads
+    void buildChunk(int chunk, float* out) const
+    {
+        int first = chunkList[chunk].firstSection;
+        glm::vec3 centres[TRACK_CHUNK_SECTIONS + 1], laterals[TRACK_CHUNK_SECTIONS + 1];
+        for (int s = 0; s <= TRACK_CHUNK_SECTIONS; ++s) sectionFrame(first + s, centres[s], laterals[s]);
+
+        for (const TrackStrip& strip : TRACK_PROFILE) {
+            float repeats = std::max(1.0f, std::round(trackLength / strip.textureLength));
+            double perSection = double(repeats) / sectionCount;
+            double vStart = std::floor(perSection * first);
+            glm::vec3 lift(0.0f, strip.height, 0.0f);
+            for (int s = 0; s <= TRACK_CHUNK_SECTIONS; ++s) {
+                float v = static_cast<float>(perSection * (first + s) - vStart);
+                glm::vec3 from = centres[s] + laterals[s] * strip.from + lift;
+                glm::vec3 to = centres[s] + laterals[s] * strip.to + lift;
+                const float vertices[2 * TRACK_VERTEX_FLOATS] = { from.x, from.y, from.z, 1, 1, 1, 0.0f, v,
+                                                                  to.x, to.y, to.z, 1, 1, 1, 1.0f, v };
+                std::copy(vertices, vertices + 2 * TRACK_VERTEX_FLOATS, out);
+                out += 2 * TRACK_VERTEX_FLOATS;
+            }
+        }
+    }
+
+    // Centreline position and unit tangent at a distance along the lap
+    void frameAt(float distance, glm::vec3& position, glm::vec3& tangent) const
+    {
+        float t = parameterAt(distance);
+        position = splinePoint(t);
+        tangent = splineTangent(t);
+        float length = glm::length(tangent);
+        tangent = length > 0.0f ? tangent / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+
+    float length() const { return trackLength; }
+    int sections() const { return sectionCount; }
+    const std::vector<TrackChunk>& chunks() const { return chunkList; }
+
+    size_t memoryBytes() const
+    {
+        return points.capacity() * sizeof(glm::vec3) + arcLengths.capacity() * sizeof(float) +
+               chunkList.capacity() * sizeof(TrackChunk);
+    }
+
+private:
+    std::vector<glm::vec3> points;
+    std::vector<float> arcLengths;              // at spline parameter i / TRACK_SPLINE_STEPS
+    std::vector<TrackChunk> chunkList;
+    float trackLength = 0.0f;
+    int sectionCount = 0;
+
+    // Centre and lateral axis at the start of a section (section sectionCount closes the lap)
+    void sectionFrame(int section, glm::vec3& centre, glm::vec3& lateral) const
+    {
+        glm::vec3 tangent;
+        frameAt(static_cast<float>(double(trackLength) * (section % sectionCount) / sectionCount), centre, tangent);
+        lateral = glm::normalize(glm::vec3(-tangent.z, 0.0f, tangent.x));
+    }
+
+    const glm::vec3& point(int i) const
+    {
+        int n = static_cast<int>(points.size());
+        return points[((i % n) + n) % n];
+    }
+
+    // Spline parameter t runs from 0 to the number of points; segment i is between points i and i + 1
+    glm::vec3 splinePoint(float t) const
+    {
+        int i = static_cast<int>(std::floor(t));
+        float u = t - i;
+        const glm::vec3 &p0 = point(i - 1), &p1 = point(i), &p2 = point(i + 1), &p3 = point(i + 2);
+        return 0.5f * (2.0f * p1 + (p2 - p0) * u + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * (u * u) +
+                       (3.0f * p1 - p0 - 3.0f * p2 + p3) * (u * u * u));
+    }
+
+    glm::vec3 splineTangent(float t) const
+    {
+        int i = static_cast<int>(std::floor(t));
+        float u = t - i;
+        const glm::vec3 &p0 = point(i - 1), &p1 = point(i), &p2 = point(i + 1), &p3 = point(i + 2);
+        return 0.5f * ((p2 - p0) + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * (2.0f * u) +
+                       (3.0f * p1 - p0 - 3.0f * p2 + p3) * (3.0f * u * u));
+    }
+
+    // Spline parameter at a distance along the lap, interpolated in the arc-length table
+    float parameterAt(float distance) const
+    {
+        distance = std::fmod(distance, trackLength);
+        if (distance < 0.0f) distance += trackLength;
+        int i = static_cast<int>(std::upper_bound(arcLengths.begin(), arcLengths.end(), distance) - arcLengths.begin()) - 1;
+        i = std::max(0, std::min(i, static_cast<int>(arcLengths.size()) - 2));
+        float span = arcLengths[i + 1] - arcLengths[i];
+        float f = span > 0.0f ? (distance - arcLengths[i]) / span : 0.0f;
+        return (i + f) / TRACK_SPLINE_STEPS;
+    }
+};
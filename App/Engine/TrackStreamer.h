@@ -0,0 +1,308 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "ResourceRegistry.h"
+#include "TrackMesh.h"
+
+// Streams the track's chunks (Engine/TrackMesh.h) in and out around a focus point, so GPU
+// memory stays the same however long the circuit is.
+//
+// The vertex buffer is a ring of TRACK_STREAM_SLOTS fixed-size slots, one chunk each; all
+// chunks share one index buffer and are drawn with a base vertex. Where the driver has
+// ARB_buffer_storage the ring is mapped once, persistently and coherently, and the decode
+// jobs sweep chunks straight into it. Otherwise they sweep into a CPU copy of the ring and
+// commit() copies each new chunk through an unsynchronized mapping.
+//
+// Each frame update() drops chunks that have moved out of range and starts decode jobs for
+// the nearest missing ones, at most TRACK_STREAM_MAX_LOADS per frame, as children of the
+// frame's job, so they run on the workers alongside culling and are done when the frame
+// graph is. A chunk dropped in frame F was last drawn in frame F - 1; its slot is only
+// written again once the fence placed after that frame has passed, so the CPU never
+// overwrites vertices the GPU may still read, and never waits for it either: a load with
+// no reusable slot is simply retried next frame. Loads start well before a chunk can be
+// seen (TRACK_STREAM_RADIUS is far beyond the road's visible detail), so a chunk that is
+// a frame or two late never shows.
+
+const int TRACK_STREAM_SLOTS = 64;              // resident chunks: 64 * 24 m of track
+const float TRACK_STREAM_RADIUS = 400.0f;       // chunks whose bounds are this close are loaded
+const float TRACK_STREAM_KEEP = 1.25f;          // and dropped beyond this times the radius
+const int TRACK_STREAM_MAX_LOADS = 8;           // decode jobs started per frame
+
+// Since the last resetStats(), except resident
+struct TrackStreamStats {
+    int resident = 0;                           // chunks ready to draw
+    int loads = 0;
+    int evictions = 0;
+    int deferred = 0;                           // loads put off for want of a free slot
+};
+
+class TrackStreamer {
+public:
+    bool init(const TrackMesh& trackMesh)
+    {
+        track = &trackMesh;
+        chunkSlots.assign(track->chunks().size(), -1);
+        for (Slot& slot : slots) slot = Slot();
+        frame = 0;
+        completedFrame = -1;
+
+        glGenVertexArrays(1, &vertexArrayId);
+        glGenBuffers(1, &vertexBuffer);
+        glGenBuffers(1, &indexBuffer);
+        glBindVertexArray(vertexArrayId);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        size_t bytes = ringBytes();
+        persistent = GLEW_ARB_buffer_storage;
+        if (persistent) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, bytes, NULL, flags);
+            mapped = static_cast<float*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags));
+            if (!mapped) {
+                std::cerr << "Failed to map the track ring buffer persistently, copying chunks instead" << std::endl;
+                glDeleteBuffers(1, &vertexBuffer);             // storage is immutable: start again
+                glGenBuffers(1, &vertexBuffer);
+                glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+                persistent = false;
+            }
+        }
+        if (!persistent) {
+            glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);
+            staging.assign(size_t(TRACK_STREAM_SLOTS) * TRACK_CHUNK_FLOATS, 0.0f);
+        }
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, TRACK_VERTEX_FLOATS * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, TRACK_VERTEX_FLOATS * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, TRACK_VERTEX_FLOATS * sizeof(float), (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+
+        std::vector<uint16_t> indices = trackChunkIndices(surfaceRanges);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        resources().trackGpu(GPU_VERTEX_ARRAY, vertexArrayId, 0, "track");
+        resources().trackGpu(GPU_BUFFER, vertexBuffer, bytes, "track");
+        resources().trackGpu(GPU_BUFFER, indexBuffer, indices.size() * sizeof(uint16_t), "track");
+        return true;
+    }
+
+    void destroy()
+    {
+        for (const std::pair<int64_t, GLsync>& fence : fences) glDeleteSync(fence.second);
+        fences.clear();
+        if (mapped) {
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            mapped = nullptr;
+        }
+        resources().releaseGpu(GPU_VERTEX_ARRAY, vertexArrayId);
+        resources().releaseGpu(GPU_BUFFER, vertexBuffer);
+        resources().releaseGpu(GPU_BUFFER, indexBuffer);
+        glDeleteVertexArrays(1, &vertexArrayId);
+        glDeleteBuffers(1, &vertexBuffer);
+        glDeleteBuffers(1, &indexBuffer);
+        vertexArrayId = vertexBuffer = indexBuffer = 0;
+        staging = std::vector<float>();
+    }
+
+    // Main thread, before the frame's draws: drop chunks out of range and start decoding the
+    // nearest missing ones as children of `parent`. Call commit() once `parent` has finished.
+    void update(const glm::vec3& focus, JobSystem& jobs, Job* parent)
+    {
+        PROFILE_ZONE("track streaming");
+        retireFences();
+        const std::vector<TrackChunk>& chunks = track->chunks();
+
+        for (int s = 0; s < TRACK_STREAM_SLOTS; ++s)
+            if (slots[s].chunk >= 0 && distance(focus, chunks[slots[s].chunk].bounds) > TRACK_STREAM_RADIUS * TRACK_STREAM_KEEP)
+                evict(s);
+
+        wanted.clear();
+        for (int c = 0; c < static_cast<int>(chunks.size()); ++c) {
+            if (chunkSlots[c] >= 0) continue;
+            float d = distance(focus, chunks[c].bounds);
+            if (d <= TRACK_STREAM_RADIUS) wanted.push_back(std::make_pair(d, c));
+        }
+        size_t count = std::min(wanted.size(), size_t(TRACK_STREAM_MAX_LOADS));
+        std::partial_sort(wanted.begin(), wanted.begin() + count, wanted.end());
+
+        for (size_t i = 0; i < count; ++i) {
+            int s = freeSlot();
+            if (s < 0) {
+                // Make room by dropping the farthest chunk, if it is farther than this one;
+                // its slot becomes free once the GPU is done with it
+                int farthest = -1;
+                float farthestDistance = wanted[i].first;
+                for (int r = 0; r < TRACK_STREAM_SLOTS; ++r) {
+                    if (slots[r].chunk < 0 || !slots[r].ready) continue;
+                    float d = distance(focus, chunks[slots[r].chunk].bounds);
+                    if (d > farthestDistance) {
+                        farthest = r;
+                        farthestDistance = d;
+                    }
+                }
+                if (farthest >= 0) evict(farthest);
+                stats.deferred += static_cast<int>(count - i);
+                break;
+            }
+            int c = wanted[i].second;
+            slots[s].chunk = c;
+            slots[s].ready = false;
+            chunkSlots[c] = s;
+            loading.push_back(s);
+            float* destination = slotVertices(s);
+            const TrackMesh* mesh = track;
+            jobs.run(jobs.create([mesh, c, destination] {
+                PROFILE_ZONE("track chunk decode");
+                mesh->buildChunk(c, destination);
+            }, parent));
+        }
+    }
+
+    // Main thread, once the decode jobs have finished: make the new chunks drawable
+    void commit()
+    {
+        if (loading.empty()) return;
+        if (!persistent) {
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            for (int s : loading) {
+                const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+                void* target = glMapBufferRange(GL_ARRAY_BUFFER, slotOffset(s), slotBytes(), flags);
+                if (target) {
+                    std::copy(slotVertices(s), slotVertices(s) + TRACK_CHUNK_FLOATS, static_cast<float*>(target));
+                    glUnmapBuffer(GL_ARRAY_BUFFER);
+                } else {
+                    glBufferSubData(GL_ARRAY_BUFFER, slotOffset(s), slotBytes(), slotVertices(s));
+                }
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        for (int s : loading) slots[s].ready = true;
+        stats.loads += static_cast<int>(loading.size());
+        loading.clear();
+    }
+
+    // Load everything in range right away (at startup, or after the focus jumps)
+    void prefill(const glm::vec3& focus, JobSystem& jobs)
+    {
+        for (int round = 0; round < TRACK_STREAM_SLOTS; ++round) {
+            Job* batch = jobs.create(std::function<void()>());
+            update(focus, jobs, batch);
+            jobs.run(batch);
+            jobs.wait(batch);
+            bool loaded = !loading.empty();
+            commit();
+            if (!loaded) break;
+        }
+    }
+
+    // After the frame's track draws: fence them, so their slots can be reused once they are done
+    void endFrame()
+    {
+        fences.push_back(std::make_pair(frame, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)));
+        ++frame;
+    }
+
+    GLuint vertexArray() const { return vertexArrayId; }
+    const TrackSurfaceRange& surfaceRange(int surface) const { return surfaceRanges[surface]; }
+
+    // Chunk ready to draw from a slot, -1 if the slot is empty or still loading
+    int slotChunk(int slot) const { return slots[slot].ready ? slots[slot].chunk : -1; }
+    static int slotBaseVertex(int slot) { return slot * TRACK_CHUNK_VERTICES; }
+
+    bool persistentlyMapped() const { return persistent; }
+
+    TrackStreamStats streamStats() const
+    {
+        TrackStreamStats s = stats;
+        s.resident = 0;
+        for (const Slot& slot : slots) s.resident += slot.ready && slot.chunk >= 0;
+        return s;
+    }
+
+    void resetStats() { stats = TrackStreamStats(); }
+
+    // CPU side: the chunk -> slot table, plus the staging ring without persistent mapping
+    size_t memoryBytes() const
+    {
+        return chunkSlots.capacity() * sizeof(int) + staging.capacity() * sizeof(float) +
+               wanted.capacity() * sizeof(std::pair<float, int>) + loading.capacity() * sizeof(int);
+    }
+
+private:
+    struct Slot {
+        int chunk = -1;
+        bool ready = false;
+        int64_t freedAfter = -1;                // reusable once this frame is complete on the GPU
+    };
+
+    const TrackMesh* track = nullptr;
+    GLuint vertexArrayId = 0, vertexBuffer = 0, indexBuffer = 0;
+    TrackSurfaceRange surfaceRanges[TRACK_SURFACE_COUNT] = {};
+    bool persistent = false;
+    float* mapped = nullptr;
+    std::vector<float> staging;
+    Slot slots[TRACK_STREAM_SLOTS];
+    std::vector<int> chunkSlots;                // per chunk, -1 when not resident
+    std::vector<std::pair<float, int>> wanted;  // distance, chunk
+    std::vector<int> loading;                   // slots being decoded this frame
+    std::deque<std::pair<int64_t, GLsync>> fences;
+    int64_t frame = 0;
+    int64_t completedFrame = -1;
+    TrackStreamStats stats;
+
+    static size_t slotBytes() { return size_t(TRACK_CHUNK_FLOATS) * sizeof(float); }
+    static size_t ringBytes() { return slotBytes() * TRACK_STREAM_SLOTS; }
+    static GLintptr slotOffset(int slot) { return static_cast<GLintptr>(slotBytes() * slot); }
+
+    float* slotVertices(int slot)
+    {
+        float* ring = persistent ? mapped : staging.data();
+        return ring + size_t(slot) * TRACK_CHUNK_FLOATS;
+    }
+
+    static float distance(const glm::vec3& point, const Aabb& box)
+    {
+        return glm::length(point - glm::clamp(point, box.min, box.max));
+    }
+
+    // Advance completedFrame past every fence that has passed, without waiting
+    void retireFences()
+    {
+        while (!fences.empty()) {
+            GLenum status = glClientWaitSync(fences.front().second, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+            completedFrame = fences.front().first;
+            glDeleteSync(fences.front().second);
+            fences.pop_front();
+        }
+    }
+
+    void evict(int slot)
+    {
+        chunkSlots[slots[slot].chunk] = -1;
+        slots[slot].chunk = -1;
+        slots[slot].ready = false;
+        slots[slot].freedAfter = frame - 1;
+        ++stats.evictions;
+    }
+
+    int freeSlot() const
+    {
+        for (int s = 0; s < TRACK_STREAM_SLOTS; ++s)
+            if (slots[s].chunk < 0 && slots[s].freedAfter <= completedFrame) return s;
+        return -1;
+    }
+};
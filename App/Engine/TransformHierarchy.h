@@ -0,0 +1,163 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "TransformKernels.h"
+
+// Flat transform hierarchy (scene graph without pointers).
+//
+// Nodes live in arrays indexed by node id. A node's parent always has a smaller id, so
+// one pass in id order is a valid topological order: by the time a node is visited its
+// parent's world transform is final. Setting a local component marks the node dirty; the
+// update recomputes the world transform only for dirty nodes and for nodes whose parent's
+// world changed this update, and leaves everything else cached.
+//
+// World transforms are kept as translation/rotation/scale in SoA form rather than as
+// matrices: propagating them is a quaternion product and a rotated offset per node, and
+// composeWorldMatrices() turns any block of them into mat4 instance data with the SIMD
+// kernel, straight into a mapped buffer. This is exact as long as every node that has
+// children is uniformly scaled (non-uniform scale only on leaves), which holds for all
+// the rigs in the scene; a sheared world matrix cannot be represented.
+//
+// Nodes of one kind can be added as a contiguous block (all car bodies, all wheels...),
+// so a block is laid out in instance order for glDrawElementsInstanced. updateRange()
+// lets a caller split one "level" of such blocks across jobs, as long as no node in the
+// range is the parent of another node in the same range.
+
+inline glm::mat4 composeTrs(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+    glm::mat3 r = glm::mat3_cast(rotation);
+    return glm::mat4(glm::vec4(r[0] * scale.x, 0.0f),
+                     glm::vec4(r[1] * scale.y, 0.0f),
+                     glm::vec4(r[2] * scale.z, 0.0f),
+                     glm::vec4(translation, 1.0f));
+}
+
+struct TransformHierarchy {
+    std::vector<int> parent;                    // -1 for roots, else < own index
+    std::vector<glm::vec3> localPosition;
+    std::vector<glm::quat> localRotation;
+    std::vector<glm::vec3> localScale;
+    TrsArrays world;
+    std::vector<uint8_t> dirty;                 // local TRS changed since the last update
+    std::vector<uint32_t> changedInUpdate;      // update number that last rewrote world i
+    uint32_t updateNumber = 1;
+
+    int size() const { return static_cast<int>(parent.size()); }
+
+    size_t memoryBytes() const
+    {
+        return vectorBytes(parent) + vectorBytes(localPosition) + vectorBytes(localRotation) + vectorBytes(localScale) +
+               world.memoryBytes() + vectorBytes(dirty) + vectorBytes(changedInUpdate);
+    }
+
+    // Parents must be added before their children
+    int add(int parentIndex,
+            const glm::vec3& position = glm::vec3(0.0f),
+            const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+            const glm::vec3& scale = glm::vec3(1.0f))
+    {
+        int index = size();
+        parent.push_back(parentIndex < index ? parentIndex : -1);
+        localPosition.push_back(position);
+        localRotation.push_back(rotation);
+        localScale.push_back(scale);
+        world.resize(index + 1);
+        dirty.push_back(1);
+        changedInUpdate.push_back(0);
+        return index;
+    }
+
+    void clear()
+    {
+        parent.clear();
+        localPosition.clear();
+        localRotation.clear();
+        localScale.clear();
+        world.clear();
+        dirty.clear();
+        changedInUpdate.clear();
+    }
+
+    // Setters only dirty the node when the value really changes, so a parked car or a
+    // paused animation costs nothing in the update
+    void setLocalPosition(int i, const glm::vec3& p)
+    {
+        if (p == localPosition[i]) return;
+        localPosition[i] = p;
+        dirty[i] = 1;
+    }
+
+    void setLocalRotation(int i, const glm::quat& r)
+    {
+        const glm::quat& old = localRotation[i];
+        if (r.x == old.x && r.y == old.y && r.z == old.z && r.w == old.w) return;
+        localRotation[i] = r;
+        dirty[i] = 1;
+    }
+
+    void setLocalScale(int i, const glm::vec3& s)
+    {
+        if (s == localScale[i]) return;
+        localScale[i] = s;
+        dirty[i] = 1;
+    }
+
+    void setLocal(int i, const glm::vec3& p, const glm::quat& r)
+    {
+        setLocalPosition(i, p);
+        setLocalRotation(i, r);
+    }
+
+    // True if world transform i was recomputed by the current (or just finished) update
+    bool worldChanged(int i) const { return changedInUpdate[i] == updateNumber; }
+
+    // Call once before the updateRange() calls of a frame
+    void beginUpdate() { ++updateNumber; }
+
+    glm::vec3 worldPosition(int i) const { return glm::vec3(world.px[i], world.py[i], world.pz[i]); }
+    glm::quat worldRotation(int i) const { return glm::quat(world.qw[i], world.qx[i], world.qy[i], world.qz[i]); }
+    glm::vec3 worldScale(int i) const { return glm::vec3(world.sx[i], world.sy[i], world.sz[i]); }
+    glm::mat4 worldMatrix(int i) const { return composeTrs(worldPosition(i), worldRotation(i), worldScale(i)); }
+
+    // World matrices of nodes [begin, end) (or of nodes indices[begin..end)), 16 floats each
+    void composeWorldMatrices(int begin, int end, float* out) const { composeTrsMatrices(world, begin, end, out); }
+    void composeWorldMatrices(const int* indices, int begin, int end, float* out) const
+    {
+        composeTrsMatrices(world, indices, begin, end, out);
+    }
+
+    // Recompute the stale world transforms in [begin, end)
+    void updateRange(int begin, int end)
+    {
+        for (int i = begin; i < end; ++i) {
+            int p = parent[i];
+            bool parentChanged = p >= 0 && changedInUpdate[p] == updateNumber;
+            if (!dirty[i] && !parentChanged) continue;
+            glm::vec3 position = localPosition[i];
+            glm::quat rotation = localRotation[i];
+            glm::vec3 scale = localScale[i];
+            if (p >= 0) {
+                glm::quat parentRotation = worldRotation(p);
+                glm::vec3 parentScale = worldScale(p);
+                position = worldPosition(p) + parentRotation * (parentScale * position);
+                rotation = parentRotation * rotation;
+                scale = parentScale * scale;
+            }
+            world.px[i] = position.x; world.py[i] = position.y; world.pz[i] = position.z;
+            world.qx[i] = rotation.x; world.qy[i] = rotation.y; world.qz[i] = rotation.z; world.qw[i] = rotation.w;
+            world.sx[i] = scale.x; world.sy[i] = scale.y; world.sz[i] = scale.z;
+            dirty[i] = 0;
+            changedInUpdate[i] = updateNumber;
+        }
+    }
+
+    // Single topologically ordered pass over every node
+    void update()
+    {
+        beginUpdate();
+        updateRange(0, size());
+    }
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "SimdMath.h"
+#include "ResourceRegistry.h"
+
+// Batched vehicle dynamics: rigid body + 4 raycast suspensions + Pacejka tires.
+//
+// State is structure-of-arrays so the solver steps 4 cars per SIMD lane group.
+// Conventions match the renderer: heading is the model rotation about +Y,
+// forward = (sin heading, 0, cos heading), local +x is the car's left,
+// wheel i sits at (WHEEL_X[i], WHEEL_Z[i]) with front wheels at +z.
+//
+// Ground contact is a scalar pre-pass: probeVehicleGround() casts each wheel's ray
+// against whatever the caller supplies (flat floor, terrain, ...) and stores the hit
+// height, so the SIMD step never calls back into scene code.
+
+const int VEHICLE_WHEELS = 4;
+const float WHEEL_X[VEHICLE_WHEELS] = {  0.75f,  0.75f, -0.75f, -0.75f };  // left, left, right, right
+const float WHEEL_Z[VEHICLE_WHEELS] = {  1.10f, -1.10f,  1.10f, -1.10f };  // front, rear, front, rear
+const bool  WHEEL_STEERED[VEHICLE_WHEELS] = { true, false, true, false };
+const bool  WHEEL_DRIVEN[VEHICLE_WHEELS]  = { false, true, false, true };
+
+struct VehicleParams {
+    float mass          = 1200.0f;   // kg
+    float yawInertia    = 1600.0f;   // kg m^2
+    float pitchInertia  = 1500.0f;
+    float rollInertia   = 450.0f;
+    float cgHeight      = 0.35f;     // above the contact patches, for weight transfer
+    float wheelRadius   = 0.26f;
+    float springRate    = 35000.0f;  // N/m per corner
+    float damperRate    = 4000.0f;   // N s/m per corner
+    float maxSteer      = 0.436f;    // rad (25 degrees)
+    float steerSpeed    = 3.0f;      // rad/s towards the steering input
+    float engineForce   = 7000.0f;   // N at full throttle, split over driven wheels
+    float brakeForce    = 12000.0f;  // N at full brake, split over all wheels
+    float rollingResistance = 30.0f; // N per m/s per wheel
+    float dragCoefficient   = 0.45f; // N per (m/s)^2
+    float gravity       = 9.81f;
+
+    // Pacejka "magic formula" for lateral force: D sin(C atan(B a - E (B a - atan(B a))))
+    float tireB = 10.0f;
+    float tireC = 1.9f;
+    float tireE = 0.97f;
+    float tireMu = 1.0f;             // peak friction, D = mu * Fz
+    float slipMinSpeed = 3.0f;       // m/s, keeps slip angles sane when nearly stopped
+};
+
+struct VehicleBatch {
+    int count = 0;
+
+    // Rigid body
+    std::vector<float> posX, posY, posZ;
+    std::vector<float> velX, velY, velZ;
+    std::vector<float> heading, yawRate;
+    std::vector<float> pitch, pitchRate;
+    std::vector<float> roll, rollRate;
+
+    // Wheels / driver
+    std::vector<float> steer;        // current front wheel angle, rad
+    std::vector<float> wheelSpin;    // accumulated rolling angle, rad
+    std::vector<float> throttle;     // -1..1 (negative = reverse)
+    std::vector<float> brake;        // 0..1
+    std::vector<float> steerInput;   // -1..1 (positive = left)
+
+    // Per wheel
+    std::vector<float> groundY[VEHICLE_WHEELS];      // written by probeVehicleGround
+    std::vector<float> compression[VEHICLE_WHEELS];  // last step, for damping
+    std::vector<float> load[VEHICLE_WHEELS];         // normal force, N
+
+    // Storage is padded to a multiple of 4 so the solver never needs a scalar tail
+    int paddedCount() const { return (count + 3) & ~3; }
+
+    size_t memoryBytes() const
+    {
+        const std::vector<float>* fields[] = {
+            &posX, &posY, &posZ, &velX, &velY, &velZ, &heading, &yawRate,
+            &pitch, &pitchRate, &roll, &rollRate, &steer, &wheelSpin,
+            &throttle, &brake, &steerInput
+        };
+        size_t bytes = 0;
+        for (const std::vector<float>* f : fields) bytes += vectorBytes(*f);
+        for (int w = 0; w < VEHICLE_WHEELS; ++w)
+            bytes += vectorBytes(groundY[w]) + vectorBytes(compression[w]) + vectorBytes(load[w]);
+        return bytes;
+    }
+
+    int add(float x, float y, float z, float headingRadians)
+    {
+        int index = count++;
+        int padded = paddedCount();
+        std::vector<float>* fields[] = {
+            &posX, &posY, &posZ, &velX, &velY, &velZ, &heading, &yawRate,
+            &pitch, &pitchRate, &roll, &rollRate, &steer, &wheelSpin,
+            &throttle, &brake, &steerInput
+        };
+        // Slots can be reused after clear()/truncate(), so reset the new one explicitly
+        for (std::vector<float>* f : fields) {
+            f->resize(padded, 0.0f);
+            (*f)[index] = 0.0f;
+        }
+        for (int w = 0; w < VEHICLE_WHEELS; ++w) {
+            groundY[w].resize(padded, 0.0f);
+            compression[w].resize(padded, 0.0f);
+            load[w].resize(padded, 0.0f);
+            groundY[w][index] = compression[w][index] = load[w][index] = 0.0f;
+        }
+        posX[index] = x;
+        posY[index] = y;
+        posZ[index] = z;
+        heading[index] = headingRadians;
+        return index;
+    }
+
+    void clear()
+    {
+        count = 0;
+    }
+
+    // Drop every car from index `newCount` on
+    void truncate(int newCount)
+    {
+        if (newCount < count) count = std::max(0, newCount);
+    }
+};
+
+// Cast every wheel's suspension ray down onto the ground. groundHeight(x, z) -> y.
+template <typename GroundFn>
+void probeVehicleGround(VehicleBatch& batch, int begin, int end, GroundFn groundHeight)
+{
+    for (int i = begin; i < end; ++i) {
+        float s = sinf(batch.heading[i]);
+        float c = cosf(batch.heading[i]);
+        for (int w = 0; w < VEHICLE_WHEELS; ++w) {
+            // local x axis = (c, 0, -s), local z axis = (s, 0, c)
+            float x = batch.posX[i] + WHEEL_X[w] * c + WHEEL_Z[w] * s;
+            float z = batch.posZ[i] - WHEEL_X[w] * s + WHEEL_Z[w] * c;
+            batch.groundY[w][i] = groundHeight(x, z);
+        }
+    }
+}
+
+template <typename GroundFn>
+void probeVehicleGround(VehicleBatch& batch, GroundFn groundHeight)
+{
+    probeVehicleGround(batch, 0, batch.count, groundHeight);
+}
+
+// Lateral tire force for slip angle a (rad) and peak force D
+inline f32x4 pacejkaLateral(f32x4 slip, f32x4 peak, const VehicleParams& p)
+{
+    f32x4 bx = f32x4(p.tireB) * slip;
+    f32x4 inner = bx - f32x4(p.tireE) * (bx - simdAtan(bx));
+    return peak * simdSin(f32x4(p.tireC) * simdAtan(inner));
+}
+
+// Step cars [begin, end) by dt. begin must be a multiple of 4; end is rounded up to
+// the padded size, which is safe because padding lanes are zero-filled and never read back.
+inline void stepVehicles(VehicleBatch& b, const VehicleParams& p, float dt, int begin, int end)
+{
+    if (end > b.paddedCount()) end = b.paddedCount();
+    const f32x4 zero(0.0f), one(1.0f);
+    const f32x4 vdt(dt);
+    const f32x4 mass(p.mass);
+    const f32x4 invMass(1.0f / p.mass);
+    const f32x4 springRate(p.springRate);
+    const f32x4 damperRate(p.damperRate / dt);
+    const f32x4 preload(p.mass * p.gravity / VEHICLE_WHEELS);   // car rests at posY == ground
+    const f32x4 mu(p.tireMu);
+    const f32x4 slipMinSpeed(p.slipMinSpeed);
+
+    for (int i = begin; i < end; i += 4) {
+        f32x4 px = f32x4::load(&b.posX[i]), py = f32x4::load(&b.posY[i]), pz = f32x4::load(&b.posZ[i]);
+        f32x4 vx = f32x4::load(&b.velX[i]), vy = f32x4::load(&b.velY[i]), vz = f32x4::load(&b.velZ[i]);
+        f32x4 yaw = f32x4::load(&b.heading[i]), yawRate = f32x4::load(&b.yawRate[i]);
+        f32x4 pitch = f32x4::load(&b.pitch[i]), pitchRate = f32x4::load(&b.pitchRate[i]);
+        f32x4 roll = f32x4::load(&b.roll[i]), rollRate = f32x4::load(&b.rollRate[i]);
+        f32x4 steer = f32x4::load(&b.steer[i]);
+        f32x4 throttle = f32x4::load(&b.throttle[i]);
+        f32x4 brake = f32x4::load(&b.brake[i]);
+        f32x4 steerInput = f32x4::load(&b.steerInput[i]);
+
+        // Steering: rate-limited towards the driver's input
+        f32x4 steerTarget = steerInput * f32x4(p.maxSteer);
+        f32x4 maxSteerStep(p.steerSpeed * dt);
+        steer = steer + simdClamp(steerTarget - steer, -maxSteerStep, maxSteerStep);
+        f32x4 steerSin, steerCos;
+        simdSinCos(steer, steerSin, steerCos);
+
+        // Body frame velocities
+        f32x4 s, c;
+        simdSinCos(yaw, s, c);
+        f32x4 forwardSpeed = vx * s + vz * c;     // along (s, 0, c)
+        f32x4 lateralSpeed = vx * c - vz * s;     // along (c, 0, -s)
+
+        f32x4 forceX = zero, forceZ = zero, forceY = zero;   // local lateral, longitudinal, vertical
+        f32x4 yawTorque = zero, pitchTorque = zero, rollTorque = zero;
+
+        for (int w = 0; w < VEHICLE_WHEELS; ++w) {
+            const f32x4 wx(WHEEL_X[w]), wz(WHEEL_Z[w]);
+
+            // --- Suspension: spring + damper along the wheel's ray ---
+            f32x4 ground = f32x4::load(&b.groundY[w][i]);
+            f32x4 offset = roll * wx - pitch * wz;                  // small-angle body height at this corner
+            f32x4 comp = ground - py - offset;
+            f32x4 prevComp = f32x4::load(&b.compression[w][i]);
+            f32x4 fz = springRate * comp + preload + damperRate * (comp - prevComp);
+            fz = simdMax(fz, zero);                                 // springs push, never pull
+            comp.store(&b.compression[w][i]);
+            fz.store(&b.load[w][i]);
+
+            forceY += fz;
+            pitchTorque -= wz * fz;
+            rollTorque += wx * fz;
+
+            // --- Tire: contact patch velocity in the wheel frame ---
+            f32x4 patchForward = forwardSpeed - yawRate * wx;
+            f32x4 patchLateral = lateralSpeed + yawRate * wz;
+            f32x4 ws = WHEEL_STEERED[w] ? steerSin : zero;
+            f32x4 wc = WHEEL_STEERED[w] ? steerCos : one;
+            f32x4 wheelLong = patchForward * wc + patchLateral * ws;
+            f32x4 wheelLat  = patchLateral * wc - patchForward * ws;
+
+            f32x4 slip = simdAtan(wheelLat / simdMax(simdAbs(wheelLong), slipMinSpeed));
+            f32x4 peak = mu * fz;
+            f32x4 fy = -pacejkaLateral(slip, peak, p);
+
+            f32x4 fx = -wheelLong * f32x4(p.rollingResistance);
+            if (WHEEL_DRIVEN[w])
+                fx += throttle * f32x4(p.engineForce * 0.5f);
+            fx -= simdClamp(wheelLong * f32x4(2.0f), -one, one) * brake * f32x4(p.brakeForce / VEHICLE_WHEELS);
+
+            // Friction circle
+            f32x4 total = simdSqrt(fx * fx + fy * fy);
+            f32x4 limit = peak * f32x4(1.05f);
+            f32x4 scale = simdSelect(simdGreater(total, limit), limit / simdMax(total, f32x4(1e-3f)), one);
+            fx *= scale;
+            fy *= scale;
+
+            // Back to the body frame
+            f32x4 localX = fx * ws + fy * wc;
+            f32x4 localZ = fx * wc - fy * ws;
+            forceX += localX;
+            forceZ += localZ;
+            yawTorque += wz * localX - wx * localZ;
+            pitchTorque -= f32x4(p.cgHeight) * localZ;      // squat / dive
+            rollTorque += f32x4(p.cgHeight) * localX;       // body roll
+        }
+
+        // Aerodynamic drag
+        f32x4 speed = simdSqrt(forwardSpeed * forwardSpeed + lateralSpeed * lateralSpeed);
+        forceZ -= f32x4(p.dragCoefficient) * speed * forwardSpeed;
+        forceX -= f32x4(p.dragCoefficient) * speed * lateralSpeed;
+
+        // Integrate (semi-implicit Euler)
+        f32x4 ax = (forceX * c + forceZ * s) * invMass;
+        f32x4 az = (forceZ * c - forceX * s) * invMass;
+        f32x4 ay = forceY * invMass - f32x4(p.gravity);
+        vx += ax * vdt;
+        vy += ay * vdt;
+        vz += az * vdt;
+        px += vx * vdt;
+        py += vy * vdt;
+        pz += vz * vdt;
+
+        yawRate += yawTorque * f32x4(1.0f / p.yawInertia) * vdt;
+        yaw += yawRate * vdt;
+        pitchRate += pitchTorque * f32x4(1.0f / p.pitchInertia) * vdt;
+        pitch += pitchRate * vdt;
+        rollRate += rollTorque * f32x4(1.0f / p.rollInertia) * vdt;
+        roll += rollRate * vdt;
+
+        f32x4 spin = f32x4::load(&b.wheelSpin[i]);
+        spin += forwardSpeed * f32x4(1.0f / p.wheelRadius) * vdt;
+
+        px.store(&b.posX[i]); py.store(&b.posY[i]); pz.store(&b.posZ[i]);
+        vx.store(&b.velX[i]); vy.store(&b.velY[i]); vz.store(&b.velZ[i]);
+        yaw.store(&b.heading[i]); yawRate.store(&b.yawRate[i]);
+        pitch.store(&b.pitch[i]); pitchRate.store(&b.pitchRate[i]);
+        roll.store(&b.roll[i]); rollRate.store(&b.rollRate[i]);
+        steer.store(&b.steer[i]);
+        spin.store(&b.wheelSpin[i]);
+    }
+}
+
+inline void stepVehicles(VehicleBatch& batch, const VehicleParams& params, float dt)
+{
+    stepVehicles(batch, params, dt, 0, batch.count);
+}